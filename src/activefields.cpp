@@ -46,8 +46,9 @@ ActiveFields::ActiveFields(const unsigned char testBitMask) {
     bitMask(testBitMask);
 }
 
-// Default constructor
+// Default constructor: no fields active
 ActiveFields::ActiveFields() {
+    bitMask(0);
 }
 
 
@@ -63,10 +64,10 @@ void ActiveFields::print() const
 // Return true if the passed bitMask is a valid bitmask.
 // There are only 4 valid formats for a record in a Trading Day File(TDF), and therefore there are only 4 valid bitmasks.
 bool ActiveFields::validBitMask(const unsigned char bitMask) {
-    return (bitMask == (EActiveFieldBit_date & EActiveFieldBit_open & EActiveFieldBit_high & EActiveFieldBit_low & EActiveFieldBit_close)) ||
-           (bitMask == (EActiveFieldBit_date & EActiveFieldBit_open & EActiveFieldBit_high & EActiveFieldBit_low & EActiveFieldBit_close & EActiveFieldBit_volume)) ||
-           (bitMask == (EActiveFieldBit_date & EActiveFieldBit_open & EActiveFieldBit_high & EActiveFieldBit_low & EActiveFieldBit_close & EActiveFieldBit_volume & EActiveFieldBit_openInterest)) ||
-           (bitMask == (EActiveFieldBit_date & EActiveFieldBit_open & EActiveFieldBit_high & EActiveFieldBit_low & EActiveFieldBit_close & EActiveFieldBit_volume & EActiveFieldBit_openInterest & EActiveFieldBit_time));
+    return (bitMask == (EActiveFieldBit_date | EActiveFieldBit_open | EActiveFieldBit_high | EActiveFieldBit_low | EActiveFieldBit_close)) ||
+           (bitMask == (EActiveFieldBit_date | EActiveFieldBit_open | EActiveFieldBit_high | EActiveFieldBit_low | EActiveFieldBit_close | EActiveFieldBit_volume)) ||
+           (bitMask == (EActiveFieldBit_date | EActiveFieldBit_open | EActiveFieldBit_high | EActiveFieldBit_low | EActiveFieldBit_close | EActiveFieldBit_volume | EActiveFieldBit_openInterest)) ||
+           (bitMask == (EActiveFieldBit_date | EActiveFieldBit_open | EActiveFieldBit_high | EActiveFieldBit_low | EActiveFieldBit_close | EActiveFieldBit_volume | EActiveFieldBit_openInterest | EActiveFieldBit_time));
 }
 
 
@@ -83,6 +84,10 @@ void ActiveFields::bitMask(const unsigned char fieldBitMask)
     m_volumeActive = fieldBitMask & EActiveFieldBit_volume;
     m_openInterestActive = fieldBitMask & EActiveFieldBit_openInterest;
     m_timeActive = fieldBitMask & EActiveFieldBit_time;
+
+    // Every active field takes up one 4 byte field in the record
+    m_numFields = m_dateActive + m_openActive + m_highActive + m_lowActive + m_closeActive +
+                  m_volumeActive + m_openInterestActive + m_timeActive;
 }
 
 
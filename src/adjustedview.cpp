@@ -0,0 +1,121 @@
+/*
+ * Class: AdjustedView
+ * Author: Marc Stahl
+ * Description: The trading days of an equity adjusted for its splits and
+ *   dividends as they are read, leaving the stored days untouched.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "adjustedview.h"
+
+using namespace std;
+
+
+// Order a trading day before a date, as YYYYMMDD
+static bool dayBefore(const TradingDay &tradingDay, const unsigned long date)
+{
+    return (tradingDay.date().asYYYYMMDD() < date);
+}
+
+
+// Constructor: View days adjusted by the factors of timeline, finding where each factor starts
+AdjustedView::AdjustedView(const shared_ptr<const vector<TradingDay> > &days,
+                           const shared_ptr<const CorporateActions::Timeline> &timeline) :
+    m_days(days),
+    m_timeline(timeline)
+{
+    if (!m_days) m_days.reset(new vector<TradingDay>);
+
+    // Days before each ex-date take that action's factors.  Segments holding no days are left out
+    unsigned long lastEnd = 0;
+    if (m_timeline) {
+        for (unsigned long actionNum = 0; actionNum < m_timeline->exDates.size(); actionNum++) {
+            unsigned long end = lower_bound(m_days->begin(), m_days->end(), m_timeline->exDates[actionNum], dayBefore) - m_days->begin();
+            if (end == lastEnd) continue;
+            m_segmentEnds.push_back(end);
+            m_priceFactors.push_back(m_timeline->priceFactors[actionNum]);
+            m_volumeFactors.push_back(m_timeline->volumeFactors[actionNum]);
+            lastEnd = end;
+        }
+    }
+    m_priceFactors.push_back(m_timeline ? m_timeline->priceFactors.back() : 1);
+    m_volumeFactors.push_back(m_timeline ? m_timeline->volumeFactors.back() : 1);
+}
+
+
+// Number of trading days
+unsigned long AdjustedView::numDays() const
+{
+    return m_days->size();
+}
+
+
+// The raw, unadjusted trading days
+const shared_ptr<const vector<TradingDay> > & AdjustedView::rawDays() const
+{
+    return m_days;
+}
+
+
+// Position of the segment holding a day: the first whose end is past it
+unsigned long AdjustedView::segment(const unsigned long dayNum) const
+{
+    return upper_bound(m_segmentEnds.begin(), m_segmentEnds.end(), dayNum) - m_segmentEnds.begin();
+}
+
+
+// The trading day at the given position with its prices and volume adjusted
+TradingDay AdjustedView::day(const unsigned long dayNum) const
+{
+    const TradingDay &raw = (*m_days)[dayNum];
+    unsigned long segmentNum = segment(dayNum);
+    double priceFactor = m_priceFactors[segmentNum];
+    double volumeFactor = m_volumeFactors[segmentNum];
+
+    if ( (priceFactor == 1) && (volumeFactor == 1) ) return raw;
+    return TradingDay(raw.date(), raw.time(), float(raw.open() * priceFactor), float(raw.close() * priceFactor),
+                      float(raw.high() * priceFactor), float(raw.low() * priceFactor),
+                      static_cast<unsigned long>(floor(raw.volume() * volumeFactor + 0.5)), raw.openInterest());
+}
+
+
+// Factor the prices of the trading day at the given position are multiplied by
+double AdjustedView::priceFactor(const unsigned long dayNum) const
+{
+    return m_priceFactors[segment(dayNum)];
+}
+
+
+// Factor the volume of the trading day at the given position is multiplied by
+double AdjustedView::volumeFactor(const unsigned long dayNum) const
+{
+    return m_volumeFactors[segment(dayNum)];
+}
+
+
+// Write the adjusted field of numDays trading days, from firstDay on, to values.  Each segment's
+// factor is looked up once and applied to the whole run of days it covers
+bool AdjustedView::column(const Indicators::EFields field, const unsigned long firstDay, const unsigned long numDays, double *values) const
+{
+    if ( (firstDay > m_days->size()) || (numDays > m_days->size() - firstDay) ) return false;
+
+    const vector<TradingDay> &days = *m_days;
+    const bool isVolume = (field == Indicators::EFieldVolume);
+    const bool isPrice = (!isVolume) && (field != Indicators::EFieldOpenInterest);
+    unsigned long endDay = firstDay + numDays;
+    unsigned long segmentNum = segment(firstDay);
+    unsigned long dayNum = firstDay;
+
+    while (dayNum < endDay) {
+        unsigned long segmentEnd = (segmentNum < m_segmentEnds.size()) ? m_segmentEnds[segmentNum] : endDay;
+        if (segmentEnd > endDay) segmentEnd = endDay;
+        double factor = isVolume ? m_volumeFactors[segmentNum] : (isPrice ? m_priceFactors[segmentNum] : 1);
+
+        for ( ; dayNum < segmentEnd; dayNum++) values[dayNum - firstDay] = Indicators::fieldValue(days[dayNum], field) * factor;
+        segmentNum++;
+    }
+    return true;
+}
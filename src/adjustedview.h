@@ -0,0 +1,72 @@
+/*
+ * Class: AdjustedView
+ * Author: Marc Stahl
+ * Description: The trading days of an equity as they would read once adjusted
+ *   for its splits and dividends, without copying or changing them.  The view
+ *   holds the raw days and the equity's factor timeline (see CorporateActions),
+ *   finds once where each factor starts and ends, and multiplies each price and
+ *   volume by its factor as it is read.  Cheap to create, and safe to use from
+ *   several threads at once.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef ADJUSTEDVIEW_H
+#define ADJUSTEDVIEW_H
+
+#include <memory>
+#include <vector>
+#include "corporateactions.h"
+#include "indicators.h"
+#include "tradingday.h"
+
+class AdjustedView
+{
+public:
+
+    // Constructor: View days (in date order) adjusted by the factors of timeline.  A NULL
+    // timeline leaves the days unadjusted
+    AdjustedView(const std::shared_ptr<const std::vector<TradingDay> > &days,
+                 const std::shared_ptr<const CorporateActions::Timeline> &timeline);
+
+    // Number of trading days
+    unsigned long numDays() const;
+
+    // The raw, unadjusted trading days
+    const std::shared_ptr<const std::vector<TradingDay> > & rawDays() const;
+
+    // The trading day at the given position (0 <= dayNum < numDays()) with its prices and volume
+    // adjusted.  The date, time and open interest are as stored
+    TradingDay day(const unsigned long dayNum) const;
+
+    // Factor the prices of the trading day at the given position are multiplied by
+    double priceFactor(const unsigned long dayNum) const;
+
+    // Factor the volume of the trading day at the given position is multiplied by
+    double volumeFactor(const unsigned long dayNum) const;
+
+    // Write the adjusted field of numDays trading days, from firstDay on, to values (which must have
+    // room for them).  Adjusted volumes are not rounded to whole shares.  Return false if the days
+    // asked for go past the last one
+    bool column(const Indicators::EFields field, const unsigned long firstDay, const unsigned long numDays, double *values) const;
+
+private:
+
+    // Position of the segment (run of days sharing one set of factors) holding a day
+    unsigned long segment(const unsigned long dayNum) const;
+
+    // The raw trading days
+    std::shared_ptr<const std::vector<TradingDay> > m_days;
+
+    // The equity's factors (kept so they outlive any change to the CorporateActions cache)
+    std::shared_ptr<const CorporateActions::Timeline> m_timeline;
+
+    // Position just past the last day of each segment but the final one, which runs to the last day
+    std::vector<unsigned long> m_segmentEnds;
+
+    // Factors of each segment (one more than m_segmentEnds)
+    std::vector<double> m_priceFactors;
+    std::vector<double> m_volumeFactors;
+};
+
+#endif // ADJUSTEDVIEW_H
@@ -0,0 +1,210 @@
+/*
+ * Class: BarReplay
+ * Author: Marc Stahl
+ * Description: Replays the trading days of several equities in date and time
+ *   order, in batches sharing a timestamp, without copying them.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include "barreplay.h"
+
+using namespace std;
+
+
+// Constructor: Create a replay with nothing to replay
+BarReplay::BarReplay() :
+    m_lastBucket(m_buckets.end())
+{
+}
+
+
+// Order a trading day before a date, as YYYYMMDD
+static bool dayBeforeDate(const TradingDay &tradingDay, const unsigned long date)
+{
+    return (tradingDay.date().asYYYYMMDD() < date);
+}
+
+
+// Order a date, as YYYYMMDD, before a trading day
+static bool dateBeforeDay(const unsigned long date, const TradingDay &tradingDay)
+{
+    return (date < tradingDay.date().asYYYYMMDD());
+}
+
+
+// Replay the equities with the symbols given from database, loading any not yet loaded first
+bool BarReplay::open(MetaStockDB &database, const vector<string> &symbols, const Date firstDate, const Date lastDate)
+{
+    if (!database.loadEquities(symbols)) {
+        // Leave nothing to replay
+        open(shared_ptr<const DBSnapshot>(), vector<string>(), firstDate, lastDate);
+        m_lastErrorMessage = "Error: trading data did not load: " + database.lastErrorMessage();
+        return false;
+    }
+    return open(database.snapshot(), symbols, firstDate, lastDate);
+}
+
+
+// Replay the equities with the symbols given from a snapshot already taken.  Each equity's
+// range of days is found by binary search
+bool BarReplay::open(const shared_ptr<const DBSnapshot> &snapshot, const vector<string> &symbols,
+                     const Date firstDate, const Date lastDate)
+{
+    m_snapshot.reset();
+    m_symbols.clear();
+    m_firstBars.clear();
+    m_endBars.clear();
+    m_nextBars.clear();
+    m_buckets.clear();
+    m_lastBucket = m_buckets.end();
+    m_lastErrorMessage = "";
+    if (symbols.empty()) return true;
+    if (!snapshot) {
+        m_lastErrorMessage = "Error: no snapshot to replay";
+        return false;
+    }
+
+    for (unsigned long symbolNum = 0; symbolNum < symbols.size(); symbolNum++) {
+        const DBSnapshot::EquitySnapshot *equity = snapshot->find(symbols[symbolNum]);
+        if (equity == NULL) {
+            m_lastErrorMessage = "Error: symbol " + symbols[symbolNum] + " not found";
+            m_firstBars.clear();
+            m_endBars.clear();
+            return false;
+        }
+
+        const TradingDay *first = NULL;
+        const TradingDay *end = NULL;
+        if ( (equity->tradingDays) && (!equity->tradingDays->empty()) ) {
+            first = equity->tradingDays->data();
+            end = first + equity->tradingDays->size();
+            if (firstDate.isValid()) first = lower_bound(first, end, firstDate.asYYYYMMDD(), dayBeforeDate);
+            if (lastDate.isValid()) end = upper_bound(first, end, lastDate.asYYYYMMDD(), dateBeforeDay);
+        }
+        m_firstBars.push_back(first);
+        m_endBars.push_back(end);
+    }
+
+    m_snapshot = snapshot;
+    m_symbols = symbols;
+    rewind();
+    return true;
+}
+
+
+// Number of equities replayed
+unsigned long BarReplay::numSymbols() const
+{
+    return m_symbols.size();
+}
+
+
+// Symbol of an equity replayed
+string BarReplay::symbol(const unsigned long symbolNum) const
+{
+    return m_symbols[symbolNum];
+}
+
+
+// Set batch to every bar at the next timestamp, and move past them.  The earliest bucket is
+// taken out, its runs merged into symbol order, and each of its streams moved on to the bucket
+// of its next bar
+bool BarReplay::next(Batch &batch)
+{
+    batch.bars.clear();
+    if (m_buckets.empty()) return false;
+
+    map<unsigned long long, Bucket>::iterator bucketIt = m_buckets.begin();
+    vector<unsigned long> runStarts;
+    m_batchStreams.swap(bucketIt->second.streams);
+    runStarts.swap(bucketIt->second.runStarts);
+    if (m_lastBucket == bucketIt) m_lastBucket = m_buckets.end();
+    m_buckets.erase(bucketIt);
+
+    // Merge neighbouring runs until one is left
+    while (!runStarts.empty()) {
+        vector<unsigned long> mergedStarts;
+        runStarts.insert(runStarts.begin(), 0);
+        for (unsigned long runNum = 0; runNum + 1 < runStarts.size(); runNum += 2) {
+            unsigned long end = (runNum + 2 < runStarts.size()) ? runStarts[runNum + 2] : m_batchStreams.size();
+            inplace_merge(m_batchStreams.begin() + runStarts[runNum], m_batchStreams.begin() + runStarts[runNum + 1],
+                          m_batchStreams.begin() + end);
+            if (runNum > 0) mergedStarts.push_back(runStarts[runNum]);
+        }
+        if ( (runStarts.size() % 2 == 1) && (runStarts.size() > 1) ) mergedStarts.push_back(runStarts.back());
+        runStarts.swap(mergedStarts);
+    }
+
+    const TradingDay &firstBar = *m_nextBars[m_batchStreams[0]];
+    batch.date = firstBar.date();
+    batch.time = firstBar.time();
+    batch.bars.resize(m_batchStreams.size());
+
+    for (unsigned long barNum = 0; barNum < m_batchStreams.size(); barNum++) {
+        unsigned long streamNum = m_batchStreams[barNum];
+        batch.bars[barNum].symbolNum = streamNum;
+        batch.bars[barNum].tradingDay = m_nextBars[streamNum];
+
+        m_nextBars[streamNum]++;
+        if (m_nextBars[streamNum] != m_endBars[streamNum]) addToBucket(barKey(*m_nextBars[streamNum]), streamNum);
+    }
+
+    // Keep the list for a bucket yet to come
+    m_batchStreams.clear();
+    m_spareStreams.push_back(vector<unsigned long>());
+    m_spareStreams.back().swap(m_batchStreams);
+    return true;
+}
+
+
+// Go back to the first bar, putting every stream with bars in the range in the bucket of its first
+void BarReplay::rewind()
+{
+    m_nextBars = m_firstBars;
+    m_buckets.clear();
+    m_lastBucket = m_buckets.end();
+
+    for (unsigned long streamNum = 0; streamNum < m_firstBars.size(); streamNum++) {
+        if (m_firstBars[streamNum] != m_endBars[streamNum]) addToBucket(barKey(*m_firstBars[streamNum]), streamNum);
+    }
+}
+
+
+// Description of the last error
+string BarReplay::lastErrorMessage() const
+{
+    return m_lastErrorMessage;
+}
+
+
+// Timestamp of a bar, as YYYYMMDDHHMMSS
+unsigned long long BarReplay::barKey(const TradingDay &tradingDay)
+{
+    float time = tradingDay.time();
+    unsigned long long timeKey = (time > 0) ? static_cast<unsigned long long>(time + 0.5f) : 0;
+
+    return static_cast<unsigned long long>(tradingDay.date().asYYYYMMDD()) * 1000000 + timeKey;
+}
+
+
+// Add a stream to the bucket of the timestamp given, starting a new run if it comes before
+// the last stream added to it
+void BarReplay::addToBucket(const unsigned long long key, const unsigned long streamNum)
+{
+    if ( (m_lastBucket == m_buckets.end()) || (m_lastBucket->first != key) ) {
+        m_lastBucket = m_buckets.find(key);
+        if (m_lastBucket == m_buckets.end()) {
+            m_lastBucket = m_buckets.insert(make_pair(key, Bucket())).first;
+            if (!m_spareStreams.empty()) {
+                m_lastBucket->second.streams.swap(m_spareStreams.back());
+                m_spareStreams.pop_back();
+            }
+        }
+    }
+
+    Bucket &bucket = m_lastBucket->second;
+    if ( (!bucket.streams.empty()) && (streamNum < bucket.streams.back()) ) bucket.runStarts.push_back(bucket.streams.size());
+    bucket.streams.push_back(streamNum);
+}
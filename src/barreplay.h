@@ -0,0 +1,130 @@
+/*
+ * Class: BarReplay
+ * Author: Marc Stahl
+ * Description: Replays the trading days of several equities in one global
+ *   order, by date and then time (for intraday data), as a backtest sees them.
+ *   Each call to next() hands back every bar sharing the earliest timestamp not
+ *   yet replayed, as pointers into the trading days of a snapshot (which the
+ *   replay holds, so they stay valid and nothing is copied).
+ *
+ *   Rather than a heap of every equity, the replay keeps the equities waiting
+ *   at each coming timestamp together, in a bucket per timestamp.  Equities
+ *   mostly trade at the same timestamps, so there are only a few buckets at a
+ *   time, and moving an equity on to its next bar is usually a single lookup of
+ *   the bucket just filled before.  Equities are added to a bucket in order, so
+ *   a bucket is a few ordered runs (one for each earlier timestamp its equities
+ *   came from), which are merged to hand the bars out in symbol order.  A date
+ *   range limits the bars replayed, found by binary search, and replaying from
+ *   a database opened with lazy loading loads only the equities replayed.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef BARREPLAY_H
+#define BARREPLAY_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "dbsnapshot.h"
+#include "metastockdb.h"
+#include "tradingday.h"
+
+class BarReplay
+{
+public:
+
+    // One equity's bar at the timestamp of a batch
+    struct Bar {
+        unsigned long symbolNum;         // Position of the equity in the symbols the replay was opened with
+        const TradingDay *tradingDay;    // The bar, valid while the replay is open
+    };
+
+    // Every bar sharing one timestamp
+    struct Batch {
+        Date date;
+        float time;                      // HHMMSS for intraday data, otherwise as stored (usually 0)
+        std::vector<Bar> bars;           // In symbolNum order
+    };
+
+    // Constructor: Create a replay with nothing to replay
+    BarReplay();
+
+    // Replay the equities with the symbols given from database, loading any not yet loaded first.
+    // Only days from firstDate to lastDate (both included) are replayed; Date() for either means
+    // no limit.  Return false (with nothing to replay) if a symbol is not in the database or its
+    // trading data could not be loaded
+    bool open(MetaStockDB &database, const std::vector<std::string> &symbols, const Date firstDate, const Date lastDate);
+
+    // As above, replaying from a snapshot already taken (equities not loaded have no days)
+    bool open(const std::shared_ptr<const DBSnapshot> &snapshot, const std::vector<std::string> &symbols,
+              const Date firstDate, const Date lastDate);
+
+    // Number of equities replayed
+    unsigned long numSymbols() const;
+
+    // Symbol of an equity replayed (0 <= symbolNum < numSymbols())
+    std::string symbol(const unsigned long symbolNum) const;
+
+    // Set batch to every bar at the next timestamp, and move past them.  batch is reused, so
+    // passing the same one each time saves allocating.  Return false (with batch empty) once
+    // every bar has been replayed
+    bool next(Batch &batch);
+
+    // Go back to the first bar
+    void rewind();
+
+    // Description of the last error
+    std::string lastErrorMessage() const;
+
+private:
+
+    // The streams whose next bar is at one timestamp, and the position in streams where each
+    // ordered run after the first starts
+    struct Bucket {
+        std::vector<unsigned long> streams;
+        std::vector<unsigned long> runStarts;
+    };
+
+    // Snapshot the bars are read from, held so they stay valid
+    std::shared_ptr<const DBSnapshot> m_snapshot;
+
+    // Symbols replayed
+    std::vector<std::string> m_symbols;
+
+    // First bar, and the position just past the last bar, of each stream in the date range
+    std::vector<const TradingDay *> m_firstBars;
+    std::vector<const TradingDay *> m_endBars;
+
+    // Next bar of each stream
+    std::vector<const TradingDay *> m_nextBars;
+
+    // Buckets of the streams with bars left, by timestamp (as YYYYMMDDHHMMSS)
+    std::map<unsigned long long, Bucket> m_buckets;
+
+    // The bucket last added to, which the next stream most likely goes to as well
+    std::map<unsigned long long, Bucket>::iterator m_lastBucket;
+
+    // Streams of the batch being replayed
+    std::vector<unsigned long> m_batchStreams;
+
+    // Emptied stream lists, kept to give new buckets without allocating
+    std::vector<std::vector<unsigned long> > m_spareStreams;
+
+    // Description of the last error
+    std::string m_lastErrorMessage;
+
+    // Timestamp of a bar, as YYYYMMDDHHMMSS
+    static unsigned long long barKey(const TradingDay &tradingDay);
+
+    // Add a stream to the bucket of the timestamp given
+    void addToBucket(const unsigned long long key, const unsigned long streamNum);
+
+    // The replay keeps an iterator into its own buckets, so copying is not allowed
+    BarReplay(const BarReplay &);
+    void operator=(const BarReplay &);
+};
+
+#endif // BARREPLAY_H
@@ -0,0 +1,135 @@
+/*
+ * Class: CorporateActions
+ * Author: Marc Stahl
+ * Description: The splits and dividends of equities, and the cumulative factors
+ *   which adjust their earlier prices and volumes, cached per equity.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include "corporateactions.h"
+
+using namespace std;
+
+
+// Constructor: Create an empty table, which also applies EMASTER dividends if useEMASTER is true
+CorporateActions::CorporateActions(const bool useEMASTER) :
+    m_useEMASTER(useEMASTER)
+{
+}
+
+
+// A split giving ratio new shares for each old one
+CorporateActions::Action CorporateActions::split(const Date exDate, const double ratio)
+{
+    Action action;
+
+    action.exDate = exDate;
+    action.priceFactor = (ratio > 0) ? 1 / ratio : 0;
+    action.volumeFactor = ratio;
+    return action;
+}
+
+
+// A cash dividend of amount per share, given the close on the last day before exDate
+CorporateActions::Action CorporateActions::dividend(const Date exDate, const double amount, const double previousClose)
+{
+    Action action;
+
+    action.exDate = exDate;
+    action.priceFactor = (previousClose > 0) ? 1 - amount / previousClose : 0;
+    action.volumeFactor = 1;
+    return action;
+}
+
+
+// Add an action of the equity with the symbol given.  Return false if its factors are not greater than 0
+bool CorporateActions::addAction(const string symbol, const Action &action)
+{
+    if ( (action.priceFactor <= 0) || (action.volumeFactor <= 0) ) return false;
+
+    lock_guard<mutex> lock(m_mutex);
+    m_actions[symbol].push_back(action);
+    m_timelines.erase(symbol);
+    return true;
+}
+
+
+// Remove every action of the equity with the symbol given
+void CorporateActions::clearActions(const string symbol)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    m_actions.erase(symbol);
+    m_timelines.erase(symbol);
+}
+
+
+// Order actions by ex-date
+static bool actionBefore(const CorporateActions::Action &first, const CorporateActions::Action &second)
+{
+    return (first.exDate.asYYYYMMDD() < second.exDate.asYYYYMMDD());
+}
+
+
+// The cumulative factors of the equity given, built once and then returned from the cache
+shared_ptr<const CorporateActions::Timeline> CorporateActions::timeline(const DBSnapshot::EquitySnapshot &equity)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    // EMASTER's dividend may change from one snapshot to the next, so is part of what is cached
+    unsigned long int lastDivPaid = m_useEMASTER ? equity.lastDivPaid : 0;
+    float lastDivAdjRate = m_useEMASTER ? equity.lastDivAdjRate : 0;
+    map<string, CacheEntry>::const_iterator cacheIt = m_timelines.find(equity.symbol);
+    if ( (cacheIt != m_timelines.end()) && (cacheIt->second.lastDivPaid == lastDivPaid) &&
+         (cacheIt->second.lastDivAdjRate == lastDivAdjRate) ) return cacheIt->second.timeline;
+
+    vector<Action> actions;
+    map<string, vector<Action> >::const_iterator actionsIt = m_actions.find(equity.symbol);
+    if (actionsIt != m_actions.end()) actions = actionsIt->second;
+
+    // Only a dividend with a valid YYYYMMDD date and a factor which changes the prices is applied
+    unsigned long year = lastDivPaid / 10000;
+    unsigned long month = (lastDivPaid / 100) % 100;
+    unsigned long day = lastDivPaid % 100;
+    if ( (year >= 1900) && (year <= 9999) && (month >= 1) && (month <= 12) && (day >= 1) && (day <= 31) &&
+         (lastDivAdjRate > 0) && (lastDivAdjRate != 1) ) {
+        Action action;
+        action.exDate = Date(year, month, day);
+        action.priceFactor = lastDivAdjRate;
+        action.volumeFactor = 1;
+        actions.push_back(action);
+    }
+    stable_sort(actions.begin(), actions.end(), actionBefore);
+
+    // Work back from the latest action, multiplying in each one before it.  Actions on the same
+    // date are combined
+    shared_ptr<Timeline> newTimeline(new Timeline);
+    double priceFactor = 1;
+    double volumeFactor = 1;
+    newTimeline->priceFactors.push_back(1);
+    newTimeline->volumeFactors.push_back(1);
+    for (unsigned long actionNum = actions.size(); actionNum > 0; actionNum--) {
+        const Action &action = actions[actionNum - 1];
+        priceFactor *= action.priceFactor;
+        volumeFactor *= action.volumeFactor;
+        if ( (!newTimeline->exDates.empty()) && (newTimeline->exDates.back() == action.exDate.asYYYYMMDD()) ) {
+            newTimeline->priceFactors.back() = priceFactor;
+            newTimeline->volumeFactors.back() = volumeFactor;
+        } else {
+            newTimeline->exDates.push_back(action.exDate.asYYYYMMDD());
+            newTimeline->priceFactors.push_back(priceFactor);
+            newTimeline->volumeFactors.push_back(volumeFactor);
+        }
+    }
+    reverse(newTimeline->exDates.begin(), newTimeline->exDates.end());
+    reverse(newTimeline->priceFactors.begin(), newTimeline->priceFactors.end());
+    reverse(newTimeline->volumeFactors.begin(), newTimeline->volumeFactors.end());
+
+    CacheEntry &entry = m_timelines[equity.symbol];
+    entry.lastDivPaid = lastDivPaid;
+    entry.lastDivAdjRate = lastDivAdjRate;
+    entry.timeline = newTimeline;
+    return newTimeline;
+}
@@ -0,0 +1,97 @@
+/*
+ * Class: CorporateActions
+ * Author: Marc Stahl
+ * Description: The splits and dividends of equities, and from them the factors
+ *   their earlier prices and volumes are multiplied by to adjust them (eg: a 2
+ *   for 1 split halves every price before it and doubles every volume).  Actions
+ *   come from a table filled in by the caller and, optionally, from the last
+ *   dividend held in EMASTER.  The factors of an equity are worked out once, as
+ *   a timeline of the cumulative factor between one action and the next, and
+ *   kept until its actions change.  The trading days themselves are never
+ *   changed: AdjustedView applies the factors as the days are read.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef CORPORATEACTIONS_H
+#define CORPORATEACTIONS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "dbsnapshot.h"
+
+class CorporateActions
+{
+public:
+
+    // One split or dividend: trading days before exDate have their prices multiplied by
+    // priceFactor and their volumes by volumeFactor
+    struct Action {
+        Date exDate;
+        double priceFactor;
+        double volumeFactor;
+    };
+
+    // The cumulative factors of one equity.  Days dated before exDates[0] take factors 0, days from
+    // exDates[k - 1] up to exDates[k] take factors k, and days from the last exDate on take the last
+    // factors (always 1, as nothing after them is adjusted)
+    struct Timeline {
+        std::vector<unsigned long> exDates;   // Dates of the actions, as YYYYMMDD, in date order
+        std::vector<double> priceFactors;     // One more than exDates
+        std::vector<double> volumeFactors;    // One more than exDates
+    };
+
+    // Constructor: Create an empty table.  If useEMASTER is true, each equity's last dividend held
+    // in EMASTER (lastDivPaid as the ex-date, YYYYMMDD, and lastDivAdjRate as the price factor)
+    // is also applied
+    CorporateActions(const bool useEMASTER);
+
+    // A split giving ratio new shares for each old one (eg: 2 for a 2 for 1 split, 0.1 for 1 for 10)
+    static Action split(const Date exDate, const double ratio);
+
+    // A cash dividend of amount per share, given the close on the last day before exDate
+    static Action dividend(const Date exDate, const double amount, const double previousClose);
+
+    // Add an action of the equity with the symbol given.  Return false if its factors are not
+    // greater than 0
+    bool addAction(const std::string symbol, const Action &action);
+
+    // Remove every action of the equity with the symbol given
+    void clearActions(const std::string symbol);
+
+    // The cumulative factors of the equity given.  Built the first time they are asked for, then
+    // returned from the cache until the equity's actions (or its EMASTER dividend) change.
+    // Safe to call from several threads at once
+    std::shared_ptr<const Timeline> timeline(const DBSnapshot::EquitySnapshot &equity);
+
+private:
+
+    // A timeline, and the EMASTER dividend it was built with
+    struct CacheEntry {
+        unsigned long int lastDivPaid;
+        float lastDivAdjRate;
+        std::shared_ptr<const Timeline> timeline;
+    };
+
+    // Apply each equity's EMASTER dividend
+    bool m_useEMASTER;
+
+    // Actions added by the caller, by symbol
+    std::map<std::string, std::vector<Action> > m_actions;
+
+    // Timelines built, by symbol
+    std::map<std::string, CacheEntry> m_timelines;
+
+    // Guards m_actions and m_timelines
+    std::mutex m_mutex;
+
+    // The table holds a mutex, so copying is not allowed
+    CorporateActions(const CorporateActions &);
+    void operator=(const CorporateActions &);
+};
+
+#endif // CORPORATEACTIONS_H
@@ -0,0 +1,273 @@
+/*
+ * Class: CorrelationMatrix
+ * Author: Marc Stahl
+ * Description: The correlation and covariance of every pair of equities in a
+ *   Panel, computed in cache sized tiles on several threads.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "correlationmatrix.h"
+#include "parallelfor.h"
+
+using namespace std;
+
+
+// Number of equities along each side of a tile
+static const unsigned long TILE_SYMBOLS = 32;
+
+// Number of dates accumulated for every pair of a tile before moving on to the next dates
+static const unsigned long BLOCK_DATES = 512;
+
+// Sums kept for each pair: dates in common, sum of each equity's values and squares over
+// them, and sum of the products
+enum ESums {
+    ESumCount,
+    ESumFirst,
+    ESumSecond,
+    ESumFirstSquares,
+    ESumSecondSquares,
+    ESumProducts,
+    ENumSums
+};
+
+
+// Constructor: Create an empty matrix
+CorrelationMatrix::CorrelationMatrix()
+{
+}
+
+
+// Add to sums the dates [0, count) of a pair of columns where either may be missing.  values are
+// centred and 0 where missing, masks are 1 where present and 0 where missing, and squares are the
+// squared values.  Four sets of sums are kept, so the additions of neighbouring dates do not wait on each other
+static void accumulatePartial(const double *firstValues, const double *firstMasks, const double *firstSquares,
+                              const double *secondValues, const double *secondMasks, const double *secondSquares,
+                              const unsigned long count, double *sums)
+{
+    double lanes[ENumSums][4] = {{0}};
+    unsigned long dateNum = 0;
+
+    for ( ; dateNum + 4 <= count; dateNum += 4) {
+        for (unsigned long lane = 0; lane < 4; lane++) {
+            unsigned long position = dateNum + lane;
+            lanes[ESumCount][lane] += firstMasks[position] * secondMasks[position];
+            lanes[ESumFirst][lane] += firstValues[position] * secondMasks[position];
+            lanes[ESumSecond][lane] += secondValues[position] * firstMasks[position];
+            lanes[ESumFirstSquares][lane] += firstSquares[position] * secondMasks[position];
+            lanes[ESumSecondSquares][lane] += secondSquares[position] * firstMasks[position];
+            lanes[ESumProducts][lane] += firstValues[position] * secondValues[position];
+        }
+    }
+    for ( ; dateNum < count; dateNum++) {
+        lanes[ESumCount][0] += firstMasks[dateNum] * secondMasks[dateNum];
+        lanes[ESumFirst][0] += firstValues[dateNum] * secondMasks[dateNum];
+        lanes[ESumSecond][0] += secondValues[dateNum] * firstMasks[dateNum];
+        lanes[ESumFirstSquares][0] += firstSquares[dateNum] * secondMasks[dateNum];
+        lanes[ESumSecondSquares][0] += secondSquares[dateNum] * firstMasks[dateNum];
+        lanes[ESumProducts][0] += firstValues[dateNum] * secondValues[dateNum];
+    }
+
+    for (unsigned long sum = 0; sum < ENumSums; sum++) sums[sum] += (lanes[sum][0] + lanes[sum][1]) + (lanes[sum][2] + lanes[sum][3]);
+}
+
+
+// Add to the sum of products the dates [0, count) of a pair of columns with nothing missing
+static double accumulateProducts(const double *firstValues, const double *secondValues, const unsigned long count)
+{
+    double lanes[4] = {0, 0, 0, 0};
+    unsigned long dateNum = 0;
+
+    for ( ; dateNum + 4 <= count; dateNum += 4) {
+        lanes[0] += firstValues[dateNum] * secondValues[dateNum];
+        lanes[1] += firstValues[dateNum + 1] * secondValues[dateNum + 1];
+        lanes[2] += firstValues[dateNum + 2] * secondValues[dateNum + 2];
+        lanes[3] += firstValues[dateNum + 3] * secondValues[dateNum + 3];
+    }
+    for ( ; dateNum < count; dateNum++) lanes[0] += firstValues[dateNum] * secondValues[dateNum];
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+
+// Compute the correlation and covariance of every pair of the panel's columns
+void CorrelationMatrix::compute(const Panel &panel, const EInputs input, const unsigned int maxThreads)
+{
+    const unsigned long numSymbols = panel.numSymbols();
+    const unsigned long numDates = (input == EInputReturns) ? ((panel.numDates() > 0) ? panel.numDates() - 1 : 0) : panel.numDates();
+    const double notANumber = numeric_limits<double>::quiet_NaN();
+
+    m_symbols.clear();
+    for (unsigned long symbolNum = 0; symbolNum < numSymbols; symbolNum++) m_symbols.push_back(panel.symbol(symbolNum));
+    m_correlations.assign(numSymbols * numSymbols, notANumber);
+    m_covariances.assign(numSymbols * numSymbols, notANumber);
+    m_numObservations.assign(numSymbols * numSymbols, 0);
+    if (numDates == 0) return;
+
+    // Each column as values centred on their mean (which keeps the sums small, so little is lost
+    // when they are subtracted), its mask of which dates are present, and the squared values
+    vector<double> values(numSymbols * numDates);
+    vector<double> masks(numSymbols * numDates);
+    vector<double> squares(numSymbols * numDates);
+    vector<char> complete(numSymbols);
+    vector<double> sumsOfSquares(numSymbols);
+
+    ParallelFor::run(numSymbols, [&](unsigned long symbolNum) {
+        const double *source = panel.column(symbolNum);
+        double *columnValues = &values[symbolNum * numDates];
+        double *columnMasks = &masks[symbolNum * numDates];
+        double *columnSquares = &squares[symbolNum * numDates];
+        double sum = 0;
+        unsigned long count = 0;
+
+        for (unsigned long dateNum = 0; dateNum < numDates; dateNum++) {
+            double value = (input == EInputReturns) ? source[dateNum + 1] / source[dateNum] - 1 : source[dateNum];
+            if (std::isnan(value) || std::isinf(value)) {
+                columnValues[dateNum] = 0;
+                columnMasks[dateNum] = 0;
+            } else {
+                columnValues[dateNum] = value;
+                columnMasks[dateNum] = 1;
+                sum += value;
+                count++;
+            }
+        }
+
+        double mean = (count > 0) ? sum / count : 0;
+        double sumOfSquares = 0;
+        for (unsigned long dateNum = 0; dateNum < numDates; dateNum++) {
+            columnValues[dateNum] = (columnValues[dateNum] - mean) * columnMasks[dateNum];
+            columnSquares[dateNum] = columnValues[dateNum] * columnValues[dateNum];
+            sumOfSquares += columnSquares[dateNum];
+        }
+        complete[symbolNum] = (count == numDates) ? 1 : 0;
+        sumsOfSquares[symbolNum] = sumOfSquares;
+    }, maxThreads);
+
+    // The tiles on and above the diagonal; those below are their mirror images
+    unsigned long numTiles = (numSymbols + TILE_SYMBOLS - 1) / TILE_SYMBOLS;
+    vector<pair<unsigned long, unsigned long> > tiles;
+    for (unsigned long rowTile = 0; rowTile < numTiles; rowTile++) {
+        for (unsigned long columnTile = rowTile; columnTile < numTiles; columnTile++) tiles.push_back(make_pair(rowTile, columnTile));
+    }
+
+    ParallelFor::run(tiles.size(), [&](unsigned long tileNum) {
+        unsigned long firstRow = tiles[tileNum].first * TILE_SYMBOLS;
+        unsigned long firstColumn = tiles[tileNum].second * TILE_SYMBOLS;
+        unsigned long endRow = (firstRow + TILE_SYMBOLS < numSymbols) ? firstRow + TILE_SYMBOLS : numSymbols;
+        unsigned long endColumn = (firstColumn + TILE_SYMBOLS < numSymbols) ? firstColumn + TILE_SYMBOLS : numSymbols;
+        vector<double> sums(TILE_SYMBOLS * TILE_SYMBOLS * ENumSums, 0);
+
+        // Each block of dates of the tile's columns is read from memory once, and reused from
+        // cache for every pair in the tile
+        for (unsigned long firstDate = 0; firstDate < numDates; firstDate += BLOCK_DATES) {
+            unsigned long count = (firstDate + BLOCK_DATES < numDates) ? BLOCK_DATES : numDates - firstDate;
+
+            for (unsigned long row = firstRow; row < endRow; row++) {
+                unsigned long rowOffset = row * numDates + firstDate;
+                for (unsigned long column = (firstRow == firstColumn) ? row : firstColumn; column < endColumn; column++) {
+                    unsigned long columnOffset = column * numDates + firstDate;
+                    double *pairSums = &sums[((row - firstRow) * TILE_SYMBOLS + (column - firstColumn)) * ENumSums];
+
+                    if ( (complete[row]) && (complete[column]) ) {
+                        pairSums[ESumProducts] += accumulateProducts(&values[rowOffset], &values[columnOffset], count);
+                    } else {
+                        accumulatePartial(&values[rowOffset], &masks[rowOffset], &squares[rowOffset],
+                                          &values[columnOffset], &masks[columnOffset], &squares[columnOffset], count, pairSums);
+                    }
+                }
+            }
+        }
+
+        // Work out each pair from its sums, and fill in its mirror image
+        for (unsigned long row = firstRow; row < endRow; row++) {
+            for (unsigned long column = (firstRow == firstColumn) ? row : firstColumn; column < endColumn; column++) {
+                double *pairSums = &sums[((row - firstRow) * TILE_SYMBOLS + (column - firstColumn)) * ENumSums];
+
+                // Complete columns are centred on the mean of every date, which the pair shares
+                if ( (complete[row]) && (complete[column]) ) {
+                    pairSums[ESumCount] = numDates;
+                    pairSums[ESumFirstSquares] = sumsOfSquares[row];
+                    pairSums[ESumSecondSquares] = sumsOfSquares[column];
+                }
+
+                double count = pairSums[ESumCount];
+                unsigned long numObservations = static_cast<unsigned long>(count + 0.5);
+                double covariance = notANumber;
+                double correlation = notANumber;
+                if (numObservations >= 2) {
+                    double firstMean = pairSums[ESumFirst] / count;
+                    double secondMean = pairSums[ESumSecond] / count;
+                    double products = pairSums[ESumProducts] - count * firstMean * secondMean;
+                    double firstSquares = pairSums[ESumFirstSquares] - count * firstMean * firstMean;
+                    double secondSquares = pairSums[ESumSecondSquares] - count * secondMean * secondMean;
+                    covariance = products / (count - 1);
+                    if ( (firstSquares > 0) && (secondSquares > 0) ) {
+                        correlation = products / sqrt(firstSquares * secondSquares);
+                        if (correlation > 1) correlation = 1;
+                        if (correlation < -1) correlation = -1;
+                    }
+                }
+
+                m_covariances[row * numSymbols + column] = covariance;
+                m_covariances[column * numSymbols + row] = covariance;
+                m_correlations[row * numSymbols + column] = correlation;
+                m_correlations[column * numSymbols + row] = correlation;
+                m_numObservations[row * numSymbols + column] = numObservations;
+                m_numObservations[column * numSymbols + row] = numObservations;
+            }
+        }
+    }, maxThreads);
+}
+
+
+// Number of equities
+unsigned long CorrelationMatrix::numSymbols() const
+{
+    return m_symbols.size();
+}
+
+
+// Symbol of a row / column
+string CorrelationMatrix::symbol(const unsigned long symbolNum) const
+{
+    return m_symbols[symbolNum];
+}
+
+
+// Correlation of two equities
+double CorrelationMatrix::correlation(const unsigned long row, const unsigned long column) const
+{
+    return m_correlations[row * m_symbols.size() + column];
+}
+
+
+// Covariance of two equities
+double CorrelationMatrix::covariance(const unsigned long row, const unsigned long column) const
+{
+    return m_covariances[row * m_symbols.size() + column];
+}
+
+
+// Number of dates two equities both have
+unsigned long CorrelationMatrix::numObservations(const unsigned long row, const unsigned long column) const
+{
+    return m_numObservations[row * m_symbols.size() + column];
+}
+
+
+// The whole correlation matrix, row after row
+const double * CorrelationMatrix::correlationData() const
+{
+    return m_correlations.empty() ? NULL : &m_correlations[0];
+}
+
+
+// The whole covariance matrix, row after row
+const double * CorrelationMatrix::covarianceData() const
+{
+    return m_covariances.empty() ? NULL : &m_covariances[0];
+}
@@ -0,0 +1,76 @@
+/*
+ * Class: CorrelationMatrix
+ * Author: Marc Stahl
+ * Description: The correlation and covariance of every pair of equities in a
+ *   Panel (eg: of closes over a date window), of the values themselves or of
+ *   their daily returns.  A date missing (NaN) for either equity of a pair is
+ *   left out of that pair only, so each pair uses every date both have.
+ *
+ *   The pairs are worked through in square tiles of equities, each tile on its
+ *   own thread, with the dates taken in blocks which stay in cache while every
+ *   pair of the tile is accumulated over them.  The inner loops keep several
+ *   independent sums so the compiler can use vector instructions, and pairs of
+ *   equities with no missing dates use a shorter loop needing only their cross
+ *   product.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef CORRELATIONMATRIX_H
+#define CORRELATIONMATRIX_H
+
+#include <string>
+#include <vector>
+#include "panel.h"
+
+class CorrelationMatrix
+{
+public:
+
+    // What to correlate
+    enum EInputs {
+        EInputValues,   // The panel's values
+        EInputReturns   // The change from each date's value to the next, as a fraction of the first
+    };
+
+    // Constructor: Create an empty matrix
+    CorrelationMatrix();
+
+    // Compute the correlation and covariance (sample, dividing by the number of dates less one) of
+    // every pair of the panel's columns, using at most maxThreads threads (0 = one per hardware thread).
+    // Pairs with fewer than 2 dates in common, or an equity whose values do not change, are NaN
+    void compute(const Panel &panel, const EInputs input, const unsigned int maxThreads);
+
+    // Number of equities (the matrices are numSymbols() x numSymbols())
+    unsigned long numSymbols() const;
+
+    // Symbol of a row / column
+    std::string symbol(const unsigned long symbolNum) const;
+
+    // Correlation of two equities (-1 to 1)
+    double correlation(const unsigned long row, const unsigned long column) const;
+
+    // Covariance of two equities
+    double covariance(const unsigned long row, const unsigned long column) const;
+
+    // Number of dates two equities both have, which their correlation was computed over
+    unsigned long numObservations(const unsigned long row, const unsigned long column) const;
+
+    // The whole correlation matrix, row after row (symmetric, so also column after column)
+    const double * correlationData() const;
+
+    // The whole covariance matrix, row after row
+    const double * covarianceData() const;
+
+private:
+
+    // Symbol of each row / column
+    std::vector<std::string> m_symbols;
+
+    // The matrices, row major
+    std::vector<double> m_correlations;
+    std::vector<double> m_covariances;
+    std::vector<unsigned long> m_numObservations;
+};
+
+#endif // CORRELATIONMATRIX_H
@@ -0,0 +1,523 @@
+/*
+ * Class: CSVImporter
+ * Author: Marc Stahl
+ * Description: Imports trading days from a CSV / ASCII file into a database, parsing
+ *   chunks of the memory mapped file in parallel.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "csvimporter.h"
+#include "parallelfor.h"
+
+using namespace std;
+
+// Smallest part of the file given to one thread to parse, so small files are not split up
+#define CSVIMPORTER_MIN_CHUNK_SIZE    (1 << 20)
+
+// Largest part of the file given to one thread to parse, so the rows parsed at once stay small
+#define CSVIMPORTER_MAX_CHUNK_SIZE    (16 << 20)
+
+// Number of chunks per thread in each batch, so threads which finish early can take more
+#define CSVIMPORTER_CHUNKS_PER_THREAD 4
+
+// Number of rows held before they are added to the database
+#define CSVIMPORTER_FLUSH_DAYS        (1 << 20)
+
+// Only the first 19 significant digits of a number are kept, which always fit in 64 bits
+#define CSVIMPORTER_MAX_DIGITS        19
+
+// Years which can be held in a data file
+#define CSVIMPORTER_FIRST_YEAR        1980
+#define CSVIMPORTER_LAST_YEAR         2079
+
+
+// Powers of ten which a double holds exactly
+static const double exactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+// Remove spaces and double quotes from both ends of the field [begin, end)
+static void trimField(const char *&begin, const char *&end)
+{
+    while ( (begin < end) && ((*begin == ' ') || (*begin == '"')) ) begin++;
+    while ( (end > begin) && ((end[-1] == ' ') || (end[-1] == '"')) ) end--;
+}
+
+
+// Constructor: Import into the database given
+CSVImporter::CSVImporter(MetaStockDB &database) :
+    m_database(database),
+    m_numRows(0),
+    m_numRejected(0),
+    m_numDuplicates(0),
+    m_numDaysAdded(0),
+    m_numEquitiesCreated(0),
+    m_lastErrorMessage("")
+{
+}
+
+
+// Import every row of the file at path into the database, and save it.
+// Return true if success, otherwise false with the reason in lastErrorMessage()
+bool CSVImporter::import(const string path, const bool createEquities, const unsigned int maxThreads)
+{
+    struct stat info;
+    Columns columns;
+
+    m_numRows = 0;
+    m_numRejected = 0;
+    m_numDuplicates = 0;
+    m_numDaysAdded = 0;
+    m_numEquitiesCreated = 0;
+    m_lastErrorMessage = "";
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if ( (fd < 0) || (fstat(fd, &info) != 0) ) {
+        m_lastErrorMessage = "Failed to open '" + path + "': " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        m_lastErrorMessage = "Failed to map '" + path + "': " + strerror(errno);
+        return false;
+    }
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(mapping);
+    const char *end = data + info.st_size;
+
+    // The first line either names the columns, or is the first row
+    const char *firstLineEnd = static_cast<const char *>(memchr(data, '\n', end - data));
+    if (firstLineEnd == NULL) firstLineEnd = end;
+    const char *bodyStart = readHeader(data, firstLineEnd, columns) ? firstLineEnd : data;
+    if ( (columns.symbol < 0) || (columns.date < 0) || (columns.close < 0) ) {
+        m_lastErrorMessage = "'" + path + "' names no symbol, date, or close column";
+        munmap(mapping, info.st_size);
+        return false;
+    }
+
+    // Split the rows into chunks, each starting at the beginning of a line.  Large files are
+    // split into enough chunks to keep each one small
+    unsigned int numThreads = (maxThreads == 0) ? ParallelFor::defaultThreads() : maxThreads;
+    unsigned long bodySize = end - bodyStart;
+    unsigned long batchSize = numThreads * CSVIMPORTER_CHUNKS_PER_THREAD;
+    unsigned long numChunks = batchSize;
+    if (numChunks < bodySize / CSVIMPORTER_MAX_CHUNK_SIZE + 1) numChunks = bodySize / CSVIMPORTER_MAX_CHUNK_SIZE + 1;
+    if (numChunks > bodySize / CSVIMPORTER_MIN_CHUNK_SIZE + 1) numChunks = bodySize / CSVIMPORTER_MIN_CHUNK_SIZE + 1;
+
+    vector<const char *> chunkStarts(1, bodyStart);
+    for (unsigned long chunkNum = 1; chunkNum < numChunks; chunkNum++) {
+        const char *split = bodyStart + bodySize * chunkNum / numChunks;
+        if (split < chunkStarts.back()) split = chunkStarts.back();
+        const char *lineEnd = static_cast<const char *>(memchr(split, '\n', end - split));
+        if (lineEnd == NULL) break;
+        chunkStarts.push_back(lineEnd + 1);
+    }
+    chunkStarts.push_back(end);
+    numChunks = chunkStarts.size() - 1;
+
+    // Parse a batch of chunks at a time in parallel, each into its own rows by symbol
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    const char *mappedStart = data;
+    map<string, vector<TradingDay> > daysBySymbol;
+    unsigned long numHeld = 0;
+    bool added = true;
+    for (unsigned long firstChunk = 0; (added) && (firstChunk < numChunks); firstChunk += batchSize) {
+        unsigned long batchChunks = (numChunks - firstChunk < batchSize) ? numChunks - firstChunk : batchSize;
+        vector<Chunk> chunks(batchChunks);
+        ParallelFor::run(batchChunks, [&](unsigned long chunkNum) {
+            parseChunk(chunkStarts[firstChunk + chunkNum], chunkStarts[firstChunk + chunkNum + 1], columns, chunks[chunkNum]);
+        }, maxThreads);
+
+        // The batch is parsed, so release its whole pages (the next batch may start part way through the last)
+        const char *batchEnd = chunkStarts[firstChunk + batchChunks];
+        const char *releaseEnd = (batchEnd == end) ? end : data + (batchEnd - data) / pageSize * pageSize;
+        if (releaseEnd > mappedStart) {
+            munmap(const_cast<char *>(mappedStart), releaseEnd - mappedStart);
+            mappedStart = releaseEnd;
+        }
+
+        // Gather the rows of each symbol, keeping the order they had in the file
+        for (unsigned long chunkNum = 0; chunkNum < chunks.size(); chunkNum++) {
+            map<string, vector<TradingDay> >::iterator chunkIt;
+            for (chunkIt = chunks[chunkNum].daysBySymbol.begin(); chunkIt != chunks[chunkNum].daysBySymbol.end(); chunkIt++) {
+                vector<TradingDay> &days = daysBySymbol[chunkIt->first];
+                numHeld += chunkIt->second.size();
+                if (days.empty()) days.swap(chunkIt->second);
+                else days.insert(days.end(), chunkIt->second.begin(), chunkIt->second.end());
+            }
+            chunks[chunkNum].daysBySymbol.clear();
+            m_numRows += chunks[chunkNum].numRows;
+            m_numRejected += chunks[chunkNum].numRejected;
+        }
+
+        // Add the rows held so far once there are enough, and at the end
+        if ( (numHeld >= CSVIMPORTER_FLUSH_DAYS) || (firstChunk + batchChunks == numChunks) ) {
+            added = addDays(daysBySymbol, createEquities);
+            numHeld = 0;
+        }
+    }
+    if (mappedStart < end) munmap(const_cast<char *>(mappedStart), end - mappedStart);
+
+    // Write the new trading days and equities to the files, even if adding stopped part way
+    m_database.publishSnapshot();
+    if ( ((m_numDaysAdded > 0) || (m_numEquitiesCreated > 0)) && (!m_database.save()) ) {
+        if (added) m_lastErrorMessage = "Failed to save the database: " + m_database.lastErrorMessage();
+        else m_lastErrorMessage += " (saving the days already added also failed: " + m_database.lastErrorMessage() + ")";
+        return false;
+    }
+    return added;
+}
+
+
+// Add the rows of each symbol in daysBySymbol to its equity, and empty daysBySymbol.
+// Return true if success, otherwise false with the reason in m_lastErrorMessage
+bool CSVImporter::addDays(map<string, vector<TradingDay> > &daysBySymbol, const bool createEquities)
+{
+    map<string, vector<TradingDay> >::iterator symbolIt;
+
+    // Add the rows of each symbol in one go
+    for (symbolIt = daysBySymbol.begin(); symbolIt != daysBySymbol.end(); symbolIt++) {
+        const string &symbol = symbolIt->first;
+        unsigned long numAdded;
+
+        if (m_database.find(symbol) == NULL) {
+            if ( (!createEquities) || (!m_database.addEquity(symbol, symbol)) ) {
+                m_numRejected += symbolIt->second.size();
+                continue;
+            }
+            m_numEquitiesCreated++;
+        }
+
+        bool added = m_database.addTradingDays(symbol, symbolIt->second, numAdded);
+        m_numDaysAdded += numAdded;
+        m_numDuplicates += symbolIt->second.size() - numAdded;
+        if (!added) {
+            m_lastErrorMessage = "Failed to add trading days to '" + symbol + "': " + m_database.lastErrorMessage();
+            daysBySymbol.clear();
+            return false;
+        }
+    }
+
+    daysBySymbol.clear();
+    return true;
+}
+
+
+// Number of rows read by the last import
+unsigned long CSVImporter::numRows() const
+{
+    return m_numRows;
+}
+
+
+// Number of rows skipped by the last import because they could not be read
+unsigned long CSVImporter::numRejected() const
+{
+    return m_numRejected;
+}
+
+
+// Number of rows skipped by the last import because the equity already had that date
+unsigned long CSVImporter::numDuplicates() const
+{
+    return m_numDuplicates;
+}
+
+
+// Number of trading days added by the last import
+unsigned long CSVImporter::numDaysAdded() const
+{
+    return m_numDaysAdded;
+}
+
+
+// Number of equities added to the database by the last import
+unsigned long CSVImporter::numEquitiesCreated() const
+{
+    return m_numEquitiesCreated;
+}
+
+
+// Description of the last error
+string CSVImporter::lastErrorMessage() const
+{
+    return m_lastErrorMessage;
+}
+
+
+// Work out the columns and separator from the first line of the file.  Return true if the
+// line names the columns, false if it is a row (and the default columns are used)
+bool CSVImporter::readHeader(const char *line, const char *end, Columns &columns)
+{
+    // The separator is the first of comma, semicolon, or tab found in the line
+    columns.separator = ',';
+    for (const char *position = line; position < end; position++) {
+        if ( (*position == ',') || (*position == ';') || (*position == '\t') ) {
+            columns.separator = *position;
+            break;
+        }
+    }
+
+    columns.symbol = -1;
+    columns.date = -1;
+    columns.time = -1;
+    columns.open = -1;
+    columns.high = -1;
+    columns.low = -1;
+    columns.close = -1;
+    columns.volume = -1;
+    columns.openInterest = -1;
+
+    // Match each field against the known column names (ignoring case and MetaStock's <>)
+    int columnNum = 0;
+    bool named = false;
+    const char *fieldStart = line;
+    while (fieldStart <= end) {
+        const char *fieldEnd = static_cast<const char *>(memchr(fieldStart, columns.separator, end - fieldStart));
+        if (fieldEnd == NULL) fieldEnd = end;
+
+        string name;
+        for (const char *position = fieldStart; position < fieldEnd; position++)
+            if ( (*position != '<') && (*position != '>') && (*position != '"') && (*position != ' ') && (*position != '\r') )
+                name += static_cast<char>(toupper(static_cast<unsigned char>(*position)));
+
+        int *column = NULL;
+        if ( (name == "TICKER") || (name == "SYMBOL") ) column = &columns.symbol;
+        else if ( (name == "DATE") || (name == "DTYYYYMMDD") ) column = &columns.date;
+        else if (name == "TIME") column = &columns.time;
+        else if (name == "OPEN") column = &columns.open;
+        else if (name == "HIGH") column = &columns.high;
+        else if (name == "LOW") column = &columns.low;
+        else if (name == "CLOSE") column = &columns.close;
+        else if ( (name == "VOL") || (name == "VOLUME") ) column = &columns.volume;
+        else if ( (name == "OPENINT") || (name == "OI") || (name == "OPENINTEREST") ) column = &columns.openInterest;
+        if ( (column != NULL) && (*column < 0) ) {
+            *column = columnNum;
+            named = true;
+        }
+
+        columnNum++;
+        fieldStart = fieldEnd + 1;
+    }
+
+    // Without names, the columns are in the usual order
+    if (!named) {
+        columns.symbol = 0;
+        columns.date = 1;
+        columns.open = 2;
+        columns.high = 3;
+        columns.low = 4;
+        columns.close = 5;
+        columns.volume = 6;
+        columns.openInterest = 7;
+    }
+
+    // Rows need at least as many fields as the required columns use
+    columns.numColumns = 0;
+    if (columns.symbol >= columns.numColumns) columns.numColumns = columns.symbol + 1;
+    if (columns.date >= columns.numColumns) columns.numColumns = columns.date + 1;
+    if (columns.close >= columns.numColumns) columns.numColumns = columns.close + 1;
+    return named;
+}
+
+
+// Parse the rows between begin and end into chunk, grouped by symbol
+void CSVImporter::parseChunk(const char *begin, const char *end, const Columns &columns, Chunk &chunk)
+{
+    string symbol;
+    TradingDay tradingDay;
+    vector<TradingDay> *days = NULL;
+    string lastSymbol;
+
+    chunk.numRows = 0;
+    chunk.numRejected = 0;
+
+    const char *line = begin;
+    while (line < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        const char *next = (lineEnd == NULL) ? end : lineEnd + 1;
+        if (lineEnd == NULL) lineEnd = end;
+        if ( (lineEnd > line) && (lineEnd[-1] == '\r') ) lineEnd--;
+
+        // Blank lines are not rows
+        if (lineEnd > line) {
+            chunk.numRows++;
+            if (!parseRow(line, lineEnd, columns, symbol, tradingDay)) chunk.numRejected++;
+            else {
+                // Rows for one symbol usually follow each other, so only look it up when it changes
+                if ( (days == NULL) || (symbol != lastSymbol) ) {
+                    days = &chunk.daysBySymbol[symbol];
+                    lastSymbol = symbol;
+                }
+                days->push_back(tradingDay);
+            }
+        }
+        line = next;
+    }
+}
+
+
+// Parse one line into symbol and tradingDay.  Return false if it cannot be read
+bool CSVImporter::parseRow(const char *line, const char *end, const Columns &columns, string &symbol, TradingDay &tradingDay)
+{
+    const char *fieldStarts[256];
+    const char *fieldEnds[256];
+    int numFields = 0;
+
+    // Find the fields, as far as the last column used
+    const char *fieldStart = line;
+    while ( (fieldStart <= end) && (numFields < 256) ) {
+        const char *fieldEnd = static_cast<const char *>(memchr(fieldStart, columns.separator, end - fieldStart));
+        if (fieldEnd == NULL) fieldEnd = end;
+        fieldStarts[numFields] = fieldStart;
+        fieldEnds[numFields] = fieldEnd;
+        trimField(fieldStarts[numFields], fieldEnds[numFields]);
+        numFields++;
+        fieldStart = fieldEnd + 1;
+    }
+    if (numFields < columns.numColumns) return false;
+
+    // The symbol and date must be given
+    if (fieldStarts[columns.symbol] == fieldEnds[columns.symbol]) return false;
+    symbol.assign(fieldStarts[columns.symbol], fieldEnds[columns.symbol]);
+    Date date;
+    if (!parseDate(fieldStarts[columns.date], fieldEnds[columns.date], date)) return false;
+
+    // Close must be given; a missing open, high, or low is taken to be the close, and
+    // a missing time, volume, or open interest to be 0
+    double close;
+    if (!parseNumber(fieldStarts[columns.close], fieldEnds[columns.close], close)) return false;
+
+    double values[5] = { close, close, close, 0, 0 };
+    const int valueColumns[5] = { columns.open, columns.high, columns.low, columns.volume, columns.openInterest };
+    for (int valueNum = 0; valueNum < 5; valueNum++) {
+        int column = valueColumns[valueNum];
+        if ( (column < 0) || (column >= numFields) || (fieldStarts[column] == fieldEnds[column]) ) continue;
+        if (!parseNumber(fieldStarts[column], fieldEnds[column], values[valueNum])) return false;
+    }
+    if (values[3] < 0) return false;
+
+    double time = 0;
+    if ( (columns.time >= 0) && (columns.time < numFields) && (fieldStarts[columns.time] != fieldEnds[columns.time]) &&
+         (!parseNumber(fieldStarts[columns.time], fieldEnds[columns.time], time)) ) return false;
+
+    tradingDay = TradingDay(date, static_cast<float>(time), static_cast<float>(values[0]), static_cast<float>(close),
+                            static_cast<float>(values[1]), static_cast<float>(values[2]),
+                            static_cast<unsigned long>(values[3] + 0.5), static_cast<float>(values[4]));
+    return true;
+}
+
+
+// Parse a number taking up all of [begin, end).  The digits are gathered into a 64 bit
+// integer and scaled by an exact power of ten, which gives the correctly rounded result
+// whenever both are held exactly by a double (as for any price or volume); anything
+// else is left to strtod.  Return false if it is not a number
+bool CSVImporter::parseNumber(const char *begin, const char *end, double &value)
+{
+    const char *position = begin;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int numDigits = 0;        // Significant digits kept in mantissa
+    int exponent = 0;
+    bool anyDigits = false;
+
+    if ( (position < end) && ((*position == '-') || (*position == '+')) ) negative = (*position++ == '-');
+
+    // Whole part.  Digits beyond those kept only scale the number
+    for (; (position < end) && (*position >= '0') && (*position <= '9'); position++) {
+        anyDigits = true;
+        if (numDigits < CSVIMPORTER_MAX_DIGITS) {
+            mantissa = mantissa * 10 + (*position - '0');
+            if (mantissa != 0) numDigits++;
+        } else exponent++;
+    }
+
+    // Fraction
+    if ( (position < end) && (*position == '.') ) {
+        for (position++; (position < end) && (*position >= '0') && (*position <= '9'); position++) {
+            anyDigits = true;
+            if (numDigits < CSVIMPORTER_MAX_DIGITS) {
+                mantissa = mantissa * 10 + (*position - '0');
+                if (mantissa != 0) numDigits++;
+                exponent--;
+            }
+        }
+    }
+    if (!anyDigits) return false;
+
+    // Exponent
+    if ( (position < end) && ((*position == 'e') || (*position == 'E')) ) {
+        bool negativeExponent = false;
+        int explicitExponent = 0;
+        position++;
+        if ( (position < end) && ((*position == '-') || (*position == '+')) ) negativeExponent = (*position++ == '-');
+        if ( (position == end) || (*position < '0') || (*position > '9') ) return false;
+        for (; (position < end) && (*position >= '0') && (*position <= '9'); position++)
+            if (explicitExponent < 10000) explicitExponent = explicitExponent * 10 + (*position - '0');
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+    if (position != end) return false;
+
+    if ( (mantissa <= (static_cast<uint64_t>(1) << 53)) && (exponent >= -22) && (exponent <= 22) ) {
+        value = static_cast<double>(mantissa);
+        if (exponent < 0) value /= exactPowersOfTen[-exponent];
+        else value *= exactPowersOfTen[exponent];
+    } else {
+        string text(begin, end);
+        value = strtod(text.c_str(), NULL);
+        return true;
+    }
+
+    if (negative) value = -value;
+    return true;
+}
+
+
+// Parse a date (YYYYMMDD, YYYY-MM-DD, or YYYY/MM/DD) taking up all of [begin, end).
+// Return false if it is not a date which can be held in a data file
+bool CSVImporter::parseDate(const char *begin, const char *end, Date &date)
+{
+    char digits[8];
+    int numDigits = 0;
+
+    // Gather the 8 digits, allowing separators only between year, month, and day
+    for (const char *position = begin; position < end; position++) {
+        if ( (*position >= '0') && (*position <= '9') ) {
+            if (numDigits == 8) return false;
+            digits[numDigits++] = *position;
+        } else if ( ((*position == '-') || (*position == '/')) && ((numDigits == 4) || (numDigits == 6)) &&
+                    (end - begin == 10) ) {
+            continue;
+        } else return false;
+    }
+    if (numDigits != 8) return false;
+
+    unsigned int year = (digits[0] - '0') * 1000 + (digits[1] - '0') * 100 + (digits[2] - '0') * 10 + (digits[3] - '0');
+    unsigned int month = (digits[4] - '0') * 10 + (digits[5] - '0');
+    unsigned int day = (digits[6] - '0') * 10 + (digits[7] - '0');
+    if ( (year < CSVIMPORTER_FIRST_YEAR) || (year > CSVIMPORTER_LAST_YEAR) || (month < 1) || (month > 12) || (day < 1) || (day > 31) )
+        return false;
+
+    date = Date(year, month, day);
+    return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * Class: CSVImporter
+ * Author: Marc Stahl
+ * Description: Imports trading days from a CSV / ASCII file into a database.  The
+ *   file is memory mapped and split into chunks on line boundaries, and batches of
+ *   chunks are parsed on several threads at once, each grouping its rows by symbol.
+ *   Each batch's part of the mapping is released once parsed, and whenever enough
+ *   rows are held the rows of each symbol are added to its equity in one bulk insert
+ *   (equities not yet in the database are added), so a large file is never held
+ *   whole in memory twice.  The database is then saved, writing the Fx.DAT and
+ *   ?MASTER files.
+ *
+ *   A first line naming the columns is recognised (eg: the MetaStock ASCII format
+ *   <TICKER>,<DTYYYYMMDD>,<OPEN>,<HIGH>,<LOW>,<CLOSE>,<VOL>); without one the columns
+ *   are taken to be symbol, date, open, high, low, close, volume, and open interest
+ *   (the last two optional).  Fields are separated by commas, semicolons, or tabs,
+ *   and dates are YYYYMMDD or YYYY-MM-DD (or YYYY/MM/DD).
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef CSVIMPORTER_H
+#define CSVIMPORTER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "metastockdb.h"
+#include "tradingday.h"
+
+class CSVImporter
+{
+public:
+
+    // Constructor: Import into the database given, which must stay open while importing
+    CSVImporter(MetaStockDB &database);
+
+    // Import every row of the file at path, using at most maxThreads threads to parse it
+    // (0 = one per hardware thread).  Rows which cannot be read are counted and skipped.
+    // Symbols not in the database are added as new equities if createEquities is true,
+    // otherwise their rows are rejected.  The database is then saved (so should not be lazily
+    // loaded, as save() only writes equities whose data file was loaded).  If adding trading days
+    // fails part way (eg: the journal could not be written) the import stops there, but the days
+    // already added are kept: they are published and saved, and counted by numDaysAdded().
+    // Return true if success, otherwise false with the reason in lastErrorMessage()
+    bool import(const std::string path, const bool createEquities, const unsigned int maxThreads);
+
+    // Number of rows read by the last import (not counting a header line)
+    unsigned long numRows() const;
+
+    // Number of rows skipped by the last import because they could not be read
+    unsigned long numRejected() const;
+
+    // Number of rows skipped by the last import because the equity already had that date
+    unsigned long numDuplicates() const;
+
+    // Number of trading days added by the last import
+    unsigned long numDaysAdded() const;
+
+    // Number of equities added to the database by the last import
+    unsigned long numEquitiesCreated() const;
+
+    // Description of the last error
+    std::string lastErrorMessage() const;
+
+private:
+
+    // Position of each column in a row (-1 if not present)
+    struct Columns {
+        int symbol;
+        int date;
+        int time;
+        int open;
+        int high;
+        int low;
+        int close;
+        int volume;
+        int openInterest;
+        int numColumns;      // Number of columns needed to hold every column above
+        char separator;      // Character between fields
+    };
+
+    // The rows of one chunk, grouped by symbol, and the number which could not be read
+    struct Chunk {
+        std::map<std::string, std::vector<TradingDay> > daysBySymbol;
+        unsigned long numRows;
+        unsigned long numRejected;
+    };
+
+    // Database being imported into
+    MetaStockDB &m_database;
+
+    // Counts from the last import
+    unsigned long m_numRows;
+    unsigned long m_numRejected;
+    unsigned long m_numDuplicates;
+    unsigned long m_numDaysAdded;
+    unsigned long m_numEquitiesCreated;
+
+    // Description of the last error
+    std::string m_lastErrorMessage;
+
+    // Add the rows of each symbol in daysBySymbol to its equity (adding the equity if
+    // createEquities is true), and empty daysBySymbol.  Return true if success, otherwise false
+    // with the reason in m_lastErrorMessage
+    bool addDays(std::map<std::string, std::vector<TradingDay> > &daysBySymbol, const bool createEquities);
+
+    // Work out the columns from the first line of the file.  Return true if the line
+    // names the columns (so is not a row), false if the default columns are used
+    static bool readHeader(const char *line, const char *end, Columns &columns);
+
+    // Parse the rows between begin and end (which start and end on line boundaries) into chunk
+    static void parseChunk(const char *begin, const char *end, const Columns &columns, Chunk &chunk);
+
+    // Parse one line into symbol and tradingDay.  Return false if it cannot be read
+    static bool parseRow(const char *line, const char *end, const Columns &columns, std::string &symbol, TradingDay &tradingDay);
+
+    // Parse a number (eg: -12.5, 1e3) taking up all of [begin, end).  Return false if it is not one
+    static bool parseNumber(const char *begin, const char *end, double &value);
+
+    // Parse a date (YYYYMMDD, YYYY-MM-DD, or YYYY/MM/DD) taking up all of [begin, end).
+    // Return false if it is not a date which can be held in a data file
+    static bool parseDate(const char *begin, const char *end, Date &date);
+
+    // The importer refers to a database, so copying is not allowed
+    CSVImporter(const CSVImporter &);
+    void operator=(const CSVImporter &);
+};
+
+#endif // CSVIMPORTER_H
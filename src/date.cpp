@@ -25,15 +25,15 @@ Date::Date(const unsigned short int year, const unsigned char month, const unsig
 // Constructor: Converts the epoch to a day, month and year and stores them in the member variables
 Date::Date(const time_t epoch)
 {
-    tm* mytmPtr;
+    tm mytm;
 
-    //convert epoch to day month year
-    mytmPtr = gmtime(&epoch);
+    //convert epoch to day month year (reentrant version, as databases may be opened on several threads)
+    gmtime_r(&epoch, &mytm);
 
     //initialize member variables to the new day month year
-    m_year = mytmPtr->tm_year + 1900;
-    m_month = mytmPtr->tm_mon + 1;
-    m_day = mytmPtr->tm_mday;
+    m_year = mytm.tm_year + 1900;
+    m_month = mytm.tm_mon + 1;
+    m_day = mytm.tm_mday;
 }
 
 
@@ -103,6 +103,13 @@ unsigned short int Date::Year() const
 }
 
 
+// Returns this object's date as the number YYYYMMDD (0 for an invalid date)
+unsigned long Date::asYYYYMMDD() const
+{
+    return static_cast<unsigned long>(m_year) * 10000 + m_month * 100 + m_day;
+}
+
+
 // Returns this object's date as an epoch
 time_t Date::asEpoch() const
 {
@@ -174,5 +181,5 @@ bool Date::operator!=(const Date comparisonDate) const
 // True if this is a valid date (i.e. not 0/0/0)
 bool Date::isValid() const
 {
-    return ((m_day == 0) && (m_month == 0) && (m_year == 0));
+    return ((m_day != 0) || (m_month != 0) || (m_year != 0));
 }
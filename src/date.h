@@ -47,6 +47,10 @@ public:
     // Returns this object's year
     unsigned short int Year() const;
 
+    // Returns this object's date as the number YYYYMMDD (0 for an invalid date).
+    // Dates compare in the same order as these numbers
+    unsigned long asYYYYMMDD() const;
+
     // If this object's date is greater than the comparisonDate, then return true. Otherwise return false.
     bool operator>(const Date comparisonDate) const;
 
@@ -0,0 +1,57 @@
+/*
+ * Class: DBSnapshot
+ * Author: Marc Stahl
+ * Description: An immutable, versioned view of every equity in a MetaStockDB.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include "dbsnapshot.h"
+
+using namespace std;
+
+// Orders equities by symbol, for the binary search in find()
+static bool symbolLess(const DBSnapshot::EquitySnapshot &equity, const string &symbol)
+{
+    return equity.symbol < symbol;
+}
+
+
+// Constructor: Create a snapshot with the version and equities given
+DBSnapshot::DBSnapshot(const unsigned long version, vector<EquitySnapshot> &equities) :
+    m_version(version)
+{
+    m_equities.swap(equities);
+}
+
+
+// Version of this snapshot
+unsigned long DBSnapshot::version() const
+{
+    return m_version;
+}
+
+
+// Number of equities in the snapshot
+unsigned long DBSnapshot::numEquities() const
+{
+    return m_equities.size();
+}
+
+
+// Get the equity at the given position, in symbol order
+const DBSnapshot::EquitySnapshot & DBSnapshot::equity(const unsigned long equityNum) const
+{
+    return m_equities.at(equityNum);
+}
+
+
+// Return the equity with the symbol specified.  Returns NULL if not found
+const DBSnapshot::EquitySnapshot * DBSnapshot::find(const string symbol) const
+{
+    vector<EquitySnapshot>::const_iterator targetIt = lower_bound(m_equities.begin(), m_equities.end(), symbol, symbolLess);
+
+    if ( (targetIt == m_equities.end()) || (targetIt->symbol != symbol) ) return NULL;
+    return &(*targetIt);
+}
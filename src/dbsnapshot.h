@@ -0,0 +1,68 @@
+/*
+ * Class: DBSnapshot
+ * Author: Marc Stahl
+ * Description: An immutable, versioned view of every equity in a MetaStockDB.
+ *   Readers hold a snapshot (via shared_ptr) and may use it from any thread
+ *   without locking, while the database goes on changing and publishing newer
+ *   snapshots.  The trading days of an equity which did not change between two
+ *   versions are shared, not copied.  A version is freed when the last reader
+ *   holding it lets go.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef DBSNAPSHOT_H
+#define DBSNAPSHOT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "activefields.h"
+#include "date.h"
+#include "tradingday.h"
+#include "zonemap.h"
+
+class DBSnapshot
+{
+public:
+
+    // The state of one equity at the time the snapshot was taken
+    struct EquitySnapshot {
+        std::string symbol;            // The symbol representing this equity
+        std::string description;       // Description of the equity
+        ActiveFields activeFields;     // Which fields in the trading days hold data
+        Date firstDate;                // Date of first trading day
+        Date lastDate;                 // Date of last trading day
+        std::shared_ptr<const std::vector<TradingDay> > tradingDays;  // Trading days, in date order
+        std::shared_ptr<const ZoneMap> zoneMap;  // Summaries of tradingDays, per zone and in total
+        unsigned long int lastDivPaid;  // Last dividend paid, from EMASTER (0 if none)
+        float lastDivAdjRate;           // Last dividend adjustment rate, from EMASTER (0 if none)
+    };
+
+    // Constructor: Create a snapshot with the version and equities given.  The equities
+    // must be sorted by symbol; their contents are moved into the snapshot (equities is left empty)
+    DBSnapshot(const unsigned long version, std::vector<EquitySnapshot> &equities);
+
+    // Version of this snapshot.  Every snapshot published by a database has a higher
+    // version than the one before it
+    unsigned long version() const;
+
+    // Number of equities in the snapshot
+    unsigned long numEquities() const;
+
+    // Get the equity at the given position (0 <= equityNum < numEquities()), in symbol order
+    const EquitySnapshot & equity(const unsigned long equityNum) const;
+
+    // Return the equity with the symbol specified.  Returns NULL if not found
+    const EquitySnapshot * find(const std::string symbol) const;
+
+private:
+
+    // Version of this snapshot
+    unsigned long m_version;
+
+    // All equities, sorted by symbol
+    std::vector<EquitySnapshot> m_equities;
+};
+
+#endif // DBSNAPSHOT_H
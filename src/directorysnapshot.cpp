@@ -0,0 +1,168 @@
+/*
+ * Class: DirectorySnapshot
+ * Author: Marc Stahl
+ * Description: Holds an open descriptor on the database directory together with
+ *   a listing of the files it contained when opened.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "directorysnapshot.h"
+
+using namespace std;
+
+
+// Constructor: Create a snapshot with no directory open
+DirectorySnapshot::DirectorySnapshot() :
+    m_fd(-1)
+{
+}
+
+
+// Destructor: Close the directory descriptor
+DirectorySnapshot::~DirectorySnapshot()
+{
+    if (m_fd >= 0) close(m_fd);
+}
+
+
+// Open the directory at pathName and list its contents
+// Return true if success, false otherwise
+bool DirectorySnapshot::open(const string pathName)
+{
+    // Close any previously opened directory
+    if (m_fd >= 0) close(m_fd);
+    m_fileNames.clear();
+
+    m_fd = ::open(pathName.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (m_fd < 0) return false;
+
+    return readListing();
+}
+
+
+// Re-read the listing of the open directory
+// Return true if success, false otherwise
+bool DirectorySnapshot::refresh()
+{
+    if (m_fd < 0) return false;
+    return readListing();
+}
+
+
+// Read the directory listing into m_fileNames
+bool DirectorySnapshot::readListing()
+{
+    m_fileNames.clear();
+
+    // fdopendir takes ownership of the descriptor it is given, so give it a copy
+    int listFd = dup(m_fd);
+    if (listFd < 0) return false;
+
+    DIR *dir = fdopendir(listFd);
+    if (dir == NULL) {
+        close(listFd);
+        return false;
+    }
+
+    // The copy shares its position with m_fd, so start from the beginning
+    rewinddir(dir);
+
+    // Remember every name in the directory
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) m_fileNames.insert(entry->d_name);
+
+    closedir(dir);
+    return true;
+}
+
+
+// True if a directory is open
+bool DirectorySnapshot::isOpen() const
+{
+    return (m_fd >= 0);
+}
+
+
+// The descriptor of the open directory (-1 if none)
+int DirectorySnapshot::fd() const
+{
+    return m_fd;
+}
+
+
+// True if the file was in the directory listing
+bool DirectorySnapshot::contains(const string fileName) const
+{
+    return (m_fileNames.find(fileName) != m_fileNames.end());
+}
+
+
+// Names of every entry in the directory listing
+const set<string> & DirectorySnapshot::fileNames() const
+{
+    return m_fileNames;
+}
+
+
+// Get the size of a file in the directory using fstatat.
+// Return true if success, false otherwise
+bool DirectorySnapshot::fileSize(const string fileName, off_t &size) const
+{
+    struct stat info;
+
+    size = 0;
+    if (fstatat(m_fd, fileName.c_str(), &info, 0) != 0) return false;
+    size = info.st_size;
+    return true;
+}
+
+
+// Open a file relative to the directory with the open(2) flags given.
+// Returns the new descriptor, or -1 on failure
+int DirectorySnapshot::openFile(const string fileName, const int flags, const mode_t mode) const
+{
+    return openat(m_fd, fileName.c_str(), flags | O_CLOEXEC, mode);
+}
+
+
+// Read the entire contents of a file in the directory into contents.
+// Return true if success, false otherwise
+bool DirectorySnapshot::readFile(const string fileName, string &contents) const
+{
+    contents.clear();
+
+    int fileFd = openFile(fileName, O_RDONLY, 0);
+    if (fileFd < 0) return false;
+
+    // Size the buffer from the open descriptor, so the file is only looked up once
+    struct stat info;
+    if (fstat(fileFd, &info) != 0) {
+        close(fileFd);
+        return false;
+    }
+    contents.resize(info.st_size);
+
+    // Read until the buffer is full (read may return less than asked for)
+    size_t bytesRead = 0;
+    while (bytesRead < contents.size()) {
+        ssize_t result = read(fileFd, &contents[bytesRead], contents.size() - bytesRead);
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result < 0) {
+            close(fileFd);
+            return false;
+        }
+        if (result == 0) break;
+        bytesRead += result;
+    }
+    close(fileFd);
+
+    // If the file shrank while reading, keep only what was read
+    contents.resize(bytesRead);
+    return true;
+}
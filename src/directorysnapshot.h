@@ -0,0 +1,77 @@
+/*
+ * Class: DirectorySnapshot
+ * Author: Marc Stahl
+ * Description: Holds an open descriptor on the database directory together with
+ *   a listing of the files it contained when opened.  Files are then checked
+ *   against the listing and opened relative to the directory descriptor, so
+ *   the path is only resolved once no matter how many files are read.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef DIRECTORYSNAPSHOT_H
+#define DIRECTORYSNAPSHOT_H
+
+#include <set>
+#include <string>
+#include <sys/types.h>
+
+class DirectorySnapshot
+{
+public:
+
+    // Constructor: Create a snapshot with no directory open
+    DirectorySnapshot();
+
+    // Destructor: Close the directory descriptor
+    ~DirectorySnapshot();
+
+    // Open the directory at pathName and list its contents.  Any previously open
+    // directory is closed first.  Return true if success, false otherwise
+    bool open(const std::string pathName);
+
+    // Re-read the listing of the open directory (eg: after files have been created)
+    // Return true if success, false otherwise
+    bool refresh();
+
+    // True if a directory is open
+    bool isOpen() const;
+
+    // The descriptor of the open directory (-1 if none)
+    int fd() const;
+
+    // True if the file was in the directory listing
+    bool contains(const std::string fileName) const;
+
+    // Names of every entry in the directory listing (including "." and "..")
+    const std::set<std::string> & fileNames() const;
+
+    // Get the size of a file in the directory using fstatat.
+    // Return true if success, false otherwise
+    bool fileSize(const std::string fileName, off_t &size) const;
+
+    // Read the entire contents of a file in the directory into contents.
+    // Return true if success, false otherwise
+    bool readFile(const std::string fileName, std::string &contents) const;
+
+    // Open a file relative to the directory with the open(2) flags given.
+    // Returns the new descriptor, or -1 on failure
+    int openFile(const std::string fileName, const int flags, const mode_t mode) const;
+
+private:
+
+    // Descriptor of the open directory, or -1 if none
+    int m_fd;
+
+    // Names of all files found in the directory
+    std::set<std::string> m_fileNames;
+
+    // Read the directory listing into m_fileNames
+    bool readListing();
+
+    // The snapshot owns a descriptor, so copying is not allowed
+    DirectorySnapshot(const DirectorySnapshot &);
+    void operator=(const DirectorySnapshot &);
+};
+
+#endif // DIRECTORYSNAPSHOT_H
@@ -47,6 +47,10 @@ public:
     virtual bool fieldOpenInterestActive() const = 0;
     virtual bool fieldTimeActive() const = 0;
 
+    // True if the trading data was read from the data file without error.  Equities which do
+    // not come from a data file always hold all of their trading data
+    virtual bool tradingDataLoaded() const { return true; }
+
 
 // Get the date of the first trading day for this equity
     virtual Date firstTradingDayDate() const = 0;
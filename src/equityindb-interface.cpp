@@ -21,7 +21,10 @@ std::string EquityInDB::description() const {
 
 // Set the stock description;
 void EquityInDB::description(const std::string newDescription) {
-    m_description = newDescription;
+    std::unique_lock<std::mutex> writerLock;
+    if (m_writerMutex != NULL) writerLock = std::unique_lock<std::mutex>(*m_writerMutex);
+
+    descriptionWhileLocked(newDescription);
 }
 
 // Get the stock symbol
@@ -63,6 +66,11 @@ bool EquityInDB::fieldTimeActive() const {
     return m_activeFields.timeActive();
 }
 
+// True if the trading data was read from the data file without error
+bool EquityInDB::tradingDataLoaded() const {
+    return loaded();
+}
+
 
 //----------------------------------------------------------------------------
 // Trading day information
@@ -77,12 +85,27 @@ Date EquityInDB::lastTradingDayDate() const  {
     return m_tradingHistory.lastDate();
 }
 
-// Adds the passed trading day data to the list of trading days
+// Adds the passed trading day data to the list of trading days, holding the writer mutex (if set)
 // Returns true if passed trading data succesfully added
 bool EquityInDB::addTradingDayData(const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest) {
+    std::unique_lock<std::mutex> writerLock;
+    if (m_writerMutex != NULL) writerLock = std::unique_lock<std::mutex>(*m_writerMutex);
+
+    // Loading replaces the days held, and a file which failed to load is never written
+    if (m_loadStatus != ELoadStatusLoaded) return false;
+
     return m_tradingHistory.addTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest));
 }
 
+// Replaces the trading day already held for the date given with the data passed, holding the
+// writer mutex (if set).  Returns true if the date was held, and so replaced
+bool EquityInDB::updateTradingDayData(const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest) {
+    std::unique_lock<std::mutex> writerLock;
+    if (m_writerMutex != NULL) writerLock = std::unique_lock<std::mutex>(*m_writerMutex);
+
+    return m_tradingHistory.updateTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest));
+}
+
 // Reset at start of list, and copy first item in the list
 // into the parameter.  Return true if at least one trading is in the list,
 // and the data from that trading day is returned
@@ -82,6 +82,11 @@ EquityInDB::EquityInDB(
     m_intradayPeriodicity(intradayPeriodicity),
     m_symbol(symbol),
     m_flag(flag),
+    m_loadStatus(ELoadStatusNotLoaded),
+    m_metadataChanged(false),
+    m_masterRecordNum(0),
+    m_EMASTERRecordNum(0),
+    m_writerMutex(NULL),
 
     m_IDCode(0),
     m_autoRun(0),
@@ -154,6 +159,11 @@ EquityInDB::EquityInDB(
     m_intradayPeriodicity(EIntradayPeriodicityNone),
     m_symbol(symbol),
     m_flag(0),  // Field is unused in XMASTER, so set to 0 just for initialization
+    m_loadStatus(ELoadStatusNotLoaded),
+    m_metadataChanged(false),
+    m_masterRecordNum(0),
+    m_EMASTERRecordNum(0),
+    m_writerMutex(NULL),
 
     m_IDCode(0),  // Field is unused in XMASTER, so set to 0 just for initialization
     m_autoRun(0),  // Field is unused in XMASTER, so set to 0 just for initialization
@@ -300,6 +310,82 @@ unsigned char EquityInDB::fieldLength() const
     return m_recordLength;
 }
 
+// Move the equity to another data file number and type.  MASTER holds the length of a
+// whole record, where XMASTER equities always show 4
+void EquityInDB::dataFile(const unsigned long int newFileNum, const EDataFileTypes newDataFileType, const unsigned long int newFileType)
+{
+    m_dataFileNumber = newFileNum;
+    if (newDataFileType != m_dataFileType) m_recordLength = (newDataFileType == EDataFileTypeFDAT) ? m_activeFields.recordSize() : 4;
+    m_dataFileType = newDataFileType;
+    m_fileType = newFileType;
+    m_metadataChanged = true;
+}
+
+
+// Does the equity's ?MASTER record differ from this object
+bool EquityInDB::metadataChanged() const
+{
+    return m_metadataChanged;
+}
+
+void EquityInDB::metadataChanged(const bool changed)
+{
+    m_metadataChanged = changed;
+}
+
+
+// Position of the equity's record in MASTER (XMASTER for Cx.MWD files), 0 if not listed
+unsigned long int EquityInDB::masterRecordNum() const
+{
+    return m_masterRecordNum;
+}
+
+void EquityInDB::masterRecordNum(const unsigned long int recordNum)
+{
+    m_masterRecordNum = recordNum;
+}
+
+
+// Position of the equity's record in EMASTER, 0 if not listed
+unsigned long int EquityInDB::EMASTERRecordNum() const
+{
+    return m_EMASTERRecordNum;
+}
+
+void EquityInDB::EMASTERRecordNum(const unsigned long int recordNum)
+{
+    m_EMASTERRecordNum = recordNum;
+}
+
+
+// Set the mutex taken by the mutators of the Equity interface (NULL for none)
+void EquityInDB::writerMutex(std::mutex *mutex)
+{
+    m_writerMutex = mutex;
+}
+
+
+// Set the stock description, for a caller already holding the writer mutex
+void EquityInDB::descriptionWhileLocked(const std::string newDescription)
+{
+    m_description = newDescription;
+    m_metadataChanged = true;
+}
+
+
+// Attach an indicator to the equity's trading history, which keeps it up to date
+void EquityInDB::attachIndicator(const shared_ptr<IndicatorState> &indicator)
+{
+    m_tradingHistory.attachIndicator(indicator);
+}
+
+
+// Stop keeping the indicator up to date.  Return false if it was not attached
+bool EquityInDB::detachIndicator(const shared_ptr<IndicatorState> &indicator)
+{
+    return m_tradingHistory.detachIndicator(indicator);
+}
+
 
 ActiveFields EquityInDB::activeFields() const
 {
@@ -334,7 +420,17 @@ TradingHistory* EquityInDB::tradingHistory()
 
 bool EquityInDB::loaded() const
 {
-    return m_loaded;
+    return (m_loadStatus == ELoadStatusLoaded);
+}
+
+EquityInDB::ELoadStatus EquityInDB::loadStatus() const
+{
+    return m_loadStatus;
+}
+
+void EquityInDB::loadStatus(const ELoadStatus newLoadStatus)
+{
+    m_loadStatus = newLoadStatus;
 }
 
 unsigned char EquityInDB::IDCode() const
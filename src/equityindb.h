@@ -9,7 +9,10 @@
 #ifndef EQUITYINDB_H
 #define EQUITYINDB_H
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include "indicatorstate.h"
 #include "tradinghistory.h"
 #include "date.h"
 #include "bytearray.h"
@@ -37,6 +40,13 @@ public:
         EInterdayPeriodicityYearly = 'Y'
     };
 
+    // State of loading the trading data from the data file
+    enum ELoadStatus {
+        ELoadStatusNotLoaded,  // Not yet read (eg: lazy loading)
+        ELoadStatusLoaded,     // Read completely
+        ELoadStatusFailed      // Read failed, so no trading days are held
+    };
+
     // Valid intraday periodicity (mapped to value used in file)
     enum EIntradayPeriodicity {
         EIntradayPeriodicityNone = 0,
@@ -126,6 +136,8 @@ public:
     unsigned char flag() const;
     TradingHistory* tradingHistory();
     bool loaded() const;
+    ELoadStatus loadStatus() const;
+    void loadStatus(const ELoadStatus newLoadStatus);
     unsigned char IDCode() const;
     unsigned char activeFieldsBitmask() const;
     unsigned char autoRun() const;
@@ -134,6 +146,38 @@ public:
     unsigned long int lastDivPaid() const;
     float lastDivAdjRate() const;
 
+    // Move the equity to another data file number, held in the data file type given (Fx.DAT
+    // files are listed in MASTER / EMASTER, the others in XMASTER), with the MASTER file type
+    // given (unused in XMASTER).  Only changes this object
+    void dataFile(const unsigned long int newFileNum, const EDataFileTypes newDataFileType, const unsigned long int newFileType);
+
+    // Does the equity's ?MASTER record differ from this object (eg: the description or the
+    // dates of the trading days have changed), so it must be written when saved
+    bool metadataChanged() const;
+    void metadataChanged(const bool changed);
+
+    // Position of the equity's record in MASTER (XMASTER for Cx.MWD files) and in EMASTER,
+    // or 0 if it is not yet listed, so a changed record can be written in place
+    unsigned long int masterRecordNum() const;
+    void masterRecordNum(const unsigned long int recordNum);
+    unsigned long int EMASTERRecordNum() const;
+    void EMASTERRecordNum(const unsigned long int recordNum);
+
+    // Mutex taken by addTradingDayData(), updateTradingDayData() and description(newDescription),
+    // so changes made through the Equity interface are serialised with the database's other
+    // writers (NULL, the default, for none).  Set by MetaStockDB to its writer mutex
+    void writerMutex(std::mutex *mutex);
+
+    // As description(newDescription), for a caller already holding the writer mutex
+    void descriptionWhileLocked(const std::string newDescription);
+
+    // Attach an indicator, which is brought up to date with the trading days held and then kept
+    // up to date as days are added or changed (see TradingHistory::attachIndicator())
+    void attachIndicator(const std::shared_ptr<IndicatorState> &indicator);
+
+    // Stop keeping the indicator given up to date.  Return false if it was not attached
+    bool detachIndicator(const std::shared_ptr<IndicatorState> &indicator);
+
     ByteArray MASTERFiller2() const;
     ByteArray MASTERFiller3() const;
     ByteArray MASTERFiller4() const;
@@ -170,7 +214,7 @@ public:
         // Get the stock description
         std::string description() const;
 
-        // Set the stock description
+        // Set the stock description (taking the writer mutex, if set)
         void description(const std::string newDescription);
 
         // Get the stock symbol
@@ -186,6 +230,9 @@ public:
         bool fieldOpenInterestActive() const;
         bool fieldTimeActive() const;
 
+    // True if the trading data was read from the data file without error
+    bool tradingDataLoaded() const;
+
 
     //----------------------------------------------------------------------------
     // Trading day information
@@ -197,10 +244,17 @@ public:
         // Get the last trading day
         Date lastTradingDayDate() const;
 
-        // Adds the passed trading day data to the list of trading days
-        // Returns true if succesfully added new day data
+        // Adds the passed trading day data to the list of trading days (taking the writer mutex, if set).
+        // Unlike MetaStockDB::addTradingDayData() the day is not journalled, and the trading data
+        // is not loaded first
+        // Returns true if succesfully added new day data (false if the trading data is not loaded)
         bool addTradingDayData(const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest);
 
+        // Replaces the trading day already held for the date given with the data passed (taking
+        // the writer mutex, if set)
+        // Returns true if the date was held, and so replaced
+        bool updateTradingDayData(const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest);
+
         // Reset at start of list, and copy first item in the list
         // into the parameter.  Return true if success, false otherwise
         bool getFirstTradingDayData(Date &date, Time &time, float &open, float &close, float &high, float &low, unsigned long &volume, float &openInterest);
@@ -225,7 +279,11 @@ private:
     EquityInDB::EIntradayPeriodicity m_intradayPeriodicity;  // The frequency with which stock data is retrieved from the internet (frequency < 1 day).
     std::string m_symbol;  // The symbol representing this equity.
     unsigned char m_flag;  // Not sure what this flag means.
-    bool m_loaded;  // Is the underlying equity loaded from file (or attempted)
+    ELoadStatus m_loadStatus;  // Whether the data file has been read: not yet, completely, or with an error
+    bool m_metadataChanged;  // Does the ?MASTER record differ from this object
+    unsigned long int m_masterRecordNum;  // Position of the record in MASTER (or XMASTER), 0 if none
+    unsigned long int m_EMASTERRecordNum;  // Position of the record in EMASTER, 0 if none
+    std::mutex *m_writerMutex;  // Taken by the mutators of the Equity interface, NULL if none
 
     // Extra fields from EMASTER
     unsigned char m_IDCode; // Unsure what this does
@@ -0,0 +1,316 @@
+/*
+ * Class: FileTransaction
+ * Author: Marc Stahl
+ * Description: Replaces a set of files in the database directory using temporaries,
+ *   batched flushes, a commit record, and renames.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "filetransaction.h"
+#include "msfileio.h"
+
+using namespace std;
+
+// Appended to the name of a file to give the name of its temporary
+#define FILETRANSACTION_TEMP_SUFFIX   ".tmp"
+
+// The commit record: the name of each file being replaced on its own line, then the end marker
+#define FILETRANSACTION_RECORD_NAME   "TRANSACTION"
+#define FILETRANSACTION_RECORD_END    "COMMIT"
+
+// Most temporaries kept open between endFile() and commit().  Beyond this the oldest, whose
+// write has had longest to finish, is flushed and closed
+#define FILETRANSACTION_MAX_OPEN_FILES   64
+
+
+// Constructor: Start a transaction on the files of the directory given
+FileTransaction::FileTransaction(const DirectorySnapshot &directory) :
+    m_directory(directory),
+    m_finished(false),
+    m_recordWritten(false)
+{
+}
+
+
+// Destructor: Abort the transaction if it was not committed
+FileTransaction::~FileTransaction()
+{
+    if (!m_finished) abort();
+}
+
+
+// Name of the temporary written in place of fileName
+string FileTransaction::tempName(const string fileName)
+{
+    return fileName + FILETRANSACTION_TEMP_SUFFIX;
+}
+
+
+// Begin replacing fileName.  Returns a descriptor open on the temporary, or -1 with the reason in errorMessage
+int FileTransaction::beginFile(const string fileName, const bool copyExisting, string &errorMessage)
+{
+    errorMessage = "";
+
+    int fd = m_directory.openFile(tempName(fileName), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        errorMessage = "failed to create " + tempName(fileName) + ": " + strerror(errno);
+        return -1;
+    }
+    m_fileNames.push_back(fileName);
+
+    if (copyExisting) {
+        int sourceFd = m_directory.openFile(fileName, O_RDONLY, 0);
+        if ( (sourceFd < 0) && (errno != ENOENT) ) {
+            errorMessage = "failed to open " + fileName + ": " + strerror(errno);
+            close(fd);
+            return -1;
+        }
+        if (sourceFd >= 0) {
+            bool copied = MSFileIO::copyFileContents(sourceFd, fd);
+            close(sourceFd);
+            if (!copied) {
+                errorMessage = "failed to copy " + fileName + ": " + strerror(errno);
+                close(fd);
+                return -1;
+            }
+        }
+    }
+
+    return fd;
+}
+
+
+// The temporary open on fd is completely written: start writing it to disk, and keep fd until
+// commit() flushes it.  Return true if success, otherwise false with the reason in errorMessage
+bool FileTransaction::endFile(const int fd, string &errorMessage)
+{
+    errorMessage = "";
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    // Start the write now without waiting for it, so the disk works on every file while the
+    // rest are being written.  commit() then only has to wait for writes already under way
+    sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+
+    m_openFds.push_back(fd);
+    if (m_openFds.size() <= FILETRANSACTION_MAX_OPEN_FILES) return true;
+
+    int oldestFd = m_openFds.front();
+    m_openFds.erase(m_openFds.begin());
+    return flushFile(oldestFd, errorMessage);
+}
+
+
+// Replace fileName with contents.  Return true if success, otherwise false with the reason in errorMessage
+bool FileTransaction::writeFile(const string fileName, const string &contents, string &errorMessage)
+{
+    int fd = beginFile(fileName, false, errorMessage);
+    if (fd < 0) return false;
+
+    if (!MSFileIO::writeBufferToFile(fd, 0, contents)) {
+        errorMessage = "failed to write " + tempName(fileName) + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    return endFile(fd, errorMessage);
+}
+
+
+// Wait for the temporary open on fd to reach the disk, and close fd.  Return true if success,
+// otherwise false with the reason in errorMessage
+bool FileTransaction::flushFile(const int fd, string &errorMessage)
+{
+    bool flushed = (fsync(fd) == 0);
+    if (!flushed) errorMessage = string("failed to flush temporary file: ") + strerror(errno);
+
+    if ( (close(fd) != 0) && (flushed) ) {
+        errorMessage = string("failed to close temporary file: ") + strerror(errno);
+        flushed = false;
+    }
+    return flushed;
+}
+
+
+// Flush and close every temporary still open.  Return true if success, otherwise false with
+// the reason in errorMessage
+bool FileTransaction::flushOpenFiles(string &errorMessage)
+{
+    bool flushed = true;
+
+    // Every descriptor is closed, even after a failure
+    for (unsigned long fdNum = 0; fdNum < m_openFds.size(); fdNum++) {
+        string fileMessage;
+        if ( (!flushFile(m_openFds[fdNum], fileMessage)) && (flushed) ) {
+            errorMessage = fileMessage;
+            flushed = false;
+        }
+    }
+    m_openFds.clear();
+    return flushed;
+}
+
+
+// Write the commit record listing fileNames, and flush it and the directory.  Return true if
+// success, otherwise false with the reason in errorMessage
+bool FileTransaction::writeRecord(const DirectorySnapshot &directory, const vector<string> &fileNames, string &errorMessage)
+{
+    string contents;
+
+    for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) contents += fileNames[fileNum] + "\n";
+    contents += FILETRANSACTION_RECORD_END "\n";
+
+    int fd = directory.openFile(FILETRANSACTION_RECORD_NAME, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        errorMessage = string("failed to create commit record: ") + strerror(errno);
+        return false;
+    }
+    bool written = ( (MSFileIO::writeBufferToFile(fd, 0, contents)) && (fsync(fd) == 0) );
+    if (!written) errorMessage = string("failed to write commit record: ") + strerror(errno);
+    close(fd);
+
+    // The record only counts once its name is on disk too
+    if ( (written) && (fsync(directory.fd()) != 0) ) {
+        errorMessage = string("failed to flush directory: ") + strerror(errno);
+        written = false;
+    }
+    if (!written) unlinkat(directory.fd(), FILETRANSACTION_RECORD_NAME, 0);
+    return written;
+}
+
+
+// Remove the commit record, and flush the directory so it cannot return.  Return true if
+// success, otherwise false with the reason in errorMessage
+bool FileTransaction::removeRecord(const DirectorySnapshot &directory, string &errorMessage)
+{
+    // A record which came back after a crash would rename the temporaries of a later transaction
+    if ( (unlinkat(directory.fd(), FILETRANSACTION_RECORD_NAME, 0) != 0) || (fsync(directory.fd()) != 0) ) {
+        errorMessage = string("failed to remove commit record: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+
+// Wait for every temporary to reach the disk, write the commit record, rename them all over
+// the files they replace, and remove the record.  Return true if success, otherwise false with
+// the reason in errorMessage
+bool FileTransaction::commit(string &errorMessage)
+{
+    errorMessage = "";
+    if (m_fileNames.empty()) {
+        m_finished = true;
+        return true;
+    }
+
+    // Nothing may be renamed until every temporary is safely on disk, or a crash could
+    // leave some files replaced by empty ones.  Most are already on their way there
+    if (!flushOpenFiles(errorMessage)) {
+        abort();
+        return false;
+    }
+
+    // Once the record is on disk the transaction is certain to complete: if the renames are cut
+    // short, recover() finishes them
+    if (!writeRecord(m_directory, m_fileNames, errorMessage)) {
+        abort();
+        return false;
+    }
+    m_recordWritten = true;
+    m_finished = true;
+
+    for (unsigned long fileNum = 0; fileNum < m_fileNames.size(); fileNum++) {
+        if (renameat(m_directory.fd(), tempName(m_fileNames[fileNum]).c_str(), m_directory.fd(), m_fileNames[fileNum].c_str()) != 0) {
+            errorMessage = "failed to rename " + tempName(m_fileNames[fileNum]) + ": " + strerror(errno) +
+                           " (finished when the database is next opened)";
+            return false;
+        }
+    }
+
+    // One flush of the directory makes every rename durable, and only then may the record go
+    if (fsync(m_directory.fd()) != 0) {
+        errorMessage = string("failed to flush directory: ") + strerror(errno);
+        return false;
+    }
+    return removeRecord(m_directory, errorMessage);
+}
+
+
+// Finish a transaction which crashed after writing its commit record.  Returns true if there
+// was nothing to recover or the recovery succeeded, otherwise false with the reason in errorMessage
+bool FileTransaction::recover(const DirectorySnapshot &directory, string &errorMessage)
+{
+    vector<string> fileNames;
+    string contents;
+    bool complete = false;
+
+    errorMessage = "";
+    if (!directory.readFile(FILETRANSACTION_RECORD_NAME, contents)) {
+        if (errno == ENOENT) return true;
+        errorMessage = string("failed to read commit record: ") + strerror(errno);
+        return false;
+    }
+
+    // The names end at the end marker.  Without it the record was cut short
+    size_t lineStart = 0;
+    size_t lineEnd;
+    while ( (!complete) && ((lineEnd = contents.find('\n', lineStart)) != string::npos) ) {
+        string line = contents.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if (line == FILETRANSACTION_RECORD_END) complete = true;
+        else if ( (!line.empty()) && (line.find('/') == string::npos) ) fileNames.push_back(line);
+    }
+
+    for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) {
+        int result;
+        if (complete) result = renameat(directory.fd(), tempName(fileNames[fileNum]).c_str(), directory.fd(), fileNames[fileNum].c_str());
+        else result = unlinkat(directory.fd(), tempName(fileNames[fileNum]).c_str(), 0);
+
+        // A temporary already renamed before the crash is no longer there
+        if ( (result != 0) && (errno != ENOENT) ) {
+            errorMessage = "failed to recover " + fileNames[fileNum] + ": " + strerror(errno);
+            return false;
+        }
+    }
+
+    if (fsync(directory.fd()) != 0) {
+        errorMessage = string("failed to flush directory: ") + strerror(errno);
+        return false;
+    }
+    return removeRecord(directory, errorMessage);
+}
+
+
+// Has the commit record been written
+bool FileTransaction::committed() const
+{
+    return m_recordWritten;
+}
+
+
+// Remove every temporary, leaving the original files as they were.  Does nothing once the
+// commit record has been written
+void FileTransaction::abort()
+{
+    if (m_recordWritten) return;
+    for (unsigned long fdNum = 0; fdNum < m_openFds.size(); fdNum++) close(m_openFds[fdNum]);
+    m_openFds.clear();
+    for (unsigned long fileNum = 0; fileNum < m_fileNames.size(); fileNum++)
+        unlinkat(m_directory.fd(), tempName(m_fileNames[fileNum]).c_str(), 0);
+    m_fileNames.clear();
+    m_finished = true;
+}
+
+
+// Number of files being replaced
+unsigned long FileTransaction::numFiles() const
+{
+    return m_fileNames.size();
+}
+
@@ -0,0 +1,114 @@
+/*
+ * Class: FileTransaction
+ * Author: Marc Stahl
+ * Description: Replaces a set of files in the database directory so that a crash
+ *   part way through leaves either every file replaced or none.  Each new file is
+ *   written to a temporary beside the file it replaces, and flushed to disk through
+ *   the descriptor it was written with.  When all are on disk a commit record
+ *   listing them is written, then the temporaries are renamed over the originals
+ *   and the record removed.  A crash while renaming leaves the record behind, and
+ *   recover() (called when the database is opened) finishes the renames it lists.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef FILETRANSACTION_H
+#define FILETRANSACTION_H
+
+#include <string>
+#include <vector>
+#include "directorysnapshot.h"
+
+class FileTransaction
+{
+public:
+
+    // Constructor: Start a transaction on the files of the directory given, which must stay open until it ends
+    FileTransaction(const DirectorySnapshot &directory);
+
+    // Destructor: Abort the transaction if it was not committed
+    ~FileTransaction();
+
+    // Begin replacing fileName.  A temporary is created beside it, holding a copy of the current
+    // file if copyExisting is true and the file exists (shared by reflink where the file system
+    // allows, so unchanged data is not copied).  Returns a descriptor open for reading and writing
+    // on the temporary, or -1 with the reason in errorMessage
+    int beginFile(const std::string fileName, const bool copyExisting, std::string &errorMessage);
+
+    // The temporary open on fd is completely written: start writing it to disk.  The transaction
+    // takes fd over, flushing and closing it by commit() at the latest (the oldest are flushed
+    // early if too many are open).  Return true if success, otherwise false with the reason in
+    // errorMessage
+    bool endFile(const int fd, std::string &errorMessage);
+
+    // Replace fileName with contents (beginFile, write, and endFile in one).
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool writeFile(const std::string fileName, const std::string &contents, std::string &errorMessage);
+
+    // Wait for every temporary to reach the disk, write the commit record, rename them all over
+    // the files they replace, and remove the record.  Return true if success, otherwise false with
+    // the reason in errorMessage.  If the record could not be written nothing is replaced (and
+    // the temporaries are removed); after that the renames are finished by recover()
+    bool commit(std::string &errorMessage);
+
+    // Has the commit record been written.  From then on the files are certain to be replaced,
+    // by commit() or else by recover(), even if commit() returned false
+    bool committed() const;
+
+    // Remove every temporary, leaving the original files as they were.  Does nothing once the
+    // commit record has been written, as the temporaries are then needed by recover()
+    void abort();
+
+    // Number of files being replaced
+    unsigned long numFiles() const;
+
+    // Finish a transaction which crashed after writing its commit record: rename every temporary
+    // it lists which is still there over its file, and remove the record.  A record not written
+    // completely is removed, with its temporaries, as the crash came before any rename.  Returns
+    // true if there was nothing to recover or the recovery succeeded, otherwise false with the
+    // reason in errorMessage
+    static bool recover(const DirectorySnapshot &directory, std::string &errorMessage);
+
+private:
+
+    // Directory holding the files
+    const DirectorySnapshot &m_directory;
+
+    // Names of the files being replaced
+    std::vector<std::string> m_fileNames;
+
+    // Descriptors of temporaries completely written but not yet flushed, oldest first
+    std::vector<int> m_openFds;
+
+    // Has the transaction been committed or aborted
+    bool m_finished;
+
+    // Has the commit record been written
+    bool m_recordWritten;
+
+    // Name of the temporary written in place of fileName
+    static std::string tempName(const std::string fileName);
+
+    // Wait for the temporary open on fd to reach the disk, and close fd.  Return true if success,
+    // otherwise false with the reason in errorMessage
+    static bool flushFile(const int fd, std::string &errorMessage);
+
+    // Flush and close every temporary still open.  Return true if success, otherwise false with
+    // the reason in errorMessage
+    bool flushOpenFiles(std::string &errorMessage);
+
+    // Write the commit record listing fileNames, and flush it and the directory.  Return true
+    // if success, otherwise false with the reason in errorMessage
+    static bool writeRecord(const DirectorySnapshot &directory, const std::vector<std::string> &fileNames,
+                            std::string &errorMessage);
+
+    // Remove the commit record, and flush the directory so it cannot return.  Return true if
+    // success, otherwise false with the reason in errorMessage
+    static bool removeRecord(const DirectorySnapshot &directory, std::string &errorMessage);
+
+    // The object owns temporary files, so copying is not allowed
+    FileTransaction(const FileTransaction &);
+    void operator=(const FileTransaction &);
+};
+
+#endif // FILETRANSACTION_H
@@ -0,0 +1,206 @@
+/*
+ * Class: GenerationBackup
+ * Author: Marc Stahl
+ * Description: Keeps up to a given number of backup generations of a database,
+ *   sharing unchanged data by hard link or reflink.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "generationbackup.h"
+#include "msfileio.h"
+
+using namespace std;
+
+// Generation directories are named this followed by the generation number
+#define GENERATIONBACKUP_PREFIX     "BACKUP."
+
+// Name of the directory a new generation is built in
+#define GENERATIONBACKUP_NEW_NAME   "BACKUP.new"
+
+// Suffix of temporaries written by a save, which are never backed up
+#define GENERATIONBACKUP_TEMP_SUFFIX ".tmp"
+
+// Most copies kept open before the oldest is flushed, whose write has had longest to finish
+#define GENERATIONBACKUP_MAX_OPEN_COPIES   64
+
+
+// Name of the directory holding a generation (1 is the most recent)
+string GenerationBackup::generationName(const unsigned int generation)
+{
+    return GENERATIONBACKUP_PREFIX + to_string(generation);
+}
+
+
+// True if fileName is the name of a generation directory, or of one being built
+bool GenerationBackup::isGenerationName(const string fileName)
+{
+    return (fileName.compare(0, strlen(GENERATIONBACKUP_PREFIX), GENERATIONBACKUP_PREFIX) == 0);
+}
+
+
+// Create a new generation holding every file in directory, and remove the oldest so that
+// no more than numGenerations are kept.  Return true if success, otherwise false with the reason in errorMessage
+bool GenerationBackup::create(const DirectorySnapshot &directory, const unsigned int numGenerations,
+                              const set<string> &modifiedInPlace, string &errorMessage)
+{
+    const int directoryFd = directory.fd();
+    const set<string> &fileNames = directory.fileNames();
+    set<string>::const_iterator nameIt;
+    vector<int> copyFds;
+    struct stat info;
+
+    errorMessage = "";
+    if (numGenerations == 0) return true;
+
+    // Build the new generation to one side (clearing out any left by an earlier failure)
+    if ( (!removeDirectory(directoryFd, GENERATIONBACKUP_NEW_NAME)) ||
+         (mkdirat(directoryFd, GENERATIONBACKUP_NEW_NAME, 0755) != 0) ) {
+        errorMessage = string("failed to create backup directory: ") + strerror(errno);
+        return false;
+    }
+    int backupFd = openat(directoryFd, GENERATIONBACKUP_NEW_NAME, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (backupFd < 0) {
+        errorMessage = string("failed to open backup directory: ") + strerror(errno);
+        removeDirectory(directoryFd, GENERATIONBACKUP_NEW_NAME);
+        return false;
+    }
+
+    // Add every regular file in the database, other than temporaries left by a save
+    for (nameIt = fileNames.begin(); nameIt != fileNames.end(); nameIt++) {
+        const string &fileName = *nameIt;
+
+        if (isGenerationName(fileName)) continue;
+        if ( (fileName.size() > strlen(GENERATIONBACKUP_TEMP_SUFFIX)) &&
+             (fileName.compare(fileName.size() - strlen(GENERATIONBACKUP_TEMP_SUFFIX), string::npos, GENERATIONBACKUP_TEMP_SUFFIX) == 0) ) continue;
+        if ( (fstatat(directoryFd, fileName.c_str(), &info, AT_SYMLINK_NOFOLLOW) != 0) || (!S_ISREG(info.st_mode)) ) continue;
+
+        bool copy = (modifiedInPlace.find(fileName) != modifiedInPlace.end());
+        if ( (!backupFile(directoryFd, backupFd, fileName, copy, copyFds)) ||
+             (!flushCopies(copyFds, GENERATIONBACKUP_MAX_OPEN_COPIES)) ) {
+            errorMessage = "failed to back up " + fileName + ": " + strerror(errno);
+            flushCopies(copyFds, 0);
+            close(backupFd);
+            removeDirectory(directoryFd, GENERATIONBACKUP_NEW_NAME);
+            return false;
+        }
+    }
+
+    // The copies made above, and then the names of every file, must be on disk before the
+    // generation is used
+    if ( (!flushCopies(copyFds, 0)) || (fsync(backupFd) != 0) ) {
+        errorMessage = string("failed to flush backup: ") + strerror(errno);
+        close(backupFd);
+        removeDirectory(directoryFd, GENERATIONBACKUP_NEW_NAME);
+        return false;
+    }
+    close(backupFd);
+
+    // Drop the oldest generation, move the rest down one, and make the new one the most recent
+    if (!removeDirectory(directoryFd, generationName(numGenerations))) {
+        errorMessage = "failed to remove " + generationName(numGenerations) + ": " + strerror(errno);
+        return false;
+    }
+    for (unsigned int generation = numGenerations - 1; generation >= 1; generation--) {
+        if ( (renameat(directoryFd, generationName(generation).c_str(), directoryFd, generationName(generation + 1).c_str()) != 0) &&
+             (errno != ENOENT) ) {
+            errorMessage = "failed to rotate " + generationName(generation) + ": " + strerror(errno);
+            return false;
+        }
+    }
+    if (renameat(directoryFd, GENERATIONBACKUP_NEW_NAME, directoryFd, generationName(1).c_str()) != 0) {
+        errorMessage = "failed to rename new backup: " + string(strerror(errno));
+        return false;
+    }
+
+    fsync(directoryFd);
+    return true;
+}
+
+
+// Add fileName in the directory open on sourceFd to the directory open on backupFd, adding the
+// descriptor of a copy to copyFds.  Return true if success, false otherwise
+bool GenerationBackup::backupFile(const int sourceFd, const int backupFd, const string fileName, const bool copy,
+                                  vector<int> &copyFds)
+{
+    // A hard link shares the file outright.  If the file system cannot link (eg: too many links)
+    // fall back to a copy
+    if ( (!copy) && (linkat(sourceFd, fileName.c_str(), backupFd, fileName.c_str(), 0) == 0) ) return true;
+
+    int sourceFileFd = openat(sourceFd, fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (sourceFileFd < 0) return false;
+
+    int backupFileFd = openat(backupFd, fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (backupFileFd < 0) {
+        close(sourceFileFd);
+        return false;
+    }
+
+    bool copied = MSFileIO::copyFileContents(sourceFileFd, backupFileFd);
+    close(sourceFileFd);
+    if (!copied) {
+        close(backupFileFd);
+        return false;
+    }
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    // Start the write now without waiting for it, so the disk works on every copy while the
+    // rest are being made
+    sync_file_range(backupFileFd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+    copyFds.push_back(backupFileFd);
+    return true;
+}
+
+
+// Wait for the copies open on copyFds, all but the newest maxOpen, to reach the disk, and close
+// them.  Return true if success, false otherwise (every one is closed even so)
+bool GenerationBackup::flushCopies(vector<int> &copyFds, const unsigned long maxOpen)
+{
+    int firstErrno = 0;
+
+    if (copyFds.size() <= maxOpen) return true;
+
+    unsigned long numToFlush = copyFds.size() - maxOpen;
+    for (unsigned long fdNum = 0; fdNum < numToFlush; fdNum++) {
+        if ( (fsync(copyFds[fdNum]) != 0) && (firstErrno == 0) ) firstErrno = errno;
+        if ( (close(copyFds[fdNum]) != 0) && (firstErrno == 0) ) firstErrno = errno;
+    }
+    copyFds.erase(copyFds.begin(), copyFds.begin() + numToFlush);
+
+    // Report the first failure
+    if (firstErrno != 0) errno = firstErrno;
+    return (firstErrno == 0);
+}
+
+
+// Remove the directory name (which holds only files) from the directory open on parentFd,
+// if it exists.  Return true if success, false otherwise
+bool GenerationBackup::removeDirectory(const int parentFd, const string name)
+{
+    int fd = openat(parentFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return (errno == ENOENT);
+
+    // closedir closes fd, but it stays usable for unlinkat until then
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        close(fd);
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if ( (strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0) ) continue;
+        unlinkat(fd, entry->d_name, 0);
+    }
+    closedir(dir);
+
+    return (unlinkat(parentFd, name.c_str(), AT_REMOVEDIR) == 0);
+}
@@ -0,0 +1,56 @@
+/*
+ * Class: GenerationBackup
+ * Author: Marc Stahl
+ * Description: Keeps up to a given number of backup generations of a database,
+ *   each in a directory beside the files (BACKUP.1 being the most recent).  A new
+ *   generation shares the data of every file with the database by hard link, so
+ *   it costs no copying.  Files about to be changed in place are instead shared
+ *   by reflink where the file system allows (or else copied), so the changes do
+ *   not reach the backup.  Files replaced by rename need no such care.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef GENERATIONBACKUP_H
+#define GENERATIONBACKUP_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "directorysnapshot.h"
+
+class GenerationBackup
+{
+public:
+
+    // Create a new generation holding every file in directory, and remove the oldest so that
+    // no more than numGenerations are kept.  Files named in modifiedInPlace are copied (by reflink
+    // if possible) rather than hard linked.  The existing generations are only rotated once the
+    // new one, copies included, is on disk.  Return true if success, otherwise false with the reason in errorMessage
+    static bool create(const DirectorySnapshot &directory, const unsigned int numGenerations,
+                       const std::set<std::string> &modifiedInPlace, std::string &errorMessage);
+
+    // Name of the directory holding a generation (1 is the most recent)
+    static std::string generationName(const unsigned int generation);
+
+    // True if fileName is the name of a generation directory, or of one being built
+    static bool isGenerationName(const std::string fileName);
+
+private:
+
+    // Add fileName in the directory open on sourceFd to the directory open on backupFd.  A copy
+    // is started on its way to disk and its descriptor added to copyFds, to be flushed by
+    // flushCopies().  Return true if success, false otherwise
+    static bool backupFile(const int sourceFd, const int backupFd, const std::string fileName, const bool copy,
+                           std::vector<int> &copyFds);
+
+    // Wait for the copies open on copyFds (all but the newest maxOpen of them) to reach the disk,
+    // and close them.  Return true if success, false otherwise
+    static bool flushCopies(std::vector<int> &copyFds, const unsigned long maxOpen);
+
+    // Remove the directory name (which holds only files) from the directory open on parentFd,
+    // if it exists.  Return true if success, false otherwise
+    static bool removeDirectory(const int parentFd, const std::string name);
+};
+
+#endif // GENERATIONBACKUP_H
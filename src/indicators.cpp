@@ -0,0 +1,281 @@
+/*
+ * Class: Indicators
+ * Author: Marc Stahl
+ * Description: Technical indicators computed over contiguous arrays of prices.
+ *   The loops read and write the arrays in order with no branches on the data
+ *   where possible, so the compiler can keep them in registers (and vectorise
+ *   the parts which do not carry a running value from one position to the next).
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <cmath>
+#include <limits>
+#include "indicators.h"
+
+using namespace std;
+
+
+// Fill result[0, end) with NaN, for the positions before an indicator has enough data
+template <typename T>
+static void fillNaN(T *result, const unsigned long end)
+{
+    const T notANumber = numeric_limits<T>::quiet_NaN();
+    for (unsigned long position = 0; position < end; position++) result[position] = notANumber;
+}
+
+
+// Value of one field of a trading day
+double Indicators::fieldValue(const TradingDay &tradingDay, const EFields field)
+{
+    switch (field) {
+    case EFieldOpen: return tradingDay.open();
+    case EFieldHigh: return tradingDay.high();
+    case EFieldLow: return tradingDay.low();
+    case EFieldClose: return tradingDay.close();
+    case EFieldVolume: return static_cast<double>(tradingDay.volume());
+    case EFieldOpenInterest: return tradingDay.openInterest();
+    }
+    return numeric_limits<double>::quiet_NaN();
+}
+
+
+// Copy one field of every trading day into values
+template <typename T>
+void Indicators::column(const vector<TradingDay> &tradingDays, const EFields field, vector<T> &values)
+{
+    const unsigned long count = tradingDays.size();
+
+    values.resize(count);
+    switch (field) {
+    case EFieldOpen:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = tradingDays[dayNum].open();
+        break;
+    case EFieldHigh:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = tradingDays[dayNum].high();
+        break;
+    case EFieldLow:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = tradingDays[dayNum].low();
+        break;
+    case EFieldClose:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = tradingDays[dayNum].close();
+        break;
+    case EFieldVolume:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = static_cast<T>(tradingDays[dayNum].volume());
+        break;
+    case EFieldOpenInterest:
+        for (unsigned long dayNum = 0; dayNum < count; dayNum++) values[dayNum] = tradingDays[dayNum].openInterest();
+        break;
+    }
+}
+
+
+// Simple moving average of the last period values, kept as a running sum
+template <typename T, typename Accumulator>
+void Indicators::SMA(const T *values, const unsigned long count, const unsigned int period, T *result)
+{
+    if ( (period == 0) || (count < period) ) {
+        fillNaN(result, count);
+        return;
+    }
+
+    const Accumulator scale = Accumulator(1) / period;
+    Accumulator sum = 0;
+
+    for (unsigned long position = 0; position < period - 1; position++) sum += values[position];
+    fillNaN(result, period - 1);
+
+    // Add the newest value, and drop the oldest once it has been used
+    for (unsigned long position = period - 1; position < count; position++) {
+        sum += values[position];
+        result[position] = static_cast<T>(sum * scale);
+        sum -= values[position + 1 - period];
+    }
+}
+
+
+// Exponential moving average with a smoothing factor of 2 / (period + 1), starting from
+// the simple moving average of the first period values
+template <typename T, typename Accumulator>
+void Indicators::EMA(const T *values, const unsigned long count, const unsigned int period, T *result)
+{
+    if ( (period == 0) || (count < period) ) {
+        fillNaN(result, count);
+        return;
+    }
+
+    const Accumulator alpha = Accumulator(2) / (period + 1);
+    Accumulator average = 0;
+
+    for (unsigned long position = 0; position < period; position++) average += values[position];
+    average /= period;
+    fillNaN(result, period - 1);
+    result[period - 1] = static_cast<T>(average);
+
+    for (unsigned long position = period; position < count; position++) {
+        average += alpha * (values[position] - average);
+        result[position] = static_cast<T>(average);
+    }
+}
+
+
+// Relative strength index (0 to 100) over period changes, using Wilder's smoothing.
+// The first value is at position period, once there are period changes
+template <typename T, typename Accumulator>
+void Indicators::RSI(const T *values, const unsigned long count, const unsigned int period, T *result)
+{
+    if ( (period == 0) || (count <= period) ) {
+        fillNaN(result, count);
+        return;
+    }
+
+    Accumulator averageGain = 0;
+    Accumulator averageLoss = 0;
+
+    for (unsigned long position = 1; position <= period; position++) {
+        Accumulator change = Accumulator(values[position]) - values[position - 1];
+        averageGain += (change > 0) ? change : 0;
+        averageLoss += (change < 0) ? -change : 0;
+    }
+    averageGain /= period;
+    averageLoss /= period;
+    fillNaN(result, period);
+
+    // 100 * gain / (gain + loss) is the usual 100 - 100 / (1 + RS), without dividing by a zero loss.
+    // With no movement at all the index is taken to be 50
+    const Accumulator keep = Accumulator(period - 1) / period;
+    const Accumulator scale = Accumulator(1) / period;
+    for (unsigned long position = period; position < count; position++) {
+        if (position > period) {
+            Accumulator change = Accumulator(values[position]) - values[position - 1];
+            averageGain = averageGain * keep + ((change > 0) ? change : 0) * scale;
+            averageLoss = averageLoss * keep + ((change < 0) ? -change : 0) * scale;
+        }
+        Accumulator total = averageGain + averageLoss;
+        result[position] = static_cast<T>((total > 0) ? 100 * averageGain / total : 50);
+    }
+}
+
+
+// Moving average convergence / divergence, its signal line, and the histogram
+template <typename T, typename Accumulator>
+void Indicators::MACD(const T *values, const unsigned long count, const unsigned int fastPeriod, const unsigned int slowPeriod,
+                      const unsigned int signalPeriod, T *macd, T *signal, T *histogram)
+{
+    // The slow EMA is held in signal until the signal line is computed over it
+    EMA<T, Accumulator>(values, count, fastPeriod, macd);
+    EMA<T, Accumulator>(values, count, slowPeriod, signal);
+    for (unsigned long position = 0; position < count; position++) macd[position] -= signal[position];
+
+    // The signal line starts once both EMAs have
+    unsigned long start = ( (fastPeriod > slowPeriod) ? fastPeriod : slowPeriod );
+    start = (start > 0) ? start - 1 : 0;
+    if (start >= count) start = count;
+    fillNaN(signal, start);
+    EMA<T, Accumulator>(macd + start, count - start, signalPeriod, signal + start);
+
+    for (unsigned long position = 0; position < count; position++) histogram[position] = macd[position] - signal[position];
+}
+
+
+// Average true range over period days, using Wilder's smoothing.  The true range of a day is
+// the largest of its range and the distances from the previous close to its high and low
+template <typename T, typename Accumulator>
+void Indicators::ATR(const T *high, const T *low, const T *close, const unsigned long count, const unsigned int period, T *result)
+{
+    if ( (period == 0) || (count < period) ) {
+        fillNaN(result, count);
+        return;
+    }
+
+    Accumulator average = 0;
+    for (unsigned long position = 0; position < count; position++) {
+        Accumulator trueRange = Accumulator(high[position]) - low[position];
+        if (position > 0) {
+            Accumulator highGap = fabs(Accumulator(high[position]) - close[position - 1]);
+            Accumulator lowGap = fabs(Accumulator(low[position]) - close[position - 1]);
+            if (highGap > trueRange) trueRange = highGap;
+            if (lowGap > trueRange) trueRange = lowGap;
+        }
+
+        // The first average is the simple mean of the first period true ranges
+        if (position < period) {
+            average += trueRange;
+            if (position == period - 1) {
+                average /= period;
+                result[position] = static_cast<T>(average);
+            }
+        } else {
+            average = (average * (period - 1) + trueRange) / period;
+            result[position] = static_cast<T>(average);
+        }
+    }
+    fillNaN(result, period - 1);
+}
+
+
+// Bollinger bands around the simple moving average of the last period values, kept as running
+// sums of the values and of their squares
+template <typename T, typename Accumulator>
+void Indicators::bollinger(const T *values, const unsigned long count, const unsigned int period, const T numStdDevs,
+                           T *middle, T *upper, T *lower)
+{
+    if ( (period == 0) || (count < period) ) {
+        fillNaN(middle, count);
+        fillNaN(upper, count);
+        fillNaN(lower, count);
+        return;
+    }
+
+    const Accumulator scale = Accumulator(1) / period;
+    Accumulator sum = 0;
+    Accumulator sumOfSquares = 0;
+
+    for (unsigned long position = 0; position < period - 1; position++) {
+        sum += values[position];
+        sumOfSquares += Accumulator(values[position]) * values[position];
+    }
+    fillNaN(middle, period - 1);
+    fillNaN(upper, period - 1);
+    fillNaN(lower, period - 1);
+
+    for (unsigned long position = period - 1; position < count; position++) {
+        Accumulator value = values[position];
+        sum += value;
+        sumOfSquares += value * value;
+
+        // Rounding can take the variance of a flat series just below zero
+        Accumulator mean = sum * scale;
+        Accumulator variance = sumOfSquares * scale - mean * mean;
+        Accumulator width = numStdDevs * sqrt((variance > 0) ? variance : 0);
+        middle[position] = static_cast<T>(mean);
+        upper[position] = static_cast<T>(mean + width);
+        lower[position] = static_cast<T>(mean - width);
+
+        Accumulator oldest = values[position + 1 - period];
+        sum -= oldest;
+        sumOfSquares -= oldest * oldest;
+    }
+}
+
+
+// The versions provided: float values summed in float or double, and double values summed in double
+template void Indicators::column<float>(const vector<TradingDay> &, const EFields, vector<float> &);
+template void Indicators::column<double>(const vector<TradingDay> &, const EFields, vector<double> &);
+
+#define INDICATORS_INSTANTIATE(T, Accumulator)                                                                          \
+    template void Indicators::SMA<T, Accumulator>(const T *, const unsigned long, const unsigned int, T *);             \
+    template void Indicators::EMA<T, Accumulator>(const T *, const unsigned long, const unsigned int, T *);             \
+    template void Indicators::RSI<T, Accumulator>(const T *, const unsigned long, const unsigned int, T *);             \
+    template void Indicators::MACD<T, Accumulator>(const T *, const unsigned long, const unsigned int,                  \
+                                                   const unsigned int, const unsigned int, T *, T *, T *);              \
+    template void Indicators::ATR<T, Accumulator>(const T *, const T *, const T *, const unsigned long,                 \
+                                                  const unsigned int, T *);                                             \
+    template void Indicators::bollinger<T, Accumulator>(const T *, const unsigned long, const unsigned int, const T,    \
+                                                        T *, T *, T *);
+
+INDICATORS_INSTANTIATE(float, float)
+INDICATORS_INSTANTIATE(float, double)
+INDICATORS_INSTANTIATE(double, double)
+
+#undef INDICATORS_INSTANTIATE
@@ -0,0 +1,77 @@
+/*
+ * Class: Indicators
+ * Author: Marc Stahl
+ * Description: Technical indicators (SMA, EMA, RSI, MACD, ATR, and Bollinger
+ *   bands) computed over contiguous arrays of prices, such as a column of a
+ *   trading history copied out with column().  Every indicator is computed in a
+ *   single O(n) pass with no allocation, writing one result per input value;
+ *   results for positions before the indicator has enough data are NaN.
+ *
+ *   Each function is a template over the type of the values (T) and the type
+ *   sums are accumulated in (Accumulator).  Versions are provided for float
+ *   values with float accumulation (fastest), float values with double
+ *   accumulation (the default: long running sums do not drift), and double
+ *   values with double accumulation.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef INDICATORS_H
+#define INDICATORS_H
+
+#include <vector>
+#include "tradingday.h"
+
+class Indicators
+{
+public:
+
+    // Field of a trading day to copy into a column
+    enum EFields {
+        EFieldOpen,
+        EFieldHigh,
+        EFieldLow,
+        EFieldClose,
+        EFieldVolume,
+        EFieldOpenInterest
+    };
+
+    // Value of one field of a trading day
+    static double fieldValue(const TradingDay &tradingDay, const EFields field);
+
+    // Copy one field of every trading day into values, giving a contiguous array the
+    // indicators can be computed over
+    template <typename T>
+    static void column(const std::vector<TradingDay> &tradingDays, const EFields field, std::vector<T> &values);
+
+    // Simple moving average of the last period values
+    template <typename T, typename Accumulator = double>
+    static void SMA(const T *values, const unsigned long count, const unsigned int period, T *result);
+
+    // Exponential moving average with a smoothing factor of 2 / (period + 1), starting from
+    // the simple moving average of the first period values
+    template <typename T, typename Accumulator = double>
+    static void EMA(const T *values, const unsigned long count, const unsigned int period, T *result);
+
+    // Relative strength index (0 to 100) over period changes, using Wilder's smoothing
+    template <typename T, typename Accumulator = double>
+    static void RSI(const T *values, const unsigned long count, const unsigned int period, T *result);
+
+    // Moving average convergence / divergence: the fast EMA less the slow EMA, the signal
+    // EMA of that, and the histogram (MACD less signal)
+    template <typename T, typename Accumulator = double>
+    static void MACD(const T *values, const unsigned long count, const unsigned int fastPeriod, const unsigned int slowPeriod,
+                     const unsigned int signalPeriod, T *macd, T *signal, T *histogram);
+
+    // Average true range over period days, using Wilder's smoothing
+    template <typename T, typename Accumulator = double>
+    static void ATR(const T *high, const T *low, const T *close, const unsigned long count, const unsigned int period, T *result);
+
+    // Bollinger bands: the simple moving average of the last period values, and that plus
+    // and minus numStdDevs (population) standard deviations of the same values
+    template <typename T, typename Accumulator = double>
+    static void bollinger(const T *values, const unsigned long count, const unsigned int period, const T numStdDevs,
+                          T *middle, T *upper, T *lower);
+};
+
+#endif // INDICATORS_H
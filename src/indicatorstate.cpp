@@ -0,0 +1,331 @@
+/*
+ * Class: IndicatorState (and SMAState, EMAState, RSIState, ATRState)
+ * Author: Marc Stahl
+ * Description: The running state of a technical indicator, updated one trading
+ *   day at a time.  Each state keeps what it overwrote on the last day added,
+ *   so that day can be replaced without going back to the first.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <cmath>
+#include <limits>
+#include "indicatorstate.h"
+
+using namespace std;
+
+
+// Constructor: Create a state which has seen no trading days
+IndicatorState::IndicatorState() :
+    m_numDays(0),
+    m_value(numeric_limits<double>::quiet_NaN())
+{
+}
+
+
+// Destructor required since this is a base class
+IndicatorState::~IndicatorState()
+{
+}
+
+
+// Number of trading days added since the last reset
+unsigned long IndicatorState::numDays() const
+{
+    return m_numDays;
+}
+
+
+// True once enough days have been added for value() to be valid
+bool IndicatorState::ready() const
+{
+    return !std::isnan(m_value);
+}
+
+
+// Value of the indicator as of the last day added (NaN until ready())
+double IndicatorState::value() const
+{
+    return m_value;
+}
+
+
+// Forget every day added
+void IndicatorState::reset()
+{
+    clear();
+    m_numDays = 0;
+    m_value = numeric_limits<double>::quiet_NaN();
+}
+
+
+// Add the trading day after the last one added
+void IndicatorState::add(const TradingDay &tradingDay)
+{
+    m_value = advance(tradingDay);
+    m_numDays++;
+}
+
+
+// Replace the last day added with tradingDay.  Return false if no day has been added
+bool IndicatorState::replaceLast(const TradingDay &tradingDay)
+{
+    if (m_numDays == 0) return false;
+
+    undoLast();
+    m_value = advance(tradingDay);
+    return true;
+}
+
+
+//----------------------------------------------------------------------------
+// SMAState
+
+// Constructor: Average the field given (eg: close) over period days
+SMAState::SMAState(const Indicators::EFields field, const unsigned int period) :
+    m_field(field),
+    m_period(period),
+    m_values(period),
+    m_next(0),
+    m_count(0),
+    m_sum(0),
+    m_previousSum(0),
+    m_previousDropped(0)
+{
+}
+
+
+// Forget every day added
+void SMAState::clear()
+{
+    m_next = 0;
+    m_count = 0;
+    m_sum = 0;
+}
+
+
+// Add the newest value to the ring and the sum.  As in Indicators::SMA(), the oldest value
+// in the window is taken off the sum once the average has been worked out
+double SMAState::advance(const TradingDay &tradingDay)
+{
+    if (m_period == 0) return numeric_limits<double>::quiet_NaN();
+
+    double value = Indicators::fieldValue(tradingDay, m_field);
+    m_previousSum = m_sum;
+    m_previousDropped = m_values[m_next];
+    m_values[m_next] = value;
+    m_next = (m_next + 1) % m_period;
+    m_count++;
+
+    m_sum += value;
+    if (m_count < m_period) return numeric_limits<double>::quiet_NaN();
+    double average = m_sum * (1.0 / m_period);
+    m_sum -= m_values[m_next];
+    return average;
+}
+
+
+// Put back the sum and the value overwritten in the ring
+void SMAState::undoLast()
+{
+    if (m_period == 0) return;
+
+    m_next = (m_next + m_period - 1) % m_period;
+    m_values[m_next] = m_previousDropped;
+    m_sum = m_previousSum;
+    m_count--;
+}
+
+
+//----------------------------------------------------------------------------
+// EMAState
+
+// Constructor: Average the field given (eg: close) with a smoothing factor of 2 / (period + 1)
+EMAState::EMAState(const Indicators::EFields field, const unsigned int period) :
+    m_field(field),
+    m_period(period),
+    m_alpha(2.0 / (period + 1)),
+    m_count(0),
+    m_average(0),
+    m_previousAverage(0)
+{
+}
+
+
+// Forget every day added
+void EMAState::clear()
+{
+    m_count = 0;
+    m_average = 0;
+}
+
+
+// Sum the first period values, then smooth each value into the average
+double EMAState::advance(const TradingDay &tradingDay)
+{
+    double value = Indicators::fieldValue(tradingDay, m_field);
+
+    m_previousAverage = m_average;
+    m_count++;
+    if (m_period == 0) return numeric_limits<double>::quiet_NaN();
+    if (m_count < m_period) {
+        m_average += value;
+        return numeric_limits<double>::quiet_NaN();
+    }
+    if (m_count == m_period) {
+        m_average += value;
+        m_average /= m_period;
+    } else {
+        m_average += m_alpha * (value - m_average);
+    }
+    return m_average;
+}
+
+
+// Put back the average from before the last day
+void EMAState::undoLast()
+{
+    m_average = m_previousAverage;
+    m_count--;
+}
+
+
+//----------------------------------------------------------------------------
+// RSIState
+
+// Constructor: Index the close over period changes
+RSIState::RSIState(const unsigned int period) :
+    m_period(period),
+    m_count(0),
+    m_lastClose(0),
+    m_averageGain(0),
+    m_averageLoss(0),
+    m_previousLastClose(0),
+    m_previousAverageGain(0),
+    m_previousAverageLoss(0)
+{
+}
+
+
+// Forget every day added
+void RSIState::clear()
+{
+    m_count = 0;
+    m_lastClose = 0;
+    m_averageGain = 0;
+    m_averageLoss = 0;
+}
+
+
+// Sum the gains and losses of the first period changes, then smooth each change in as
+// Indicators::RSI() does
+double RSIState::advance(const TradingDay &tradingDay)
+{
+    double close = tradingDay.close();
+
+    m_previousLastClose = m_lastClose;
+    m_previousAverageGain = m_averageGain;
+    m_previousAverageLoss = m_averageLoss;
+    m_count++;
+    m_lastClose = close;
+    if ( (m_period == 0) || (m_count == 1) ) return numeric_limits<double>::quiet_NaN();
+
+    double change = close - m_previousLastClose;
+    double gain = (change > 0) ? change : 0;
+    double loss = (change < 0) ? -change : 0;
+    if (m_count <= m_period) {
+        m_averageGain += gain;
+        m_averageLoss += loss;
+        return numeric_limits<double>::quiet_NaN();
+    }
+    if (m_count == m_period + 1) {
+        m_averageGain += gain;
+        m_averageLoss += loss;
+        m_averageGain /= m_period;
+        m_averageLoss /= m_period;
+    } else {
+        const double keep = double(m_period - 1) / m_period;
+        const double scale = 1.0 / m_period;
+        m_averageGain = m_averageGain * keep + gain * scale;
+        m_averageLoss = m_averageLoss * keep + loss * scale;
+    }
+
+    double total = m_averageGain + m_averageLoss;
+    return (total > 0) ? 100 * m_averageGain / total : 50;
+}
+
+
+// Put back the close and averages from before the last day
+void RSIState::undoLast()
+{
+    m_lastClose = m_previousLastClose;
+    m_averageGain = m_previousAverageGain;
+    m_averageLoss = m_previousAverageLoss;
+    m_count--;
+}
+
+
+//----------------------------------------------------------------------------
+// ATRState
+
+// Constructor: Average the true range over period days
+ATRState::ATRState(const unsigned int period) :
+    m_period(period),
+    m_count(0),
+    m_lastClose(0),
+    m_average(0),
+    m_previousLastClose(0),
+    m_previousAverage(0)
+{
+}
+
+
+// Forget every day added
+void ATRState::clear()
+{
+    m_count = 0;
+    m_lastClose = 0;
+    m_average = 0;
+}
+
+
+// Sum the true ranges of the first period days, then smooth each one in as Indicators::ATR() does
+double ATRState::advance(const TradingDay &tradingDay)
+{
+    double high = tradingDay.high();
+    double low = tradingDay.low();
+    double trueRange = high - low;
+
+    if (m_count > 0) {
+        double highGap = fabs(high - m_lastClose);
+        double lowGap = fabs(low - m_lastClose);
+        if (highGap > trueRange) trueRange = highGap;
+        if (lowGap > trueRange) trueRange = lowGap;
+    }
+
+    m_previousLastClose = m_lastClose;
+    m_previousAverage = m_average;
+    m_count++;
+    m_lastClose = tradingDay.close();
+    if (m_period == 0) return numeric_limits<double>::quiet_NaN();
+    if (m_count < m_period) {
+        m_average += trueRange;
+        return numeric_limits<double>::quiet_NaN();
+    }
+    if (m_count == m_period) {
+        m_average += trueRange;
+        m_average /= m_period;
+    } else {
+        m_average = (m_average * (m_period - 1) + trueRange) / m_period;
+    }
+    return m_average;
+}
+
+
+// Put back the close and average from before the last day
+void ATRState::undoLast()
+{
+    m_lastClose = m_previousLastClose;
+    m_average = m_previousAverage;
+    m_count--;
+}
@@ -0,0 +1,193 @@
+/*
+ * Class: IndicatorState (and SMAState, EMAState, RSIState, ATRState)
+ * Author: Marc Stahl
+ * Description: The running state of a technical indicator, updated one trading
+ *   day at a time.  Adding a day, or replacing the last day added (eg: the bar
+ *   still forming during an intraday refresh), takes constant time, so an
+ *   indicator attached to an equity's trading history stays current as days are
+ *   appended without being recomputed from the first day.  The values match
+ *   those computed over a whole column by the Indicators class.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef INDICATORSTATE_H
+#define INDICATORSTATE_H
+
+#include <vector>
+#include "indicators.h"
+#include "tradingday.h"
+
+class IndicatorState
+{
+public:
+
+    // Constructor: Create a state which has seen no trading days
+    IndicatorState();
+
+    // Destructor required since this is a base class
+    virtual ~IndicatorState();
+
+    // Number of trading days added since the last reset
+    unsigned long numDays() const;
+
+    // True once enough days have been added for value() to be valid
+    bool ready() const;
+
+    // Value of the indicator as of the last day added (NaN until ready())
+    double value() const;
+
+    // Forget every day added
+    void reset();
+
+    // Add the trading day after the last one added
+    void add(const TradingDay &tradingDay);
+
+    // Replace the last day added with tradingDay.  Return false if no day has been added
+    bool replaceLast(const TradingDay &tradingDay);
+
+protected:
+
+    // Forget every day added
+    virtual void clear() = 0;
+
+    // Move the state on by one day, returning the value of the indicator (NaN during warm up)
+    virtual double advance(const TradingDay &tradingDay) = 0;
+
+    // Return the state to what it was before the last call to advance()
+    virtual void undoLast() = 0;
+
+private:
+
+    // Number of trading days added, and the value of the indicator after the last
+    unsigned long m_numDays;
+    double m_value;
+
+    // A state is the running state of one series, so copying is not allowed
+    IndicatorState(const IndicatorState &);
+    void operator=(const IndicatorState &);
+};
+
+
+// Simple moving average of a field over the last period days
+class SMAState : public IndicatorState
+{
+public:
+
+    // Constructor: Average the field given (eg: close) over period days
+    SMAState(const Indicators::EFields field, const unsigned int period);
+
+protected:
+
+    // IndicatorState overrides
+    void clear();
+    double advance(const TradingDay &tradingDay);
+    void undoLast();
+
+private:
+
+    Indicators::EFields m_field;
+    unsigned int m_period;
+
+    // The last period values, in a ring with the oldest at m_next once full
+    std::vector<double> m_values;
+    unsigned int m_next;
+    unsigned long m_count;
+    double m_sum;
+
+    // Sum, and value overwritten in the ring, before the last day was added
+    double m_previousSum;
+    double m_previousDropped;
+};
+
+
+// Exponential moving average of a field, starting from the simple average of the first period days
+class EMAState : public IndicatorState
+{
+public:
+
+    // Constructor: Average the field given (eg: close) with a smoothing factor of 2 / (period + 1)
+    EMAState(const Indicators::EFields field, const unsigned int period);
+
+protected:
+
+    // IndicatorState overrides
+    void clear();
+    double advance(const TradingDay &tradingDay);
+    void undoLast();
+
+private:
+
+    Indicators::EFields m_field;
+    unsigned int m_period;
+    double m_alpha;
+    unsigned long m_count;
+
+    // The average (the sum, until period days have been added), and its value before the last day
+    double m_average;
+    double m_previousAverage;
+};
+
+
+// Relative strength index (0 to 100) of the close over period changes, using Wilder's smoothing
+class RSIState : public IndicatorState
+{
+public:
+
+    // Constructor: Index the close over period changes
+    RSIState(const unsigned int period);
+
+protected:
+
+    // IndicatorState overrides
+    void clear();
+    double advance(const TradingDay &tradingDay);
+    void undoLast();
+
+private:
+
+    unsigned int m_period;
+    unsigned long m_count;
+
+    // Last close, and the average gain and loss (sums, until period changes have been seen)
+    double m_lastClose;
+    double m_averageGain;
+    double m_averageLoss;
+
+    // The same before the last day was added
+    double m_previousLastClose;
+    double m_previousAverageGain;
+    double m_previousAverageLoss;
+};
+
+
+// Average true range over period days, using Wilder's smoothing
+class ATRState : public IndicatorState
+{
+public:
+
+    // Constructor: Average the true range over period days
+    ATRState(const unsigned int period);
+
+protected:
+
+    // IndicatorState overrides
+    void clear();
+    double advance(const TradingDay &tradingDay);
+    void undoLast();
+
+private:
+
+    unsigned int m_period;
+    unsigned long m_count;
+
+    // Last close, and the average true range (the sum, until period days have been added)
+    double m_lastClose;
+    double m_average;
+
+    // The same before the last day was added
+    double m_previousLastClose;
+    double m_previousAverage;
+};
+
+#endif // INDICATORSTATE_H
@@ -0,0 +1,363 @@
+/*
+ * Class: Journal
+ * Author: Marc Stahl
+ * Description: A write-ahead journal of trading days added to a database, with
+ *   group commit.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "journal.h"
+#include "msfileio.h"
+
+using namespace std;
+
+// Identifies a journal file, and the version of its layout
+#define JOURNAL_MAGIC         "MSDBJRN1"
+#define JOURNAL_HEADER_SIZE   8
+
+// Size of an entry apart from its symbol: symbol length, date, six floats, volume, checksum
+#define JOURNAL_ENTRY_FIXED_SIZE   (1 + 4 + 6 * 4 + 8 + 4)
+
+// Appended to the journal's name to give the name of a compacted journal being written
+#define JOURNAL_TEMP_SUFFIX        ".tmp"
+
+
+// Append an unsigned value to buffer as numBytes little endian bytes
+static void putUInt(string &buffer, unsigned long long value, const int numBytes)
+{
+    for (int byteNum = 0; byteNum < numBytes; byteNum++, value >>= 8) buffer += static_cast<char>(value & 0xff);
+}
+
+
+// Read numBytes little endian bytes from data as an unsigned value
+static unsigned long long getUInt(const unsigned char *data, const int numBytes)
+{
+    unsigned long long value = 0;
+    for (int byteNum = numBytes - 1; byteNum >= 0; byteNum--) value = (value << 8) | data[byteNum];
+    return value;
+}
+
+
+// Append a float to buffer, as the 4 bytes of its IEEE form
+static void putFloat(string &buffer, const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    putUInt(buffer, bits, 4);
+}
+
+
+// Read a float stored by putFloat
+static float getFloat(const unsigned char *data)
+{
+    uint32_t bits = getUInt(data, 4);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+
+// Constructor: Create a journal with no file open
+Journal::Journal() :
+    m_fd(-1),
+    m_directory(NULL),
+    m_fileSize(0),
+    m_appendedSequence(0),
+    m_durableSequence(0),
+    m_flushing(false),
+    m_failed(false)
+{
+}
+
+
+// Destructor: Close the journal file
+Journal::~Journal()
+{
+    close();
+}
+
+
+// Open (creating if needed) the journal file, and read every entry in it into entries.
+// Return true if success, otherwise false with the reason in errorMessage
+bool Journal::open(const DirectorySnapshot &directory, const string fileName, vector<Entry> &entries, string &errorMessage)
+{
+    struct stat info;
+    string contents;
+
+    close();
+    entries.clear();
+    errorMessage = "";
+
+    m_directory = &directory;
+    m_fileName = fileName;
+    m_fd = directory.openFile(fileName, O_RDWR | O_CREAT, 0644);
+    if ( (m_fd < 0) || (fstat(m_fd, &info) != 0) ) {
+        errorMessage = "failed to open journal " + fileName + ": " + strerror(errno);
+        close();
+        return false;
+    }
+
+    // Read the whole journal
+    contents.resize(info.st_size);
+    size_t bytesRead = 0;
+    while (bytesRead < contents.size()) {
+        ssize_t result = pread(m_fd, &contents[bytesRead], contents.size() - bytesRead, bytesRead);
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result <= 0) {
+            errorMessage = "failed to read journal " + fileName + ": " + strerror(errno);
+            close();
+            return false;
+        }
+        bytesRead += result;
+    }
+
+    // A file which is not a journal is left alone.  A header cut short is treated as an empty journal
+    if ( (contents.size() >= JOURNAL_HEADER_SIZE) && (contents.compare(0, JOURNAL_HEADER_SIZE, JOURNAL_MAGIC) != 0) ) {
+        errorMessage = fileName + " is not a journal";
+        close();
+        return false;
+    }
+
+    size_t validSize = JOURNAL_HEADER_SIZE;
+    if (contents.size() >= JOURNAL_HEADER_SIZE) {
+        Entry entry;
+        while (decodeEntry(contents, validSize, entry)) entries.push_back(entry);
+    }
+
+    // Write a fresh header, or cut off anything after the last complete entry
+    if (contents.size() < JOURNAL_HEADER_SIZE) {
+        if ( (ftruncate(m_fd, 0) != 0) || (pwrite(m_fd, JOURNAL_MAGIC, JOURNAL_HEADER_SIZE, 0) != JOURNAL_HEADER_SIZE) ||
+             (fdatasync(m_fd) != 0) ) {
+            errorMessage = "failed to initialise journal " + fileName + ": " + strerror(errno);
+            close();
+            return false;
+        }
+    } else if (validSize < contents.size()) {
+        if ( (ftruncate(m_fd, validSize) != 0) || (fdatasync(m_fd) != 0) ) {
+            errorMessage = "failed to repair journal " + fileName + ": " + strerror(errno);
+            close();
+            return false;
+        }
+    }
+
+    m_fileSize = validSize;
+    return true;
+}
+
+
+// True if a journal file is open
+bool Journal::isOpen() const
+{
+    return (m_fd >= 0);
+}
+
+
+// Add a trading day to the journal, returning its sequence number
+unsigned long long Journal::append(const string symbol, const TradingDay &tradingDay)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    encodeEntry(symbol, tradingDay, m_pending);
+    return ++m_appendedSequence;
+}
+
+
+// Wait until every entry up to and including sequence is on disk, writing them if no other thread is.
+// Return true if success, otherwise false with the reason in errorMessage
+bool Journal::waitDurable(const unsigned long long sequence, string &errorMessage)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    errorMessage = "";
+    while (m_durableSequence < sequence) {
+        if (m_failed) {
+            errorMessage = m_failureMessage;
+            return false;
+        }
+
+        // Another thread is writing; it may or may not include this entry, so check again after
+        if (m_flushing) {
+            m_flushed.wait(lock);
+            continue;
+        }
+
+        // Write everything buffered so far, on behalf of every waiting thread.  Others may
+        // append while this thread writes; they are picked up by the next flush
+        string batch;
+        batch.swap(m_pending);
+        unsigned long long batchSequence = m_appendedSequence;
+        long long offset = m_fileSize;
+        m_fileSize += batch.size();
+        m_flushing = true;
+        lock.unlock();
+
+        bool written = true;
+        size_t bytesWritten = 0;
+        while ( (written) && (bytesWritten < batch.size()) ) {
+            ssize_t result = pwrite(m_fd, batch.data() + bytesWritten, batch.size() - bytesWritten, offset + bytesWritten);
+            if ((result < 0) && (errno == EINTR)) continue;
+            if (result <= 0) written = false;
+            else bytesWritten += result;
+        }
+        if ( (written) && (fdatasync(m_fd) != 0) ) written = false;
+        int writeErrno = errno;
+
+        lock.lock();
+        m_flushing = false;
+        if (written) {
+            if (batchSequence > m_durableSequence) m_durableSequence = batchSequence;
+        } else {
+            m_failed = true;
+            m_failureMessage = string("failed to write journal: ") + strerror(writeErrno);
+        }
+        m_flushed.notify_all();
+    }
+    return true;
+}
+
+
+// Empty the journal, once every entry in it has been saved to the data files.
+// Return true if success, otherwise false with the reason in errorMessage
+bool Journal::clear(string &errorMessage)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    errorMessage = "";
+    if (m_fd < 0) return true;
+
+    // Let any write under way finish, so it does not land after the truncation
+    while (m_flushing) m_flushed.wait(lock);
+
+    // Everything appended is now in the data files, so is as good as on disk
+    m_pending.clear();
+    m_durableSequence = m_appendedSequence;
+    m_flushed.notify_all();
+
+    if ( (ftruncate(m_fd, JOURNAL_HEADER_SIZE) != 0) || (fdatasync(m_fd) != 0) ) {
+        errorMessage = string("failed to empty journal: ") + strerror(errno);
+        return false;
+    }
+    m_fileSize = JOURNAL_HEADER_SIZE;
+    m_failed = false;
+    return true;
+}
+
+
+// Replace the journal with one holding only entries, once every other entry in it has been saved.
+// Return true if success, otherwise false with the reason in errorMessage
+bool Journal::compact(const vector<Entry> &entries, string &errorMessage)
+{
+    unique_lock<mutex> lock(m_mutex);
+    string contents(JOURNAL_MAGIC, JOURNAL_HEADER_SIZE);
+    string tempName = m_fileName + JOURNAL_TEMP_SUFFIX;
+
+    errorMessage = "";
+    if (m_fd < 0) return true;
+
+    // Let any write under way finish, so it does not land in the old file after the rename
+    while (m_flushing) m_flushed.wait(lock);
+
+    for (unsigned long entryNum = 0; entryNum < entries.size(); entryNum++)
+        encodeEntry(entries[entryNum].symbol, entries[entryNum].tradingDay, contents);
+
+    // The new journal must be on disk, under its final name, before the old one's entries are
+    // treated as done
+    int fd = m_directory->openFile(tempName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( (fd < 0) || (!MSFileIO::writeBufferToFile(fd, 0, contents)) || (fdatasync(fd) != 0) ||
+         (renameat(m_directory->fd(), tempName.c_str(), m_directory->fd(), m_fileName.c_str()) != 0) ) {
+        errorMessage = string("failed to compact journal: ") + strerror(errno);
+        if (fd >= 0) ::close(fd);
+        unlinkat(m_directory->fd(), tempName.c_str(), 0);
+        return false;
+    }
+    ::close(m_fd);
+    m_fd = fd;
+    m_fileSize = contents.size();
+
+    // Everything appended is now in the data files or the new journal, so is as good as on disk
+    m_pending.clear();
+    m_durableSequence = m_appendedSequence;
+    m_failed = false;
+    m_flushed.notify_all();
+
+    if (fsync(m_directory->fd()) != 0) {
+        errorMessage = string("failed to flush directory: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+
+// Close the journal file
+void Journal::close()
+{
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+    m_fileSize = 0;
+    m_pending.clear();
+}
+
+
+// Encode an entry onto the end of buffer
+void Journal::encodeEntry(const string &symbol, const TradingDay &tradingDay, string &buffer)
+{
+    size_t start = buffer.size();
+    size_t symbolLength = (symbol.size() < 255) ? symbol.size() : 255;
+
+    putUInt(buffer, symbolLength, 1);
+    buffer.append(symbol, 0, symbolLength);
+    putUInt(buffer, tradingDay.date().asYYYYMMDD(), 4);
+    putFloat(buffer, tradingDay.time());
+    putFloat(buffer, tradingDay.open());
+    putFloat(buffer, tradingDay.close());
+    putFloat(buffer, tradingDay.high());
+    putFloat(buffer, tradingDay.low());
+    putFloat(buffer, tradingDay.openInterest());
+    putUInt(buffer, tradingDay.volume(), 8);
+    putUInt(buffer, checksum(reinterpret_cast<const unsigned char *>(buffer.data()) + start, buffer.size() - start), 4);
+}
+
+
+// Decode the entry at offset in buffer, and advance offset past it.
+// Return false if there is no complete, undamaged entry at offset
+bool Journal::decodeEntry(const string &buffer, size_t &offset, Entry &entry)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(buffer.data()) + offset;
+    size_t available = buffer.size() - offset;
+
+    if (available < 1) return false;
+    size_t symbolLength = data[0];
+    size_t entrySize = JOURNAL_ENTRY_FIXED_SIZE + symbolLength;
+    if (available < entrySize) return false;
+    if (getUInt(data + entrySize - 4, 4) != checksum(data, entrySize - 4)) return false;
+
+    const unsigned char *field = data + 1 + symbolLength;
+    unsigned long date = getUInt(field, 4);
+    entry.symbol.assign(reinterpret_cast<const char *>(data + 1), symbolLength);
+    entry.tradingDay = TradingDay((date == 0) ? Date() : Date(date / 10000, (date / 100) % 100, date % 100),
+                                  getFloat(field + 4), getFloat(field + 8), getFloat(field + 12),
+                                  getFloat(field + 16), getFloat(field + 20), getUInt(field + 28, 8), getFloat(field + 24));
+
+    offset += entrySize;
+    return true;
+}
+
+
+// Checksum of size bytes of data (32 bit FNV-1a)
+unsigned long Journal::checksum(const unsigned char *data, const size_t size)
+{
+    unsigned long hash = 2166136261UL;
+
+    for (size_t byteNum = 0; byteNum < size; byteNum++) {
+        hash ^= data[byteNum];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
@@ -0,0 +1,119 @@
+/*
+ * Class: Journal
+ * Author: Marc Stahl
+ * Description: A write-ahead journal of trading days added to a database.  Each
+ *   day added is appended to a small binary file in the database directory, so
+ *   it survives a crash without any MetaStock file being rewritten.  Threads
+ *   waiting for their days to reach the disk share one write and flush (group
+ *   commit), so many days added together cost one flush.  The journal is read
+ *   back when the database is next opened, and emptied once a save has put its
+ *   days into the data files (a checkpoint).  Days which could not be saved yet
+ *   are kept by compacting the journal down to just those days instead.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "directorysnapshot.h"
+#include "tradingday.h"
+
+class Journal
+{
+public:
+
+    // One trading day read back from the journal
+    struct Entry {
+        std::string symbol;      // Symbol of the equity the day was added to
+        TradingDay tradingDay;   // The day added
+    };
+
+    // Constructor: Create a journal with no file open
+    Journal();
+
+    // Destructor: Close the journal file
+    ~Journal();
+
+    // Open (creating if needed) the journal file fileName in directory, and read every entry in
+    // it into entries.  Anything after the last complete entry (eg: a write cut short by a crash)
+    // is discarded.  Return true if success, otherwise false with the reason in errorMessage
+    bool open(const DirectorySnapshot &directory, const std::string fileName, std::vector<Entry> &entries, std::string &errorMessage);
+
+    // True if a journal file is open
+    bool isOpen() const;
+
+    // Add a trading day to the journal.  The day is only buffered; pass the sequence number
+    // returned to waitDurable() to wait until it is on disk
+    unsigned long long append(const std::string symbol, const TradingDay &tradingDay);
+
+    // Wait until every entry up to and including sequence is on disk.  If no other thread is
+    // writing, this thread writes and flushes everything buffered so far on behalf of all of
+    // them.  Return true if success, otherwise false with the reason in errorMessage
+    bool waitDurable(const unsigned long long sequence, std::string &errorMessage);
+
+    // Empty the journal, once every entry in it has been saved to the data files.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool clear(std::string &errorMessage);
+
+    // Replace the journal with one holding only entries, once every other entry in it has been
+    // saved to the data files.  The new journal is written beside the old one and renamed over
+    // it, so a crash leaves one or the other.  Return true if success, otherwise false with the
+    // reason in errorMessage (the old journal is then kept)
+    bool compact(const std::vector<Entry> &entries, std::string &errorMessage);
+
+    // Close the journal file
+    void close();
+
+private:
+
+    // Descriptor of the journal file, or -1 if none
+    int m_fd;
+
+    // Directory holding the journal file, and its name (set by open())
+    const DirectorySnapshot *m_directory;
+    std::string m_fileName;
+
+    // Size of the journal file, including entries being written
+    long long m_fileSize;
+
+    // Encoded entries not yet written
+    std::string m_pending;
+
+    // Sequence number of the last entry appended, and of the last one known to be on disk
+    unsigned long long m_appendedSequence;
+    unsigned long long m_durableSequence;
+
+    // Is a thread writing and flushing entries
+    bool m_flushing;
+
+    // Set if a write failed; nothing more can be made durable
+    bool m_failed;
+    std::string m_failureMessage;
+
+    // Guards every member above (the file itself is only written by the flushing thread)
+    std::mutex m_mutex;
+
+    // Signalled whenever a flush finishes
+    std::condition_variable m_flushed;
+
+    // Encode an entry onto the end of buffer
+    static void encodeEntry(const std::string &symbol, const TradingDay &tradingDay, std::string &buffer);
+
+    // Decode the entry at offset in buffer, and advance offset past it.
+    // Return false if there is no complete, undamaged entry at offset
+    static bool decodeEntry(const std::string &buffer, size_t &offset, Entry &entry);
+
+    // Checksum of size bytes of data, stored after each entry to detect damage
+    static unsigned long checksum(const unsigned char *data, const size_t size);
+
+    // The object owns a file, so copying is not allowed
+    Journal(const Journal &);
+    void operator=(const Journal &);
+};
+
+#endif // JOURNAL_H
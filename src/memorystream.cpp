@@ -0,0 +1,68 @@
+/*
+ * Class: MemoryStream
+ * Author: Marc Stahl
+ * Description: Internal input stream reading from a buffer it owns, without
+ *   copying it.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include "memorystream.h"
+
+using namespace std;
+
+
+// Read from the size bytes at data, starting at the first
+void MemoryStream::Buffer::setData(char *data, const size_t size)
+{
+    setg(data, data, data + size);
+}
+
+
+// Move the read position relative to the start, current position, or end.
+// Return the new position, or -1 if it would be outside the buffer
+streambuf::pos_type MemoryStream::Buffer::seekoff(off_type offset, ios_base::seekdir direction, ios_base::openmode mode)
+{
+    off_type position;
+
+    if (!(mode & ios_base::in)) return pos_type(off_type(-1));
+
+    if (direction == ios_base::beg) position = offset;
+    else if (direction == ios_base::cur) position = (gptr() - eback()) + offset;
+    else position = (egptr() - eback()) + offset;
+
+    if ( (position < 0) || (position > egptr() - eback()) ) return pos_type(off_type(-1));
+    setg(eback(), eback() + position, egptr());
+    return pos_type(position);
+}
+
+
+// Move the read position to an absolute position
+streambuf::pos_type MemoryStream::Buffer::seekpos(pos_type position, ios_base::openmode mode)
+{
+    return seekoff(off_type(position), ios_base::beg, mode);
+}
+
+
+// Constructor: Create a stream over an empty buffer
+MemoryStream::MemoryStream() :
+    istream(NULL)
+{
+    m_streamBuffer.setData(NULL, 0);
+    rdbuf(&m_streamBuffer);
+}
+
+
+// The buffer the stream reads from.  Call reset() after changing it
+string & MemoryStream::buffer()
+{
+    return m_buffer;
+}
+
+
+// Read from the start of the buffer, clearing any error state
+void MemoryStream::reset()
+{
+    m_streamBuffer.setData(m_buffer.empty() ? NULL : &m_buffer[0], m_buffer.size());
+    clear();
+}
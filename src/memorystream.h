@@ -0,0 +1,62 @@
+/*
+ * Class: MemoryStream
+ * Author: Marc Stahl
+ * Description: Internal input stream reading from a buffer it owns.  A file is
+ *   read straight into the buffer and the stream then reads (and seeks) within
+ *   it, so unlike an istringstream the bytes are not copied a second time into
+ *   the stream.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef MEMORYSTREAM_H
+#define MEMORYSTREAM_H
+
+#include <istream>
+#include <streambuf>
+#include <string>
+
+class MemoryStream : public std::istream
+{
+public:
+
+    // Constructor: Create a stream over an empty buffer
+    MemoryStream();
+
+    // The buffer the stream reads from.  Call reset() after changing it
+    std::string & buffer();
+
+    // Read from the start of the buffer, clearing any error state
+    void reset();
+
+private:
+
+    // Stream buffer reading from a block of memory it does not own
+    class Buffer : public std::streambuf
+    {
+    public:
+
+        // Read from the size bytes at data, starting at the first
+        void setData(char *data, const size_t size);
+
+    protected:
+
+        // Move the read position relative to the start, current position, or end
+        pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode);
+
+        // Move the read position to an absolute position
+        pos_type seekpos(pos_type position, std::ios_base::openmode mode);
+    };
+
+    // Bytes the stream reads from
+    std::string m_buffer;
+
+    // Stream buffer over m_buffer
+    Buffer m_streamBuffer;
+
+    // The stream buffer points into m_buffer, so copying is not allowed
+    MemoryStream(const MemoryStream &);
+    void operator=(const MemoryStream &);
+};
+
+#endif // MEMORYSTREAM_H
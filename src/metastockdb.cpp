@@ -6,14 +6,23 @@
  *   MKS    2018-Jan-19   Original coding
  */
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <set>
 #include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 #include "metastockdb.h"
 #include "msfileio.h"
 #include "bytearray.h"
 #include "equityindb.h"
 #include "activefields.h"
+#include "tradingdatawriter.h"
+#include "filetransaction.h"
+#include "generationbackup.h"
 
 using namespace std;
 
@@ -142,6 +151,25 @@ using namespace std;
 //The offset into the first record of a TDF where the number of records resides
 #define TRADINGDATAFILE_NUM_RECORDS_OFFSET               2
 
+// Name of the journal of trading days added but not yet saved
+#define JOURNAL_FILE_NAME                                "JOURNAL"
+
+// Largest data file number which can be listed in MASTER / EMASTER, and in XMASTER
+#define MASTER_LARGEST_FDATNUM                           255
+#define XMASTER_LARGEST_FDATNUM                          65535
+
+// Longest symbol and description which can be held in MASTER / EMASTER, and in XMASTER
+#define MASTER_SYMBOL_LENGTH                             13     // EMASTER holds one less than MASTER
+#define MASTER_DESCRIPTION_LENGTH                        16
+#define XMASTER_SYMBOL_LENGTH                            14
+#define XMASTER_DESCRIPTION_LENGTH                       23
+
+// MASTER file type of an equity added by this library (CT file type 'e')
+#define MASTER_NEW_EQUITY_FILETYPE                       0x65
+
+// Fields held for an equity added by this library: date, open, high, low, close, volume, open interest
+#define NEW_EQUITY_NUM_FIELDS                            7
+
 
 
 // Open a metastock database at the specified path
@@ -158,6 +186,9 @@ MetaStockDB::MetaStockDB(const string dbpath, const bool lazyLoad, const unsigne
     m_lazyLoad(lazyLoad),
     m_isnew(true),
     m_numBackups(numBackups),
+    m_saveMode(ESaveModeInPlace),
+    m_mastersChanged(false),
+    m_commitInterrupted(false),
     m_DBerror(false),
     m_MasterNumRecords(0),
     m_MasterLastDataFileNumber(0),
@@ -179,11 +210,19 @@ MetaStockDB::MetaStockDB(const string dbpath, const bool lazyLoad, const unsigne
     // If encountered an error reading ?MASTER file
     bool readMasterOK = false;
 
-    // Check if path exists.  If not create it as new DB
-    if (MSFileIO::DBPathExists(m_DBpath)) {
+    // Open the path and list its files once.  If it does not exist create it as new DB
+    if (m_directory.open(m_DBpath)) {
+
+        // Finish any atomic save cut short by a crash, so the files read are all old or all new
+        string errorMessage;
+        if (!FileTransaction::recover(m_directory, errorMessage)) {
+            m_lastError = EErrorTransactionRecoveryFailed;
+            m_lastErrorMessage = "Error finishing an interrupted save: " + errorMessage;
+        }
+        m_directory.refresh();
 
         // If the MASTER exists
-        if (MSFileIO::fileInDBPathExists(m_DBpath,"MASTER")) {
+        if ( (m_lastError == EErrorNone) && (m_directory.contains("MASTER")) ) {
 
             // This is not a new database
             m_isnew = false;
@@ -192,13 +231,13 @@ MetaStockDB::MetaStockDB(const string dbpath, const bool lazyLoad, const unsigne
             readMasterOK = readMasterFile();
 
             // If MASTER read ok, check for an EMASTER
-            if ( (readMasterOK) && (MSFileIO::fileInDBPathExists(m_DBpath,"EMASTER")) ) {
+            if ( (readMasterOK) && (m_directory.contains("EMASTER")) ) {
 
                 // Attempt to read the EMASTER file
                 readMasterOK = readEMasterFile();
 
                 // If EMASTER read ok, check for an EMASTER
-                if ( (readMasterOK) && (MSFileIO::fileInDBPathExists(m_DBpath,"XMASTER")) ) {
+                if ( (readMasterOK) && (m_directory.contains("XMASTER")) ) {
 
                     // Attempt to read the XMASTER file - set flag if error
                     readMasterOK = readXMasterFile();
@@ -211,8 +250,8 @@ MetaStockDB::MetaStockDB(const string dbpath, const bool lazyLoad, const unsigne
     else {
         MSFileIO::makeDBPath(m_DBpath);
 
-        // Success if read the path
-        if (!MSFileIO::DBPathExists(m_DBpath)) {
+        // Success if can open the new path
+        if (!m_directory.open(m_DBpath)) {
             m_lastError = EErrorDBpathCreateFailed;
             m_lastErrorMessage = "Error creating the DB path '"+m_DBpath+"'";
         }
@@ -223,6 +262,15 @@ MetaStockDB::MetaStockDB(const string dbpath, const bool lazyLoad, const unsigne
     if (( !m_isnew) && (readMasterOK) && (!m_lazyLoad)) {
         populateTradingData();
     }
+
+    // Recover any trading days added but not saved before the database was last closed
+    if ( (readMasterOK) && (m_directory.contains(JOURNAL_FILE_NAME)) ) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        openJournalWhileLocked();
+    }
+
+    // Readers always have a snapshot available, even for a new or failed database
+    publishSnapshot();
 }
 
 
@@ -231,6 +279,9 @@ MetaStockDB::~MetaStockDB()
 {
     map<string, EquityInDB*>::iterator it;
 
+    // The flusher thread uses the equities, so must finish first
+    disableWriteBehind();
+
     //Delete all EquityInDB objects pointed to by the map
     for(it = m_equityMap.begin(); it != m_equityMap.end(); it++)
         delete (it->second);
@@ -256,6 +307,18 @@ std::string MetaStockDB::lastErrorMessage() const {
 }
 
 
+// Read the whole of a file in the database directory straight into the buffer of a stream, so
+// the ?MASTER and data file readers can seek within it without further system calls or copies.
+// Return true if success, false otherwise
+bool MetaStockDB::openDBFile(const string fileName, MemoryStream &file) const
+{
+    bool fileRead = m_directory.readFile(fileName, file.buffer());
+
+    file.reset();
+    return fileRead;
+}
+
+
 //============================================================================
 // MASTER file
 
@@ -266,7 +329,8 @@ bool MetaStockDB::readMasterFile()
     bool errorOccured;  // were there any problems that occured in this function
     unsigned char tempInterdayPeriodicity;
     unsigned long int tempIntradayPeriodicity;
-    ifstream file(m_DBpath+"MASTER", ios::in|ios::binary);
+    MemoryStream file;
+    bool fileOpened = openDBFile("MASTER", file);
 
     //These variables are for holding the data that is read from MASTER before it is added to the map
     unsigned long int TDFFileNum;
@@ -289,7 +353,7 @@ bool MetaStockDB::readMasterFile()
 
 
     errorOccured = false;  // Assume no error
-    while (file.is_open())
+    while (fileOpened)
     {
         // read the 3 pieces of data from the header record
         if (!MSFileIO::readUIntFromFile(file, MASTER_NUMRECORDS_FILE_OFFSET, m_MasterNumRecords, MSFileIO::EVariableTypeUShort ))
@@ -467,19 +531,22 @@ bool MetaStockDB::readMasterFile()
                 break;
             }
 
-            // Add the object to our map container
-            m_equityMap.insert(std::pair<string, EquityInDB*>(symbol, new EquityInDB(TDFFileNum, fileType, fieldLength, static_cast<unsigned int>(numFields), MASTERFiller2,
+            // Add the object to our map container, remembering where its record is
+            pair<map<string, EquityInDB*>::iterator, bool> inserted =
+                    m_equityMap.insert(std::pair<string, EquityInDB*>(symbol, new EquityInDB(TDFFileNum, fileType, fieldLength, static_cast<unsigned int>(numFields), MASTERFiller2,
                                                                              description, MASTERFiller3, CT_V2_8_FLAG, firstDate, lastDate,
                                                                              interdayPeriodicity, intradayPeriodicity, symbol, MASTERFiller4,
                                                                              flag, MASTERFiller5)));
+            if (inserted.second) {
+                inserted.first->second->masterRecordNum(recordNum);
+                inserted.first->second->writerMutex(&m_writerMutex);
+            }
 
         }
         break;
     }
-    // If the file is open then close it
-    if (file.is_open())
-        file.close();
-    else
+    // If the file could not be opened, report it
+    if (!fileOpened)
     {
         m_lastError = EErrorMASTERFileOpenFailed;
         m_lastErrorMessage = "Failed to open MASTER file '" + m_DBpath + "'";
@@ -501,7 +568,8 @@ bool MetaStockDB::readEMasterFile()
 
     bool errorOccured; // were there any problems that occured in this function
     map<string, EquityInDB*>::iterator currentEquityIterator; // an iterator that stores the position of the equity currently in use.
-    ifstream file(m_DBpath+"EMASTER", ios::in|ios::binary); // the EMASTER file.
+    MemoryStream file; // the EMASTER file.
+    bool fileOpened = openDBFile("EMASTER", file);
     string currentSymbol; // this is the map key. It is read from the file and used to find the correct equity in the map.
 
     // Info from EMASTER that is also in MASTER; gets compared to ensure a match.
@@ -537,7 +605,7 @@ bool MetaStockDB::readEMasterFile()
 
     //Error flag starts as false, and if there is an error, it it set to true
     errorOccured = false;
-    while (file.is_open())
+    while (fileOpened)
     {
         //--------------------------------------------------------------------
         // read the header
@@ -625,6 +693,7 @@ bool MetaStockDB::readEMasterFile()
                 errorOccured = true;
                 break;
             }
+            MSFileIO::trim(tempDescription);  // As the description read from MASTER is
             if (!MSFileIO::readDateFromFile(file, recordNum * EMASTER_RECORD_SIZE + EMASTER_FIRST_DATE_RECORD_OFFSET, tempFirstDate, MSFileIO::EVariableTypeCVS))
             {
                 m_lastError = EErrorEMASTERRecordRead;
@@ -844,13 +913,12 @@ bool MetaStockDB::readEMasterFile()
                         lastDivPaid,
                         lastDivAdjRate,
                         EMASTERFiller11);
+            (currentEquityIterator->second)->EMASTERRecordNum(recordNum);
         }
         break;
     }
-    // If the file is open then close it
-    if (file.is_open())
-        file.close();
-    else
+    // If the file could not be opened, report it
+    if (!fileOpened)
     {
         cout << "ERROR: File did not open." << endl << endl;
         errorOccured = true;
@@ -902,10 +970,11 @@ bool MetaStockDB::readXMasterFile()
     ByteArray XMASTERFiller14(XMASTER_FILLER14_LENGTH);
 
 
-    ifstream file(m_DBpath+"XMASTER", ios::in|ios::binary);
+    MemoryStream file;
+    bool fileOpened = openDBFile("XMASTER", file);
 
     errorOccured = false;  // Assume no error
-    while (file.is_open())
+    while (fileOpened)
     {
         //--------------------------------------------------------------------
         // read the header contained in the first record
@@ -1119,8 +1188,8 @@ bool MetaStockDB::readXMasterFile()
                 break;
             }
 
-            // Add the struct to our map container
-            m_equityMap.insert(std::pair<string, EquityInDB*>
+            // Add the struct to our map container, remembering where its record is
+            pair<map<string, EquityInDB*>::iterator, bool> inserted = m_equityMap.insert(std::pair<string, EquityInDB*>
                                (symbol,
                                 new EquityInDB(
                                     XMASTERFiller5,
@@ -1140,13 +1209,15 @@ bool MetaStockDB::readXMasterFile()
                                     lastDate,
                                     XMASTERFiller13,
                                     XMASTERFiller14)));
+            if (inserted.second) {
+                inserted.first->second->masterRecordNum(recordNum);
+                inserted.first->second->writerMutex(&m_writerMutex);
+            }
         }
         break;
     }
-    // If the file is open then close it
-    if (file.is_open())
-        file.close();
-    else
+    // If the file could not be opened, report it
+    if (!fileOpened)
     {
         m_lastError = EErrorXMASTERFileOpenFailed;
         m_lastErrorMessage = "Failed to open XMASTER file '" + m_DBpath + "'";
@@ -1164,13 +1235,145 @@ bool MetaStockDB::readXMasterFile()
 //============================================================================
 // FDAT/MWD files
 
-// Read the trading data from FDAT/MWD files for each equity held in the map
+// Read the trading data from FDAT/MWD files for each equity held in the map.
+// An equity which fails to load is recorded in m_loadFailures and loading carries on
+// with the next equity.  Return true if every equity loaded
 bool MetaStockDB::populateTradingData()
 {
-    bool errorOccured = false; // were there any problems that occured in this function
     map<string, EquityInDB*>::iterator equityIterator; // an iterator that stores the position of the equity currently in use.
-    ifstream file;
+
+    m_loadFailures.clear();
+
+    // Loop through equities held in map
+    for(equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++)
+        loadTradingDataOrRecordFailure(equityIterator->second);
+
+    return m_loadFailures.empty();
+}
+
+
+// Retry loading only the equities which failed to load previously.  The directory is
+// listed again first, so data files which were missing may now be found.
+// Return true if every failed equity now loaded
+bool MetaStockDB::retryFailedEquities()
+{
+    vector<LoadFailure> previousFailures;
+    map<string, EquityInDB*>::iterator equityIterator;
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    // Pick up any files which were added or repaired since the last attempt
+    m_directory.refresh();
+
+    previousFailures.swap(m_loadFailures);
+    for (unsigned long failureNum = 0; failureNum < previousFailures.size(); failureNum++) {
+        equityIterator = m_equityMap.find(previousFailures[failureNum].symbol);
+        if (equityIterator != m_equityMap.end())
+            loadTradingDataOrRecordFailure(equityIterator->second);
+    }
+
+    // Let readers see the reloaded equities
+    publishSnapshotWhileLocked();
+
+    return m_loadFailures.empty();
+}
+
+
+// Load the trading data of the equities given which are not yet loaded, and publish a
+// snapshot holding them.  Return true if every equity given that exists is now loaded
+bool MetaStockDB::loadEquities(const vector<string> &symbols)
+{
+    map<string, EquityInDB*>::iterator equityIterator;
+    bool loadedAny = false;
+    bool allLoaded = true;
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    for (unsigned long symbolNum = 0; symbolNum < symbols.size(); symbolNum++) {
+        equityIterator = m_equityMap.find(symbols[symbolNum]);
+        if (equityIterator == m_equityMap.end()) continue;
+
+        EquityInDB* equity = equityIterator->second;
+        if (equity->loadStatus() == EquityInDB::ELoadStatusNotLoaded) {
+            loadTradingDataOrRecordFailure(equity);
+            loadedAny = true;
+        }
+        if (equity->loadStatus() != EquityInDB::ELoadStatusLoaded) allLoaded = false;
+    }
+
+    // Let readers see the equities just loaded
+    if (loadedAny) publishSnapshotWhileLocked();
+
+    return allLoaded;
+}
+
+
+// Number of equities which failed to load in the last load or retry
+unsigned long MetaStockDB::numLoadFailures() const
+{
+    return m_loadFailures.size();
+}
+
+
+// Get the symbol, error code and message of one failed equity (0 <= failureNum < numLoadFailures()).
+// Return true if success, false if failureNum is out of range
+bool MetaStockDB::getLoadFailure(const unsigned long failureNum, string &symbol, EErrors &error, string &errorMessage) const
+{
+    if (failureNum >= m_loadFailures.size()) return false;
+
+    symbol = m_loadFailures[failureNum].symbol;
+    error = m_loadFailures[failureNum].error;
+    errorMessage = m_loadFailures[failureNum].message;
+    return true;
+}
+
+
+// Load the trading data of one equity, and on failure record it in m_loadFailures and
+// as the last error
+void MetaStockDB::loadTradingDataOrRecordFailure(EquityInDB* equity)
+{
+    LoadFailure failure;
+
+    if (loadTradingData(equity, failure.error, failure.message)) {
+
+        // Days added before the equity was loaded are only in the journal (loading replaced them)
+        map<string, vector<TradingDay> >::iterator pinnedIt = m_pinnedDays.find(equity->symbol());
+        if (pinnedIt == m_pinnedDays.end()) return;
+        for (unsigned long dayNum = 0; dayNum < pinnedIt->second.size(); dayNum++)
+            equity->tradingHistory()->addTradingDayData(pinnedIt->second[dayNum]);
+        m_pinnedDays.erase(pinnedIt);
+        return;
+    }
+
+    failure.symbol = equity->symbol();
+    m_loadFailures.push_back(failure);
+    m_lastError = failure.error;
+    m_lastErrorMessage = failure.message;
+}
+
+
+// Load the trading data of an equity not loaded yet, before days are added to it.  m_writerMutex
+// must be held by the caller.  Return true if the days may be added: the equity is loaded, or
+// its file failed to load but the journal keeps the days until it does
+bool MetaStockDB::loadForChangeWhileLocked(EquityInDB* equity)
+{
+    if (equity->loadStatus() == EquityInDB::ELoadStatusNotLoaded) loadTradingDataOrRecordFailure(equity);
+    return ( (equity->loadStatus() == EquityInDB::ELoadStatusLoaded) || (m_journal.isOpen()) );
+}
+
+
+// Read the trading data from the FDAT/MWD file of one equity.
+// If the file cannot be read completely the equity is left with no trading days, marked
+// as failed, and error / errorMessage describe the problem.
+// Return true if success, false otherwise
+bool MetaStockDB::loadTradingData(EquityInDB* equity, EErrors &error, string &errorMessage)
+{
+    bool errorOccured = false; // were there any problems that occured in this function
+    MemoryStream file;
     string fileName;
+    TradingHistory* tradingHistory = equity->tradingHistory();
+
+    // Dates from ?MASTER, restored if the load fails part way
+    Date masterFirstDate = tradingHistory->firstDate();
+    Date masterLastDate = tradingHistory->lastDate();
 
     Date date;
     float time;
@@ -1185,149 +1388,145 @@ bool MetaStockDB::populateTradingData()
     unsigned short recordSize;
     unsigned long numRecords;
 
-    // Loop through equities help in map
-    for(equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++)
+    error = EErrorNone;
+    errorMessage = "";
 
-        // Block should go into function, param equitymetadata
-    {
+    // Throw away anything from an earlier attempt
+    tradingHistory->reset(masterFirstDate, masterLastDate);
 
+    // This while loop exists so that this block of code can be exited easily with a break statement.
+    // If there is an error reading from the file, then exit this block.
+    while (true)
+    {
         // Construct data file filename
-        if ((equityIterator->second)->dataFileType() == EquityInDB::EDataFileTypes::EDataFileTypeFDAT) {
-            fileName = "F" + to_string((equityIterator->second)->TDFFileNum()) + ".DAT";
-        } else {
-            fileName = "C" + to_string((equityIterator->second)->TDFFileNum()) + ".MWD";
-        }
+        fileName = dataFileName(equity);
 
-        // Check if file exists
-        if (! MSFileIO::fileInDBPathExists(m_DBpath,fileName)) {
-
-            m_lastError = EErrorTradingDataFileDoesntExist;
-            m_lastErrorMessage = "Error: file " + fileName + " does not exist";
+        // Check if file exists (in the listing taken when the database was opened)
+        if (! m_directory.contains(fileName)) {
+            error = EErrorTradingDataFileDoesntExist;
+            errorMessage = "Error: file " + fileName + " does not exist";
             errorOccured = true;
             break;
         }
 
         // Open the file
-        file.open(m_DBpath+fileName, ios::in|ios::binary);
-        if (!file.is_open())
+        if (!openDBFile(fileName, file))
         {
-            m_lastError = EErrorTradingDataFileOpenFailed;
-            m_lastErrorMessage = "Error: file " + fileName + " did not open";
+            error = EErrorTradingDataFileOpenFailed;
+            errorMessage = "Error: file " + fileName + " did not open";
             errorOccured = true;
             break;
         }
 
         //Retrieve info from the map, about the records in this TDF file
-        activeFields = (equityIterator->second)->activeFields();
+        activeFields = equity->activeFields();
         recordSize = activeFields.recordSize();
 
         //Read the number of records in this file, from the first record
         if (!MSFileIO::readUIntFromFile(file, TRADINGDATAFILE_NUM_RECORDS_OFFSET, numRecords, MSFileIO::EVariableTypeUShort))
         {
-            m_lastError = EErrorTradingDataFileFieldRead;
-            m_lastErrorMessage = "Error reading number of records from start of file " + fileName;
+            error = EErrorTradingDataFileFieldRead;
+            errorMessage = "Error reading number of records from start of file " + fileName;
             errorOccured = true;
             break;
         }
 
-
-        // This while loop exists so that this block of code can be exited easily with a break statement.
-        // If there is an error reading a field from the file, then exit this block.
-        while (file.is_open())
+        for (unsigned short recordNum = 1; recordNum < numRecords; recordNum++)
         {
-            //If the file opened properly
-            for (unsigned short recordNum = 1; recordNum < numRecords; recordNum++)
-            {
-
-                // Reset all fields to default values, so unread values save as 0 in the trading day
-                date = Date();
-                time = 0;
-                open = 0;
-                close = 0;
-                high = 0;
-                low = 0;
-                tempVolume = 0;
-                volume = 0;
-                openInterest = 0;
-
-                // Read the time from the data file, only if active
-                if ( (activeFields.dateActive()) &&
-                     (!MSFileIO::readDateFromFile(file, recordNum * recordSize + activeFields.dateOffset(), date, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading date in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Reset all fields to default values, so unread values save as 0 in the trading day
+            date = Date();
+            time = 0;
+            open = 0;
+            close = 0;
+            high = 0;
+            low = 0;
+            tempVolume = 0;
+            volume = 0;
+            openInterest = 0;
 
-                // Read the time from the data file, only if active
-                if ( (activeFields.timeActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.timeOffset(), time, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading time in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Read the time from the data file, only if active
+            if ( (activeFields.dateActive()) &&
+                 (!MSFileIO::readDateFromFile(file, recordNum * recordSize + activeFields.dateOffset(), date, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading date in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                // Read the open value from the data file, only if active
-                if ( (activeFields.openActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.openOffset(), open, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading open in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Read the time from the data file, only if active
+            if ( (activeFields.timeActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.timeOffset(), time, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading time in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                // Read the close value from the data file, only if active
-                if ( (activeFields.closeActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.closeOffset(), close, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading close in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Read the open value from the data file, only if active
+            if ( (activeFields.openActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.openOffset(), open, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading open in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                // Read the close value from the data file, only if active
-                if ( (activeFields.highActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.highOffset(), high, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading high in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Read the close value from the data file, only if active
+            if ( (activeFields.closeActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.closeOffset(), close, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading close in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                // Read the low value from the data file, only if active
-                if ( (activeFields.lowActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.lowOffset(), low, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading low in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                }
+            // Read the close value from the data file, only if active
+            if ( (activeFields.highActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.highOffset(), high, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading high in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                // Read the close value from the data file, only if active
-                if ( (activeFields.volumeActive()) &&
-                     (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.volumeOffset(), tempVolume, MSFileIO::EVariableTypeMBF32)) ) {
-                    m_lastError = EErrorTradingDataFileFieldRead;
-                    m_lastErrorMessage = "Error reading volume in record from the file " + fileName;
-                    errorOccured = true;
-                    break;
-                } else {
-                    volume = static_cast<unsigned long int>(tempVolume);
-                }
+            // Read the low value from the data file, only if active
+            if ( (activeFields.lowActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.lowOffset(), low, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading low in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            }
 
-                if (! (equityIterator->second)->tradingHistory()->addTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest))) {
-                    m_lastError = EErrorTradingDataFileDuplicateDate;
-                    m_lastErrorMessage = "Error found in duplicate trading day data date ("+date.asString(Date::EDateFormatYYYYMMMDD)+")";
-                    errorOccured = true;
-                    break;
-                }
+            // Read the close value from the data file, only if active
+            if ( (activeFields.volumeActive()) &&
+                 (!MSFileIO::readFloatFromFile(file, recordNum * recordSize + activeFields.volumeOffset(), tempVolume, MSFileIO::EVariableTypeMBF32)) ) {
+                error = EErrorTradingDataFileFieldRead;
+                errorMessage = "Error reading volume in record from the file " + fileName;
+                errorOccured = true;
+                break;
+            } else {
+                volume = static_cast<unsigned long int>(tempVolume);
+            }
 
-                // Set data loaded flag to true
-                (equityIterator->second)->tradingHistory()->loaded(true);
+            if (! tradingHistory->addTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest))) {
+                error = EErrorTradingDataFileDuplicateDate;
+                errorMessage = "Error found in duplicate trading day data date ("+date.asString(Date::EDateFormatYYYYMMMDD)+") in file " + fileName;
+                errorOccured = true;
+                break;
             }
-            file.close();
-            break;
         }
+        break;
+    }
+
+    // On failure do not leave a partial history behind, so the equity is either fully loaded or empty
+    if (errorOccured) {
+        tradingHistory->reset(masterFirstDate, masterLastDate);
+        equity->loadStatus(EquityInDB::ELoadStatusFailed);
+    } else {
+        tradingHistory->loaded(true);
+        tradingHistory->markSaved();
+        equity->loadStatus(EquityInDB::ELoadStatusLoaded);
     }
 
     // Return whether file was read entirely without a problem
@@ -1335,6 +1534,703 @@ bool MetaStockDB::populateTradingData()
 
 }
 
+
+// Name of the Fx.DAT / Cx.MWD file holding the trading data of an equity
+string MetaStockDB::dataFileName(EquityInDB* equity) const
+{
+    if (equity->dataFileType() == EquityInDB::EDataFileTypes::EDataFileTypeFDAT)
+        return "F" + to_string(equity->TDFFileNum()) + ".DAT";
+    return "C" + to_string(equity->TDFFileNum()) + ".MWD";
+}
+
+
+// Encode the MASTER record of equity into contents at recordOffset.
+// Return false if a value cannot be held in the record
+bool MetaStockDB::encodeMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const
+{
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_FDAT_FILENUM_RECORD_OFFSET, equity->TDFFileNum(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_FILETYPE_RECORD_OFFSET, equity->fileType(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_BYTEFIELD_LENGTH_RECORD_OFFSET, equity->fieldLength(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_NUMFIELDS_RECORD_OFFSET, equity->activeFields().numFields(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + MASTER_FILLER2_RECORD_OFFSET, equity->MASTERFiller2());
+    MSFileIO::writeStringToBuffer(contents, recordOffset + MASTER_DESCRIPTION_RECORD_OFFSET, 16, equity->description());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + MASTER_FILLER3_RECORD_OFFSET, equity->MASTERFiller3());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_CT_V2_8_FLAG_RECORD_OFFSET, equity->CT_V2_8_FLAG(), MSFileIO::EVariableTypeUByte);
+    if ( (!MSFileIO::writeDateToBuffer(contents, recordOffset + MASTER_FIRST_DATE_RECORD_OFFSET, equity->tradingHistory()->firstDate(), MSFileIO::EVariableTypeMBF32)) ||
+         (!MSFileIO::writeDateToBuffer(contents, recordOffset + MASTER_LAST_DATE_RECORD_OFFSET, equity->tradingHistory()->lastDate(), MSFileIO::EVariableTypeMBF32)) )
+        return false;
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_INTERDAY_P_RECORD_OFFSET, equity->interdayPeriodicity(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_INTRADAY_P_RECORD_OFFSET, equity->intradayPeriodicity(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeStringToBuffer(contents, recordOffset + MASTER_SYMBOL_RECORD_OFFSET, 14, equity->symbol());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + MASTER_FILLER4_RECORD_OFFSET, equity->MASTERFiller4());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + MASTER_FLAG_RECORD_OFFSET, equity->flag(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + MASTER_FILLER5_RECORD_OFFSET, equity->MASTERFiller5());
+    return true;
+}
+
+
+// Encode the EMASTER record of equity into contents at recordOffset.
+// Return false if a value cannot be held in the record
+bool MetaStockDB::encodeEMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const
+{
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_ID_CODE_RECORD_OFFSET, equity->IDCode(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_FDAT_FILENUM_RECORD_OFFSET, equity->TDFFileNum(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER2_RECORD_OFFSET, equity->EMASTERFiller2());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_NUM_ACTIVE_FIELDS_RECORD_OFFSET, equity->activeFields().numFields(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_BITMASK_ACTIVE_FIELDS_RECORD_OFFSET, equity->activeFields().bitMask(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER3_RECORD_OFFSET, equity->EMASTERFiller3());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_AUTO_RUN_RECORD_OFFSET, equity->autoRun(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER4_RECORD_OFFSET, equity->EMASTERFiller4());
+    MSFileIO::writeStringToBuffer(contents, recordOffset + EMASTER_SYMBOL_RECORD_OFFSET, 13, equity->symbol());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER5_RECORD_OFFSET, equity->EMASTERFiller5());
+    MSFileIO::writeStringToBuffer(contents, recordOffset + EMASTER_DESCRIPTION_RECORD_OFFSET, 16, equity->description());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER6_RECORD_OFFSET, equity->EMASTERFiller6());
+    if ( (!MSFileIO::writeDateToBuffer(contents, recordOffset + EMASTER_FIRST_DATE_RECORD_OFFSET, equity->tradingHistory()->firstDate(), MSFileIO::EVariableTypeCVS)) ||
+         (!MSFileIO::writeDateToBuffer(contents, recordOffset + EMASTER_LAST_DATE_RECORD_OFFSET, equity->tradingHistory()->lastDate(), MSFileIO::EVariableTypeCVS)) )
+        return false;
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER7_RECORD_OFFSET, equity->EMASTERFiller7());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER8_RECORD_OFFSET, equity->EMASTERFiller8());
+    MSFileIO::writeFloatToBuffer(contents, recordOffset + EMASTER_INTRADAY_START_TIME_RECORD_OFFSET, equity->intradayStartTime(), MSFileIO::EVariableTypeCVSR);
+    MSFileIO::writeFloatToBuffer(contents, recordOffset + EMASTER_INTRADAY_END_TIME_RECORD_OFFSET, equity->intradayEndTime(), MSFileIO::EVariableTypeCVSR);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER9_RECORD_OFFSET, equity->EMASTERFiller9());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER10_RECORD_OFFSET, equity->EMASTERFiller10());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + EMASTER_LAST_DIV_PAID_RECORD_OFFSET, equity->lastDivPaid(), MSFileIO::EVariableTypeCVL);
+    MSFileIO::writeFloatToBuffer(contents, recordOffset + EMASTER_LAST_DIV_ADJUSTMENT_RATE_RECORD_OFFSET, equity->lastDivAdjRate(), MSFileIO::EVariableTypeCVSR);
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + EMASTER_FILLER11_RECORD_OFFSET, equity->EMASTERFiller11());
+    return true;
+}
+
+
+// Encode the XMASTER record of equity into contents at recordOffset.
+// Return false if a value cannot be held in the record
+bool MetaStockDB::encodeXMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const
+{
+    // Some filler fields overlap the fields around them, so the fillers are written first and
+    // the known fields over them
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER5_RECORD_OFFSET, equity->XMASTERFiller5());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER6_RECORD_OFFSET, equity->XMASTERFiller6());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER7_RECORD_OFFSET, equity->XMASTERFiller7());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER8_RECORD_OFFSET, equity->XMASTERFiller8());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER9_RECORD_OFFSET, equity->XMASTERFiller9());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER10_RECORD_OFFSET, equity->XMASTERFiller10());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER11_RECORD_OFFSET, equity->XMASTERFiller11());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER12_RECORD_OFFSET, equity->XMASTERFiller12());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER13_RECORD_OFFSET, equity->XMASTERFiller13());
+    MSFileIO::writeByteArrayToBuffer(contents, recordOffset + XMASTER_FILLER14_RECORD_OFFSET, equity->XMASTERFiller14());
+
+    MSFileIO::writeStringToBuffer(contents, recordOffset + XMASTER_SYMBOL_RECORD_OFFSET, 14, equity->symbol());
+    MSFileIO::writeStringToBuffer(contents, recordOffset + XMASTER_DESCRIPTION_RECORD_OFFSET, 23, equity->description());
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + XMASTER_INTERDAY_P_RECORD_OFFSET, equity->interdayPeriodicity(), MSFileIO::EVariableTypeUByte);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + XMASTER_FDAT_FILENUM_RECORD_OFFSET, equity->TDFFileNum(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeUIntToBuffer(contents, recordOffset + XMASTER_BITMASK_ACTIVE_FIELDS_RECORD_OFFSET, equity->activeFields().bitMask(), MSFileIO::EVariableTypeUByte);
+    if ( (!MSFileIO::writeDateToBuffer(contents, recordOffset + XMASTER_FIRST_DATE_LONG_RECORD_OFFSET, equity->tradingHistory()->firstDate(), MSFileIO::EVariableTypeCVL)) ||
+         (!MSFileIO::writeDateToBuffer(contents, recordOffset + XMASTER_FIRST_DATE_RECORD_OFFSET, equity->tradingHistory()->firstDate(), MSFileIO::EVariableTypeCVSR)) ||
+         (!MSFileIO::writeDateToBuffer(contents, recordOffset + XMASTER_LAST_DATE_LONG_RECORD_OFFSET, equity->tradingHistory()->lastDate(), MSFileIO::EVariableTypeCVL)) ||
+         (!MSFileIO::writeDateToBuffer(contents, recordOffset + XMASTER_LAST_DATE_RECORD_OFFSET, equity->tradingHistory()->lastDate(), MSFileIO::EVariableTypeCVSR)) )
+        return false;
+    return true;
+}
+
+
+// Build the contents of the MASTER file listing equities (in file number order).
+// Return false if a value cannot be held in the file
+bool MetaStockDB::buildMasterFile(const vector<EquityInDB*> &equities, string &contents) const
+{
+    unsigned long largestFileNum = 0;
+
+    contents.assign((equities.size() + 1) * MASTER_RECORD_SIZE, '\0');
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (equities[equityNum]->TDFFileNum() > largestFileNum) largestFileNum = equities[equityNum]->TDFFileNum();
+
+    // Header
+    MSFileIO::writeUIntToBuffer(contents, MASTER_NUMRECORDS_FILE_OFFSET, equities.size(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeUIntToBuffer(contents, MASTER_LARGEST_FDATNUM_FILE_OFFSET, largestFileNum, MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeByteArrayToBuffer(contents, MASTER_FILLER1_FILE_OFFSET, m_MASTERFiller1);
+
+    // One record per equity, following the header
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (!encodeMasterRecord(equities[equityNum], contents, (equityNum + 1) * MASTER_RECORD_SIZE)) return false;
+    return true;
+}
+
+
+// Build the contents of the EMASTER file listing equities (in file number order), which must
+// be the same equities as in MASTER.  Return false if a value cannot be held in the file
+bool MetaStockDB::buildEMasterFile(const vector<EquityInDB*> &equities, string &contents) const
+{
+    unsigned long largestFileNum = 0;
+
+    contents.assign((equities.size() + 1) * EMASTER_RECORD_SIZE, '\0');
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (equities[equityNum]->TDFFileNum() > largestFileNum) largestFileNum = equities[equityNum]->TDFFileNum();
+
+    // Header, which must match the MASTER header
+    MSFileIO::writeUIntToBuffer(contents, EMASTER_NUMRECORDS_FILE_OFFSET, equities.size(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeUIntToBuffer(contents, EMASTER_LARGEST_FDATNUM_FILE_OFFSET, largestFileNum, MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeByteArrayToBuffer(contents, EMASTER_FILLER1_FILE_OFFSET, m_EMASTERFiller1);
+
+    // One record per equity, following the header
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (!encodeEMasterRecord(equities[equityNum], contents, (equityNum + 1) * EMASTER_RECORD_SIZE)) return false;
+    return true;
+}
+
+
+// Build the contents of the XMASTER file listing equities (in file number order).
+// Return false if a value cannot be held in the file
+bool MetaStockDB::buildXMasterFile(const vector<EquityInDB*> &equities, string &contents) const
+{
+    unsigned long largestFileNum = 0;
+
+    contents.assign((equities.size() + 1) * XMASTER_RECORD_SIZE, '\0');
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (equities[equityNum]->TDFFileNum() > largestFileNum) largestFileNum = equities[equityNum]->TDFFileNum();
+
+    // Header
+    MSFileIO::writeByteArrayToBuffer(contents, XMASTER_FILLER1_FILE_OFFSET, m_XMASTERFiller1);
+    MSFileIO::writeUIntToBuffer(contents, XMASTER_NUMRECORDS_FILE_OFFSET, equities.size(), MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeByteArrayToBuffer(contents, XMASTER_FILLER2_FILE_OFFSET, m_XMASTERFiller2);
+    MSFileIO::writeByteArrayToBuffer(contents, XMASTER_FILLER3_FILE_OFFSET, m_XMASTERFiller3);
+    MSFileIO::writeUIntToBuffer(contents, XMASTER_LARGEST_FDATNUM_FILE_OFFSET, largestFileNum, MSFileIO::EVariableTypeUShort);
+    MSFileIO::writeByteArrayToBuffer(contents, XMASTER_FILLER4_FILE_OFFSET, m_XMASTERFiller4);
+
+    // One record per equity, following the header
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++)
+        if (!encodeXMasterRecord(equities[equityNum], contents, (equityNum + 1) * XMASTER_RECORD_SIZE)) return false;
+    return true;
+}
+
+
+// Write new ?MASTER files listing every equity, as part of transaction.  Equities with Fx.DAT
+// files go in MASTER and EMASTER, the rest in XMASTER (only written if used or already present).
+// Return true if success, otherwise false with the reason in errorMessage
+bool MetaStockDB::writeMasterFiles(FileTransaction &transaction, string &errorMessage)
+{
+    map<unsigned long, EquityInDB*> masterEquitiesByNum;
+    map<unsigned long, EquityInDB*> xmasterEquitiesByNum;
+    map<unsigned long, EquityInDB*>::iterator numIt;
+    map<string, EquityInDB*>::iterator equityIterator;
+    vector<EquityInDB*> masterEquities;
+    vector<EquityInDB*> xmasterEquities;
+    string contents;
+
+    errorMessage = "";
+
+    // List the equities in file number order, as MetaStock does
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++) {
+        EquityInDB* equity = equityIterator->second;
+        if (equity->dataFileType() == EquityInDB::EDataFileTypeFDAT) masterEquitiesByNum[equity->TDFFileNum()] = equity;
+        else xmasterEquitiesByNum[equity->TDFFileNum()] = equity;
+    }
+    for (numIt = masterEquitiesByNum.begin(); numIt != masterEquitiesByNum.end(); numIt++) masterEquities.push_back(numIt->second);
+    for (numIt = xmasterEquitiesByNum.begin(); numIt != xmasterEquitiesByNum.end(); numIt++) xmasterEquities.push_back(numIt->second);
+
+    if (!buildMasterFile(masterEquities, contents)) {
+        errorMessage = "a value in the MASTER file is out of range";
+        return false;
+    }
+    if (!transaction.writeFile("MASTER", contents, errorMessage)) return false;
+
+    if (!buildEMasterFile(masterEquities, contents)) {
+        errorMessage = "a value in the EMASTER file is out of range";
+        return false;
+    }
+    if (!transaction.writeFile("EMASTER", contents, errorMessage)) return false;
+
+    if ( (!xmasterEquities.empty()) || (m_directory.contains("XMASTER")) ) {
+        if (!buildXMasterFile(xmasterEquities, contents)) {
+            errorMessage = "a value in the XMASTER file is out of range";
+            return false;
+        }
+        if (!transaction.writeFile("XMASTER", contents, errorMessage)) return false;
+    }
+
+    // Every record is now where it was just written
+    for (unsigned long equityNum = 0; equityNum < masterEquities.size(); equityNum++) {
+        masterEquities[equityNum]->masterRecordNum(equityNum + 1);
+        masterEquities[equityNum]->EMASTERRecordNum(equityNum + 1);
+        masterEquities[equityNum]->metadataChanged(false);
+    }
+    for (unsigned long equityNum = 0; equityNum < xmasterEquities.size(); equityNum++) {
+        xmasterEquities[equityNum]->masterRecordNum(equityNum + 1);
+        xmasterEquities[equityNum]->EMASTERRecordNum(0);
+        xmasterEquities[equityNum]->metadataChanged(false);
+    }
+
+    m_MasterNumRecords = masterEquities.size();
+    m_MasterLastDataFileNumber = masterEquities.empty() ? 0 : masterEquities.back()->TDFFileNum();
+    m_XMasterNumRecords = xmasterEquities.size();
+    m_XMasterLastDataFileNumber = xmasterEquities.empty() ? 0 : xmasterEquities.back()->TDFFileNum();
+    return true;
+}
+
+
+// Write the ?MASTER records of equities over their records in the files, leaving the rest of
+// each file as it is.  Return true if success, otherwise false with the reason in errorMessage
+bool MetaStockDB::writeMasterRecords(const vector<EquityInDB*> &equities, FileTransaction &transaction, const bool inPlace, string &errorMessage)
+{
+    map<long long, string> masterRecords;   // Encoded records of each file, keyed by offset
+    map<long long, string> emasterRecords;
+    map<long long, string> xmasterRecords;
+    string record;
+
+    errorMessage = "";
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++) {
+        EquityInDB* equity = equities[equityNum];
+
+        if (equity->dataFileType() == EquityInDB::EDataFileTypeFDAT) {
+            record.assign(MASTER_RECORD_SIZE, '\0');
+            if (!encodeMasterRecord(equity, record, 0)) {
+                errorMessage = "a value in the MASTER record of " + equity->symbol() + " is out of range";
+                return false;
+            }
+            masterRecords[static_cast<long long>(equity->masterRecordNum()) * MASTER_RECORD_SIZE] = record;
+
+            record.assign(EMASTER_RECORD_SIZE, '\0');
+            if (!encodeEMasterRecord(equity, record, 0)) {
+                errorMessage = "a value in the EMASTER record of " + equity->symbol() + " is out of range";
+                return false;
+            }
+            emasterRecords[static_cast<long long>(equity->EMASTERRecordNum()) * EMASTER_RECORD_SIZE] = record;
+        } else {
+            record.assign(XMASTER_RECORD_SIZE, '\0');
+            if (!encodeXMasterRecord(equity, record, 0)) {
+                errorMessage = "a value in the XMASTER record of " + equity->symbol() + " is out of range";
+                return false;
+            }
+            xmasterRecords[static_cast<long long>(equity->masterRecordNum()) * XMASTER_RECORD_SIZE] = record;
+        }
+    }
+
+    if ( (!writeRecordsToFile("MASTER", masterRecords, transaction, inPlace, errorMessage)) ||
+         (!writeRecordsToFile("EMASTER", emasterRecords, transaction, inPlace, errorMessage)) ||
+         (!writeRecordsToFile("XMASTER", xmasterRecords, transaction, inPlace, errorMessage)) ) return false;
+
+    for (unsigned long equityNum = 0; equityNum < equities.size(); equityNum++) equities[equityNum]->metadataChanged(false);
+    return true;
+}
+
+
+// Write records (encoded, keyed by offset) over fileName, directly or as part of transaction.
+// Return true if success, otherwise false with the reason in errorMessage
+bool MetaStockDB::writeRecordsToFile(const string fileName, const map<long long, string> &records, FileTransaction &transaction,
+                                     const bool inPlace, string &errorMessage)
+{
+    map<long long, string>::const_iterator recordIt;
+
+    if (records.empty()) return true;
+
+    int fd;
+    if (inPlace) fd = m_directory.openFile(fileName, O_WRONLY, 0);
+    else fd = transaction.beginFile(fileName, true, errorMessage);
+    if (fd < 0) {
+        if (errorMessage.empty()) errorMessage = "failed to open " + fileName + ": " + strerror(errno);
+        return false;
+    }
+
+    // Records next to each other (eg: after a batch of days was added to every equity) are
+    // joined and written together
+    bool written = true;
+    recordIt = records.begin();
+    while ( (written) && (recordIt != records.end()) ) {
+        long long offset = recordIt->first;
+        string run = recordIt->second;
+        for (recordIt++; (recordIt != records.end()) && (recordIt->first == offset + static_cast<long long>(run.size())); recordIt++)
+            run += recordIt->second;
+        written = MSFileIO::writeBufferToFile(fd, offset, run);
+    }
+    if (!written) errorMessage = "failed to write " + fileName + ": " + strerror(errno);
+
+    if (inPlace) {
+        // The files were always flushed when they were replaced whole, so flush them here too
+        if ( (written) && (fsync(fd) != 0) ) {
+            written = false;
+            errorMessage = "failed to flush " + fileName + ": " + strerror(errno);
+        }
+        if ( (close(fd) != 0) && (written) ) {
+            written = false;
+            errorMessage = "failed to close " + fileName + ": " + strerror(errno);
+        }
+    } else {
+        string endMessage;
+        if ( (!transaction.endFile(fd, endMessage)) && (written) ) {
+            written = false;
+            errorMessage = endMessage;
+        }
+    }
+    return written;
+}
+
+
+// Write the trading days added since each equity was loaded or last saved to its data file.
+// Return true if every changed equity was saved
+bool MetaStockDB::save()
+{
+    TradingDataWriter writer;  // Shared by every equity, so its buffer is only allocated once
+    FileTransaction transaction(m_directory);  // Only used in ESaveModeAtomic
+    vector<TradingHistory*> savedHistories;    // Marked saved once the transaction commits
+    vector<EquityInDB*> changedEquities;
+    vector<EquityInDB*> changedRecords;        // Equities whose ?MASTER records must be written
+    set<string> modifiedInPlace;               // Existing files which will be written to directly
+    map<string, EquityInDB*>::iterator equityIterator;
+    bool atomic = (m_saveMode == ESaveModeAtomic);
+    bool metadataChanged = m_mastersChanged;
+    bool createdFiles = false;
+    bool errorOccured = false;
+    string unsavedSymbol;                      // An equity not loaded holding days not in the journal
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    if (m_commitInterrupted) {
+        m_lastError = EErrorCommitInterrupted;
+        m_lastErrorMessage = "Cannot save: reopen the database to finish the save or compact interrupted earlier";
+        return false;
+    }
+
+    // Only write equities whose file was read completely, and which have changed since (or
+    // which were added, and have no file yet)
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++) {
+        EquityInDB* equity = equityIterator->second;
+        TradingHistory* tradingHistory = equity->tradingHistory();
+
+        if (equity->metadataChanged()) metadataChanged = true;
+        if (equity->loadStatus() != EquityInDB::ELoadStatusLoaded) {
+            if ( (tradingHistory->hasUnsavedDays()) && (!m_journal.isOpen()) ) unsavedSymbol = equity->symbol();
+            continue;
+        }
+        if ( (!tradingHistory->hasUnsavedDays()) && (m_directory.contains(dataFileName(equity))) ) continue;
+
+        changedEquities.push_back(equity);
+        if ( (!atomic) && (m_directory.contains(dataFileName(equity))) ) modifiedInPlace.insert(dataFileName(equity));
+    }
+
+    // Keep the database as it was before this save changes anything in it.  In place, changed
+    // ?MASTER records are written into the files themselves, so they must be copied too.  So must
+    // the journal, which is appended to and emptied in place
+    if ( (m_numBackups > 0) && ((!changedEquities.empty()) || (metadataChanged)) ) {
+        string errorMessage;
+        if (m_journal.isOpen()) modifiedInPlace.insert(JOURNAL_FILE_NAME);
+        if (!atomic) {
+            if (m_directory.contains("MASTER")) modifiedInPlace.insert("MASTER");
+            if (m_directory.contains("EMASTER")) modifiedInPlace.insert("EMASTER");
+            if (m_directory.contains("XMASTER")) modifiedInPlace.insert("XMASTER");
+        }
+        if (!GenerationBackup::create(m_directory, m_numBackups, modifiedInPlace, errorMessage)) {
+            m_lastError = EErrorBackupFailed;
+            m_lastErrorMessage = "Error creating backup: " + errorMessage;
+            return false;
+        }
+    }
+
+    for (unsigned long equityNum = 0; equityNum < changedEquities.size(); equityNum++) {
+        EquityInDB* equity = changedEquities[equityNum];
+        TradingHistory* tradingHistory = equity->tradingHistory();
+        shared_ptr<const vector<TradingDay> > tradingDays = tradingHistory->sharedTradingDays();
+        vector<pair<unsigned long, unsigned long> > modifiedRanges;
+        string fileName = dataFileName(equity);
+        string errorMessage;
+
+        // An equity with no days in the file has nothing to keep, so is written whole (keeping
+        // the file's header record).  Otherwise the changed and new records are written to the
+        // file itself, or to a copy of it
+        unsigned long firstDay = m_directory.contains(fileName) ? tradingHistory->firstUnsavedDay() : 0;
+        if (firstDay > 0) tradingHistory->modifiedRanges(modifiedRanges);
+        int fd;
+        if (atomic) fd = transaction.beginFile(fileName, m_directory.contains(fileName), errorMessage);
+        else fd = m_directory.openFile(fileName, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            m_lastError = EErrorTradingDataFileWriteFailed;
+            m_lastErrorMessage = "Error: file " + fileName + " did not open for writing" + (errorMessage.empty() ? "" : ": " + errorMessage);
+            errorOccured = true;
+            if (atomic) break;
+            continue;
+        }
+        if (!m_directory.contains(fileName)) createdFiles = true;
+
+        // Days changed in place are written over their own records, and the header is only
+        // updated if days were added
+        bool written = true;
+        for (unsigned long rangeNum = 0; (written) && (rangeNum < modifiedRanges.size()); rangeNum++)
+            written = writer.rewrite(fd, equity->activeFields(), *tradingDays, modifiedRanges[rangeNum].first,
+                                     modifiedRanges[rangeNum].second - modifiedRanges[rangeNum].first, errorMessage);
+        bool daysAdded = ( (firstDay == 0) || (firstDay < tradingDays->size()) );
+        if ( (written) && (daysAdded) ) written = writer.write(fd, equity->activeFields(), *tradingDays, firstDay, errorMessage);
+        if (atomic) {
+            string endMessage;
+            if ( (!transaction.endFile(fd, endMessage)) && (written) ) {
+                written = false;
+                errorMessage = endMessage;
+            }
+        } else {
+            // The journal is emptied after the save, so the data must be on disk by then
+            if ( (written) && (m_journal.isOpen()) && (fsync(fd) != 0) ) {
+                written = false;
+                errorMessage = strerror(errno);
+            }
+            if (close(fd) != 0) written = false;
+        }
+
+        if (!written) {
+            m_lastError = EErrorTradingDataFileWriteFailed;
+            m_lastErrorMessage = "Error writing file " + fileName + ": " + errorMessage;
+            errorOccured = true;
+            if (atomic) break;
+            continue;
+        }
+        savedHistories.push_back(tradingHistory);
+
+        // Added days may change the first and last dates held in the equity's ?MASTER record
+        if (daysAdded) equity->metadataChanged(true);
+    }
+
+    // Only the ?MASTER records which no longer match their equity are written, over the records
+    // already in the files (in ESaveModeAtomic, in copies replaced along with the data files).
+    // When the files no longer list the equities they are instead replaced whole
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++) {
+        EquityInDB* equity = equityIterator->second;
+        if (!equity->metadataChanged()) continue;
+
+        changedRecords.push_back(equity);
+        if ( (equity->masterRecordNum() == 0) ||
+             ((equity->dataFileType() == EquityInDB::EDataFileTypeFDAT) && (equity->EMASTERRecordNum() == 0)) ) m_mastersChanged = true;
+    }
+    bool writeMasters = ( (!errorOccured) && ((m_mastersChanged) || (!changedRecords.empty())) );
+    if (writeMasters) {
+        FileTransaction masterTransaction(m_directory);
+        string errorMessage;
+        bool written;
+
+        if (m_mastersChanged) {
+            written = ( (writeMasterFiles(atomic ? transaction : masterTransaction, errorMessage)) &&
+                        ((atomic) || (masterTransaction.commit(errorMessage))) );
+            createdFiles = true;
+        } else {
+            written = writeMasterRecords(changedRecords, transaction, !atomic, errorMessage);
+        }
+        if ( (!written) && (masterTransaction.committed()) ) {
+            m_commitInterrupted = true;
+            m_lastError = EErrorCommitInterrupted;
+            m_lastErrorMessage = "Error writing master files: " + errorMessage;
+            errorOccured = true;
+        } else if (!written) {
+            m_lastError = EErrorMasterFileWriteFailed;
+            m_lastErrorMessage = "Error writing master files: " + errorMessage;
+            errorOccured = true;
+        }
+    }
+
+    // All or nothing: replace every file written, or leave them all as they were
+    if (atomic) {
+        string errorMessage;
+        if (errorOccured) {
+            transaction.abort();
+            savedHistories.clear();
+        } else if (!transaction.commit(errorMessage)) {
+            // Past the commit record the files are replaced by the next open, not put back
+            if (transaction.committed()) m_commitInterrupted = true;
+            m_lastError = (transaction.committed()) ? EErrorCommitInterrupted : EErrorTradingDataFileWriteFailed;
+            m_lastErrorMessage = "Error saving database: " + errorMessage;
+            errorOccured = true;
+            savedHistories.clear();
+        }
+    }
+    // Records already marked as written may not have reached the files, so if anything failed
+    // the files are replaced whole by the next save
+    if (writeMasters) m_mastersChanged = errorOccured;
+
+    for (unsigned long historyNum = 0; historyNum < savedHistories.size(); historyNum++)
+        savedHistories[historyNum]->markSaved();
+
+    // Checkpoint: every day in the journal, other than those pinned, is now in the data files
+    if ( (!errorOccured) && (!checkpointJournalWhileLocked()) ) errorOccured = true;
+
+    // Days of an equity which did not load are only kept by the journal, so without it they are lost
+    if ( (!errorOccured) && (!unsavedSymbol.empty()) ) {
+        m_lastError = EErrorTradingDataFileWriteFailed;
+        m_lastErrorMessage = "Trading days added to '" + unsavedSymbol + "' are not saved, as its data file did not load";
+        errorOccured = true;
+    }
+
+    // Keep the listing in step with any data files just created
+    if (createdFiles) m_directory.refresh();
+
+    return !errorOccured;
+}
+
+
+// Rewrite the whole database with dense data file numbers, and the data files written in
+// file number order.  Return true if success
+bool MetaStockDB::compact()
+{
+    map<pair<int, unsigned long>, EquityInDB*> equitiesByFile;   // (0 = MASTER / 1 = XMASTER, file number)
+    map<pair<int, unsigned long>, EquityInDB*>::iterator fileIt;
+    map<string, EquityInDB*>::iterator equityIterator;
+    vector<EquityInDB*> ordered;
+    vector<EquityInDB*> xmasterOnly;                 // Equities which cannot be listed in MASTER
+    vector< pair<unsigned long, EquityInDB::EDataFileTypes> > oldDataFiles;
+    vector<unsigned long> oldFileTypes;
+    set<string> oldFileNames;
+    set<string> newFileNames;
+    TradingDataWriter writer;
+    FileTransaction transaction(m_directory);
+    string errorMessage;
+    bool errorOccured = false;
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    if (m_commitInterrupted) {
+        m_lastError = EErrorCommitInterrupted;
+        m_lastErrorMessage = "Cannot compact: reopen the database to finish the save or compact interrupted earlier";
+        return false;
+    }
+
+    // Every equity is rewritten, so all must be loaded
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++) {
+        EquityInDB* equity = equityIterator->second;
+        if (equity->loadStatus() == EquityInDB::ELoadStatusNotLoaded) loadTradingDataOrRecordFailure(equity);
+        if (equity->loadStatus() != EquityInDB::ELoadStatusLoaded) {
+            m_lastError = EErrorCompactFailed;
+            m_lastErrorMessage = "Cannot compact: trading data of '" + equity->symbol() + "' did not load";
+            return false;
+        }
+        int master = (equity->dataFileType() == EquityInDB::EDataFileTypeFDAT) ? 0 : 1;
+        equitiesByFile[make_pair(master, equity->TDFFileNum())] = equity;
+    }
+
+    // Keep the current order, MASTER first.  Equities too big for MASTER go after the rest
+    for (fileIt = equitiesByFile.begin(); fileIt != equitiesByFile.end(); fileIt++) {
+        EquityInDB* equity = fileIt->second;
+        oldFileNames.insert(dataFileName(equity));
+        if ( (equity->symbol().size() > MASTER_SYMBOL_LENGTH) || (equity->description().size() > MASTER_DESCRIPTION_LENGTH) )
+            xmasterOnly.push_back(equity);
+        else ordered.push_back(equity);
+    }
+    unsigned long numInMaster = ordered.size();
+    ordered.insert(ordered.end(), xmasterOnly.begin(), xmasterOnly.end());
+    if (numInMaster > MASTER_LARGEST_FDATNUM) numInMaster = MASTER_LARGEST_FDATNUM;
+    if (ordered.size() - numInMaster > XMASTER_LARGEST_FDATNUM - MASTER_LARGEST_FDATNUM) {
+        m_lastError = EErrorCompactFailed;
+        m_lastErrorMessage = "Cannot compact: too many equities";
+        return false;
+    }
+
+    // Keep the database as it was, before anything in it changes.  Every file but the journal
+    // (appended to and emptied in place) is replaced by rename, so the backup can share them
+    set<string> journalFile;
+    if (m_journal.isOpen()) journalFile.insert(JOURNAL_FILE_NAME);
+    if ( (m_numBackups > 0) && (!GenerationBackup::create(m_directory, m_numBackups, journalFile, errorMessage)) ) {
+        m_lastError = EErrorBackupFailed;
+        m_lastErrorMessage = "Error creating backup: " + errorMessage;
+        return false;
+    }
+
+    // Number the equities densely, and write their data files one after another in that order.
+    // Each file is given its full size before it is written, so the file system can place it
+    // in one piece after the file before
+    for (unsigned long equityNum = 0; equityNum < ordered.size(); equityNum++) {
+        EquityInDB* equity = ordered[equityNum];
+        string oldFileName = dataFileName(equity);
+        oldDataFiles.push_back(make_pair(equity->TDFFileNum(), equity->dataFileType()));
+        oldFileTypes.push_back(equity->fileType());
+
+        // An equity moving from XMASTER has no MASTER file type, so is given that of a new equity
+        if (equityNum < numInMaster) {
+            unsigned long fileType = (equity->dataFileType() == EquityInDB::EDataFileTypeFDAT) ? equity->fileType() : MASTER_NEW_EQUITY_FILETYPE;
+            equity->dataFile(equityNum + 1, EquityInDB::EDataFileTypeFDAT, fileType);
+        } else {
+            equity->dataFile(MASTER_LARGEST_FDATNUM + 1 + (equityNum - numInMaster), EquityInDB::EDataFileTypeMWD, equity->fileType());
+        }
+
+        string fileName = dataFileName(equity);
+        shared_ptr<const vector<TradingDay> > tradingDays = equity->tradingHistory()->sharedTradingDays();
+        newFileNames.insert(fileName);
+
+        int fd = transaction.beginFile(fileName, false, errorMessage);
+        if (fd < 0) {
+            errorOccured = true;
+            break;
+        }
+
+        // Running out of space is found here, before anything is replaced.  A file system which
+        // cannot reserve space is simply written without
+        int reserveResult = posix_fallocate(fd, 0, static_cast<off_t>(tradingDays->size() + 1) * equity->activeFields().recordSize());
+        if ( (reserveResult != 0) && (reserveResult != EINVAL) && (reserveResult != EOPNOTSUPP) ) {
+            errorMessage = "failed to reserve space for " + fileName + ": " + strerror(reserveResult);
+            close(fd);
+            errorOccured = true;
+            break;
+        }
+
+        // The new file keeps the header record of the old one
+        bool written = true;
+        int oldFd = m_directory.openFile(oldFileName, O_RDONLY, 0);
+        if (oldFd >= 0) {
+            written = TradingDataWriter::copyHeader(oldFd, fd, equity->activeFields(), errorMessage);
+            close(oldFd);
+        }
+        if (written) written = writer.write(fd, equity->activeFields(), *tradingDays, 0, errorMessage);
+        string endMessage;
+        if ( (!transaction.endFile(fd, endMessage)) && (written) ) {
+            written = false;
+            errorMessage = endMessage;
+        }
+        if (!written) {
+            errorMessage = "failed to write " + fileName + ": " + errorMessage;
+            errorOccured = true;
+            break;
+        }
+    }
+
+    // Replace the ?MASTER files and every data file together
+    if ( (errorOccured) || (!writeMasterFiles(transaction, errorMessage)) || (!transaction.commit(errorMessage)) ) {
+
+        // Past the commit record the new files are certain to replace the old, so the equities
+        // keep their new numbers.  Nothing more is written until the next open finishes the renames
+        if (transaction.committed()) {
+            m_commitInterrupted = true;
+            m_lastError = EErrorCommitInterrupted;
+            m_lastErrorMessage = "Error compacting database: " + errorMessage;
+            m_directory.refresh();
+            return false;
+        }
+
+        transaction.abort();
+        for (unsigned long equityNum = 0; equityNum < oldDataFiles.size(); equityNum++)
+            ordered[equityNum]->dataFile(oldDataFiles[equityNum].first, oldDataFiles[equityNum].second, oldFileTypes[equityNum]);
+        m_lastError = EErrorCompactFailed;
+        m_lastErrorMessage = "Error compacting database: " + errorMessage;
+        m_mastersChanged = true;  // The records may no longer be where the equities think they are
+        m_directory.refresh();
+        return false;
+    }
+
+    // Remove the data files no longer used
+    set<string>::iterator nameIt;
+    for (nameIt = oldFileNames.begin(); nameIt != oldFileNames.end(); nameIt++)
+        if (newFileNames.find(*nameIt) == newFileNames.end()) unlinkat(m_directory.fd(), nameIt->c_str(), 0);
+    fsync(m_directory.fd());
+
+    for (unsigned long equityNum = 0; equityNum < ordered.size(); equityNum++) ordered[equityNum]->tradingHistory()->markSaved();
+    m_mastersChanged = false;
+    m_directory.refresh();
+
+    // Every day in the journal, other than those pinned, is now in the data files
+    return checkpointJournalWhileLocked();
+}
+
+
+// Set how save() writes files
+void MetaStockDB::saveMode(const ESaveModes mode)
+{
+    m_saveMode = mode;
+}
+
+
+// Get how save() writes files
+MetaStockDB::ESaveModes MetaStockDB::saveMode() const
+{
+    return m_saveMode;
+}
+
+
 // Reset at start of list, and copy first item in the list
 // into the parameter.  Return true if success, false otherwise
 bool MetaStockDB::getFirstEquity(Equity** equityPtr)
@@ -1402,6 +2298,517 @@ Equity * MetaStockDB::find(std::string equityName) const
 
 
 
+//============================================================================
+// Snapshots
+
+// Return the most recently published snapshot of all equities.  May be called from any thread
+shared_ptr<const DBSnapshot> MetaStockDB::snapshot() const
+{
+    return atomic_load(&m_snapshot);
+}
+
+
+// Publish a new snapshot holding the current state of all equities
+void MetaStockDB::publishSnapshot()
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+    publishSnapshotWhileLocked();
+}
+
+
+// Build and publish a new snapshot.  m_writerMutex must be held by the caller.
+// The trading days are not copied: each equity's list is shared with the snapshot, and
+// the equity copies it the next time it is changed
+void MetaStockDB::publishSnapshotWhileLocked()
+{
+    shared_ptr<const DBSnapshot> previousSnapshot = atomic_load(&m_snapshot);
+    map<string, EquityInDB*>::iterator equityIterator;
+    vector<DBSnapshot::EquitySnapshot> equities(m_equityMap.size());
+    unsigned long equityNum = 0;
+
+    // The map is ordered by symbol, so the snapshot is built already sorted
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++, equityNum++) {
+        EquityInDB* equity = equityIterator->second;
+        equities[equityNum].symbol = equity->symbol();
+        equities[equityNum].description = equity->description();
+        equities[equityNum].activeFields = equity->activeFields();
+        equities[equityNum].firstDate = equity->tradingHistory()->firstDate();
+        equities[equityNum].lastDate = equity->tradingHistory()->lastDate();
+        equities[equityNum].tradingDays = equity->tradingHistory()->sharedTradingDays();
+        equities[equityNum].zoneMap = equity->tradingHistory()->sharedZoneMap();
+        equities[equityNum].lastDivPaid = equity->lastDivPaid();
+        equities[equityNum].lastDivAdjRate = equity->lastDivAdjRate();
+    }
+
+    // Swap the new version in.  The previous version is freed once no reader holds it
+    shared_ptr<const DBSnapshot> newSnapshot(new DBSnapshot(previousSnapshot ? previousSnapshot->version() + 1 : 1, equities));
+    atomic_store(&m_snapshot, newSnapshot);
+}
+
+
+// Adds the passed trading day data to the equity with the symbol specified.
+// Returns true if succesfully added new day data
+bool MetaStockDB::addTradingDayData(const string symbol, const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest)
+{
+    unsigned long long journalSequence = 0;
+    string errorMessage;
+
+    // Leave the day to the flusher thread, once the equity is known to take it.  The queue is
+    // not added to under the lock, as a full queue waits for the flusher, which takes it too
+    if (m_writeBehind.isRunning()) {
+        {
+            lock_guard<mutex> writerLock(m_writerMutex);
+            map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+            if ( (targetIt == m_equityMap.end()) || (!loadForChangeWhileLocked(targetIt->second)) ||
+                 (targetIt->second->tradingHistory()->containsDate(date)) ) return false;
+        }
+        if (m_writeBehind.enqueue(symbol, TradingDay(date, time, open, close, high, low, volume, openInterest))) return true;
+    }
+
+    {
+        lock_guard<mutex> writerLock(m_writerMutex);
+
+        map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+        if ( (targetIt == m_equityMap.end()) || (!loadForChangeWhileLocked(targetIt->second)) ) return false;
+
+        if (!targetIt->second->tradingHistory()->addTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest)))
+            return false;
+
+        // Journal the day in the same order as it was added
+        if (!m_journal.isOpen()) return true;
+        journalSequence = m_journal.append(symbol, TradingDay(date, time, open, close, high, low, volume, openInterest));
+        if (targetIt->second->loadStatus() != EquityInDB::ELoadStatusLoaded)
+            m_pinnedDays[symbol].push_back(TradingDay(date, time, open, close, high, low, volume, openInterest));
+    }
+
+    // Wait for the journal without holding the lock, so days added meanwhile share the same flush
+    if (!m_journal.waitDurable(journalSequence, errorMessage)) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        m_lastError = EErrorJournalFailed;
+        m_lastErrorMessage = "Error writing journal: " + errorMessage;
+        return false;
+    }
+    return true;
+}
+
+
+// Compare two trading days by date, to put them in date order
+static bool tradingDayDateLess(const TradingDay &left, const TradingDay &right)
+{
+    return (left.date().asYYYYMMDD() < right.date().asYYYYMMDD());
+}
+
+
+// Adds many trading days, in any order, to the equity with the symbol specified.
+// Returns false if the equity does not exist, or the journal failed
+bool MetaStockDB::addTradingDays(const string symbol, const vector<TradingDay> &days, unsigned long &numAdded)
+{
+    unsigned long long journalSequence = 0;
+    unsigned long numDuplicates;
+    string errorMessage;
+
+    numAdded = 0;
+
+    // Leave the days to the flusher thread.  Only those the equity would take are queued (the
+    // first of any date given twice), so numAdded is as it would be without write-behind
+    if (m_writeBehind.isRunning()) {
+        vector<TradingDay> newDays;
+        {
+            lock_guard<mutex> writerLock(m_writerMutex);
+            map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+            if ( (targetIt == m_equityMap.end()) || (!loadForChangeWhileLocked(targetIt->second)) ) return false;
+
+            set<unsigned long> newDates;
+            for (unsigned long dayNum = 0; dayNum < days.size(); dayNum++) {
+                if (targetIt->second->tradingHistory()->containsDate(days[dayNum].date())) continue;
+                if (newDates.insert(days[dayNum].date().asYYYYMMDD()).second) newDays.push_back(days[dayNum]);
+            }
+        }
+
+        unsigned long numQueued = 0;
+        while ( (numQueued < newDays.size()) && (m_writeBehind.enqueue(symbol, newDays[numQueued])) ) numQueued++;
+        if (numQueued == newDays.size()) {
+            numAdded = numQueued;
+            return true;
+        }
+
+        // Write-behind mode ended part way through, so add the rest now
+        bool added = addTradingDays(symbol, vector<TradingDay>(newDays.begin() + numQueued, newDays.end()), numAdded);
+        numAdded += numQueued;
+        return added;
+    }
+
+    {
+        lock_guard<mutex> writerLock(m_writerMutex);
+
+        map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+        if ( (targetIt == m_equityMap.end()) || (!loadForChangeWhileLocked(targetIt->second)) ) return false;
+
+        // The history merges days in date order; keep the first of any given twice
+        vector<TradingDay> sortedDays(days);
+        stable_sort(sortedDays.begin(), sortedDays.end(), tradingDayDateLess);
+        numAdded = targetIt->second->tradingHistory()->addTradingDays(sortedDays, numDuplicates);
+
+        // Journal the days (any already held are skipped when the journal is read back)
+        if ( (!m_journal.isOpen()) || (numAdded == 0) ) return true;
+        for (unsigned long dayNum = 0; dayNum < sortedDays.size(); dayNum++)
+            journalSequence = m_journal.append(symbol, sortedDays[dayNum]);
+        if (targetIt->second->loadStatus() != EquityInDB::ELoadStatusLoaded) {
+            vector<TradingDay> &pinnedDays = m_pinnedDays[symbol];
+            pinnedDays.insert(pinnedDays.end(), sortedDays.begin(), sortedDays.end());
+        }
+    }
+
+    // Wait for the journal without holding the lock, so days added meanwhile share the same flush
+    if (!m_journal.waitDurable(journalSequence, errorMessage)) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        m_lastError = EErrorJournalFailed;
+        m_lastErrorMessage = "Error writing journal: " + errorMessage;
+        return false;
+    }
+    return true;
+}
+
+
+// Adds trading days, given as (symbol, trading day) pairs in any order, to many equities at once.
+// results is set to the outcome for each pair.  Returns false if the journal failed
+bool MetaStockDB::addTradingDaysBatch(const vector<pair<string, TradingDay> > &days, vector<EBatchResults> &results)
+{
+    unsigned long long journalSequence = 0;
+    vector<unsigned long> order(days.size());   // Positions in days, in symbol then date order
+    vector<TradingDay> equityDays;
+    string errorMessage;
+
+    results.assign(days.size(), EBatchResultUnknownSymbol);
+    for (unsigned long dayNum = 0; dayNum < days.size(); dayNum++) order[dayNum] = dayNum;
+
+    // Days given twice for one date keep their order, so the first is the one added
+    stable_sort(order.begin(), order.end(), [&days](const unsigned long left, const unsigned long right) {
+        int compare = days[left].first.compare(days[right].first);
+        if (compare != 0) return (compare < 0);
+        return (days[left].second.date().asYYYYMMDD() < days[right].second.date().asYYYYMMDD());
+    });
+
+    {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        map<string, EquityInDB*>::iterator equityIt = m_equityMap.begin();
+        unsigned long orderNum = 0;
+
+        while (orderNum < order.size()) {
+            const string &symbol = days[order[orderNum]].first;
+            unsigned long groupEnd = orderNum;
+            while ( (groupEnd < order.size()) && (days[order[groupEnd]].first == symbol) ) groupEnd++;
+
+            // The equities are held in symbol order too, so carry on from the last one found
+            while ( (equityIt != m_equityMap.end()) && (equityIt->first < symbol) ) equityIt++;
+            if ( (equityIt == m_equityMap.end()) || (equityIt->first != symbol) ) {
+                orderNum = groupEnd;
+                continue;
+            }
+            if (!loadForChangeWhileLocked(equityIt->second)) {
+                for (; orderNum < groupEnd; orderNum++) results[order[orderNum]] = EBatchResultNotLoaded;
+                continue;
+            }
+
+            // Sort out the days already held, so each pair gets its own result
+            TradingHistory* tradingHistory = equityIt->second->tradingHistory();
+            equityDays.clear();
+            for (unsigned long groupNum = orderNum; groupNum < groupEnd; groupNum++) {
+                const TradingDay &tradingDay = days[order[groupNum]].second;
+                bool repeated = ( (groupNum > orderNum) &&
+                                  (days[order[groupNum - 1]].second.date().asYYYYMMDD() == tradingDay.date().asYYYYMMDD()) );
+                if ( (repeated) || (tradingHistory->containsDate(tradingDay.date())) ) {
+                    results[order[groupNum]] = EBatchResultDuplicate;
+                } else {
+                    results[order[groupNum]] = EBatchResultAdded;
+                    equityDays.push_back(tradingDay);
+                }
+            }
+            orderNum = groupEnd;
+            if (equityDays.empty()) continue;
+
+            unsigned long numDuplicates;
+            tradingHistory->addTradingDays(equityDays, numDuplicates);
+
+            // Journal the days, to be written together once every equity is done
+            if (!m_journal.isOpen()) continue;
+            for (unsigned long dayNum = 0; dayNum < equityDays.size(); dayNum++)
+                journalSequence = m_journal.append(symbol, equityDays[dayNum]);
+            if (equityIt->second->loadStatus() != EquityInDB::ELoadStatusLoaded) {
+                vector<TradingDay> &pinnedDays = m_pinnedDays[symbol];
+                pinnedDays.insert(pinnedDays.end(), equityDays.begin(), equityDays.end());
+            }
+        }
+    }
+
+    // Wait for the journal without holding the lock, so days added meanwhile share the same flush
+    if (journalSequence == 0) return true;
+    if (!m_journal.waitDurable(journalSequence, errorMessage)) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        m_lastError = EErrorJournalFailed;
+        m_lastErrorMessage = "Error writing journal: " + errorMessage;
+        return false;
+    }
+    return true;
+}
+
+
+// Replaces the trading day the equity with the symbol specified already has for the date given.
+// Returns true if the day was replaced
+bool MetaStockDB::updateTradingDayData(const string symbol, const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest)
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+    if ( (targetIt == m_equityMap.end()) || (!loadForChangeWhileLocked(targetIt->second)) ) return false;
+
+    return targetIt->second->tradingHistory()->updateTradingDayData(TradingDay(date, time, open, close, high, low, volume, openInterest));
+}
+
+
+// Changes the description of the equity with the symbol specified.
+// Returns true if the equity exists
+bool MetaStockDB::updateDescription(const string symbol, const string description)
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+    if (targetIt == m_equityMap.end()) return false;
+
+    targetIt->second->descriptionWhileLocked(description);
+    return true;
+}
+
+
+// Attaches an indicator to the equity with the symbol specified, which keeps it up to date.
+// Returns false if the equity does not exist
+bool MetaStockDB::attachIndicator(const string symbol, const shared_ptr<IndicatorState> &indicator)
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+    if (targetIt == m_equityMap.end()) return false;
+
+    targetIt->second->attachIndicator(indicator);
+    return true;
+}
+
+
+// Stops keeping the indicator given up to date.  Returns false if it was not attached
+bool MetaStockDB::detachIndicator(const string symbol, const shared_ptr<IndicatorState> &indicator)
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(symbol);
+    if (targetIt == m_equityMap.end()) return false;
+
+    return targetIt->second->detachIndicator(indicator);
+}
+
+
+// Adds a new equity with no trading days, using the lowest free data file number.
+// Returns false if the symbol is already in use, too long, or no file number is free
+bool MetaStockDB::addEquity(const string symbol, const string description)
+{
+    set<unsigned long> usedFileNums;
+    map<string, EquityInDB*>::iterator equityIterator;
+    unsigned long fileNum;
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    if ( (symbol.empty()) || (m_equityMap.find(symbol) != m_equityMap.end()) ) {
+        m_lastError = EErrorEquityAddFailed;
+        m_lastErrorMessage = "Symbol '" + symbol + "' is empty or already in use";
+        return false;
+    }
+
+    // Find the lowest file number not used by an equity, nor by a file left in the directory
+    for (equityIterator = m_equityMap.begin(); equityIterator != m_equityMap.end(); equityIterator++)
+        usedFileNums.insert(equityIterator->second->TDFFileNum());
+    for (fileNum = 1; fileNum <= XMASTER_LARGEST_FDATNUM; fileNum++) {
+        if (usedFileNums.find(fileNum) != usedFileNums.end()) continue;
+        if (m_directory.contains("F" + to_string(fileNum) + ".DAT")) continue;
+        if (m_directory.contains("C" + to_string(fileNum) + ".MWD")) continue;
+        break;
+    }
+
+    bool inMaster = (fileNum <= MASTER_LARGEST_FDATNUM);
+    if ( (fileNum > XMASTER_LARGEST_FDATNUM) ||
+         (symbol.size() > (inMaster ? MASTER_SYMBOL_LENGTH : XMASTER_SYMBOL_LENGTH)) ) {
+        m_lastError = EErrorEquityAddFailed;
+        m_lastErrorMessage = "Symbol '" + symbol + "' is too long, or no data file number is free";
+        return false;
+    }
+
+    // Created as if read from MASTER or XMASTER, with every filler field empty
+    EquityInDB* equity;
+    ActiveFields activeFields(static_cast<unsigned int>(NEW_EQUITY_NUM_FIELDS));
+    if (inMaster) {
+        equity = new EquityInDB(fileNum, MASTER_NEW_EQUITY_FILETYPE, activeFields.recordSize(), NEW_EQUITY_NUM_FIELDS,
+                                ByteArray(MASTER_FILLER2_LENGTH), description.substr(0, MASTER_DESCRIPTION_LENGTH),
+                                ByteArray(MASTER_FILLER3_LENGTH), 0, Date(), Date(),
+                                EquityInDB::EInterdayPeriodicityDaily, EquityInDB::EIntradayPeriodicityNone, symbol,
+                                ByteArray(MASTER_FILLER4_LENGTH), 0, ByteArray(MASTER_FILLER5_LENGTH));
+    } else {
+        equity = new EquityInDB(ByteArray(XMASTER_FILLER5_LENGTH), symbol, description.substr(0, XMASTER_DESCRIPTION_LENGTH),
+                                ByteArray(XMASTER_FILLER6_LENGTH), ByteArray(XMASTER_FILLER7_LENGTH), ByteArray(XMASTER_FILLER8_LENGTH),
+                                EquityInDB::EInterdayPeriodicityDaily, ByteArray(XMASTER_FILLER9_LENGTH), fileNum,
+                                ByteArray(XMASTER_FILLER10_LENGTH), activeFields.bitMask(), ByteArray(XMASTER_FILLER11_LENGTH),
+                                Date(), ByteArray(XMASTER_FILLER12_LENGTH), Date(), ByteArray(XMASTER_FILLER13_LENGTH),
+                                ByteArray(XMASTER_FILLER14_LENGTH));
+    }
+
+    // There is no file to load, so the (empty) trading data is complete already
+    equity->loadStatus(EquityInDB::ELoadStatusLoaded);
+    equity->tradingHistory()->loaded(true);
+    equity->writerMutex(&m_writerMutex);
+    m_equityMap.insert(std::pair<string, EquityInDB*>(symbol, equity));
+    m_mastersChanged = true;
+    return true;
+}
+
+
+// Start recording every trading day added in a journal in the database directory.
+// Return true if success
+bool MetaStockDB::enableJournal()
+{
+    lock_guard<mutex> writerLock(m_writerMutex);
+
+    if (m_journal.isOpen()) return true;
+    return openJournalWhileLocked();
+}
+
+
+// Open the journal and add the trading days in it, which were added but not saved when the
+// database was last used.  Days already in the data files (the journal is only emptied after
+// a save) are skipped as duplicates.  m_writerMutex must be held by the caller
+bool MetaStockDB::openJournalWhileLocked()
+{
+    vector<Journal::Entry> entries;
+    string errorMessage;
+
+    if (!m_journal.open(m_directory, JOURNAL_FILE_NAME, entries, errorMessage)) {
+        m_lastError = EErrorJournalFailed;
+        m_lastErrorMessage = "Error opening journal: " + errorMessage;
+        return false;
+    }
+    m_directory.refresh();
+
+    for (unsigned long entryNum = 0; entryNum < entries.size(); entryNum++) {
+        map<string, EquityInDB*>::iterator targetIt = m_equityMap.find(entries[entryNum].symbol);
+
+        // Days which cannot be saved yet must stay in the journal
+        if ( (targetIt == m_equityMap.end()) || (targetIt->second->loadStatus() != EquityInDB::ELoadStatusLoaded) ) {
+            m_pinnedDays[entries[entryNum].symbol].push_back(entries[entryNum].tradingDay);
+            continue;
+        }
+        targetIt->second->tradingHistory()->addTradingDayData(entries[entryNum].tradingDay);
+    }
+
+    publishSnapshotWhileLocked();
+    return true;
+}
+
+
+// Empty the journal after a save, apart from the days in m_pinnedDays, which are written to a
+// compacted journal.  m_writerMutex must be held by the caller.  Return true if success
+bool MetaStockDB::checkpointJournalWhileLocked()
+{
+    map<string, vector<TradingDay> >::iterator pinnedIt;
+    vector<Journal::Entry> entries;
+    string errorMessage;
+
+    if (!m_journal.isOpen()) return true;
+
+    for (pinnedIt = m_pinnedDays.begin(); pinnedIt != m_pinnedDays.end(); pinnedIt++) {
+        Journal::Entry entry;
+        entry.symbol = pinnedIt->first;
+        for (unsigned long dayNum = 0; dayNum < pinnedIt->second.size(); dayNum++) {
+            entry.tradingDay = pinnedIt->second[dayNum];
+            entries.push_back(entry);
+        }
+    }
+
+    bool emptied = entries.empty() ? m_journal.clear(errorMessage) : m_journal.compact(entries, errorMessage);
+    if (!emptied) {
+        m_lastError = EErrorJournalFailed;
+        m_lastErrorMessage = "Error emptying journal: " + errorMessage;
+    }
+    return emptied;
+}
+
+
+// Start write-behind mode: days added are queued, and added and saved by a background thread.
+// Return true if success
+bool MetaStockDB::enableWriteBehind(const unsigned long maxQueuedDays, const unsigned long flushDays, const unsigned int flushIntervalMs)
+{
+    if (m_writeBehind.isRunning()) return true;
+
+    m_writeBehind.start([this](const WriteBehind::Batch &days, string &errorMessage) { return flushQueuedDays(days, errorMessage); },
+                        maxQueuedDays, flushDays, flushIntervalMs);
+    return true;
+}
+
+
+// Wait until every trading day queued before this call has been added and saved.
+// Return true if success
+bool MetaStockDB::flush()
+{
+    string errorMessage;
+
+    if (!m_writeBehind.flush(errorMessage)) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        m_lastError = EErrorWriteBehindFailed;
+        m_lastErrorMessage = "Error saving queued trading days: " + errorMessage;
+        return false;
+    }
+    return true;
+}
+
+
+// Flush the trading days queued, and leave write-behind mode.  Return true if success
+bool MetaStockDB::disableWriteBehind()
+{
+    string errorMessage;
+
+    if (!m_writeBehind.stop(errorMessage)) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        m_lastError = EErrorWriteBehindFailed;
+        m_lastErrorMessage = "Error saving queued trading days: " + errorMessage;
+        return false;
+    }
+    return true;
+}
+
+
+// Add the trading days queued in write-behind mode and save them, on the flusher thread.
+// Return true if every day was added and saved, otherwise false with the reason in errorMessage
+bool MetaStockDB::flushQueuedDays(const WriteBehind::Batch &days, string &errorMessage)
+{
+    vector<EBatchResults> results;
+    unsigned long numNotAdded = 0;
+
+    errorMessage = "";
+    bool added = addTradingDaysBatch(days, results);
+    publishSnapshot();
+    for (unsigned long dayNum = 0; dayNum < results.size(); dayNum++)
+        if (results[dayNum] != EBatchResultAdded) numNotAdded++;
+
+    // Save even if the journal failed, as the days are in the equities either way
+    if ( (!save()) || (!added) ) {
+        lock_guard<mutex> writerLock(m_writerMutex);
+        errorMessage = m_lastErrorMessage;
+        return false;
+    }
+
+    // Each day was checked when queued, but the same date may have been queued twice since
+    if (numNotAdded > 0) {
+        errorMessage = to_string(numNotAdded) + " queued trading days were not added (date already held, or unknown symbol)";
+        return false;
+    }
+    return true;
+}
+
+
 // Print the entire metastock database
 void MetaStockDB::print()
 {
@@ -10,9 +10,19 @@
 #define METASTOCKDB_H
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <stdlib.h>
+#include "dbsnapshot.h"
+#include "directorysnapshot.h"
+#include "filetransaction.h"
+#include "indicatorstate.h"
+#include "journal.h"
+#include "memorystream.h"
 #include "msfileio.h"
+#include "writebehind.h"
 #include "tradinghistory.h"
 #include "equityindb.h"
 #include "equity.h"
@@ -52,7 +62,30 @@ public:
         EErrorTradingDataFileOpenFailed,      // Failed to open trading day file
         EErrorTradingDataFileDoesntExist,     // Trading day history file does not exist
         EErrorTradingDataFileFieldRead,       // Failed to read from the trading data history file
-        EErrorTradingDataFileDuplicateDate    // Attempt to add a duplicate date to trading data history in memory list
+        EErrorTradingDataFileDuplicateDate,   // Attempt to add a duplicate date to trading data history in memory list
+        EErrorTradingDataFileWriteFailed,     // Failed to write to the trading data history file
+        EErrorBackupFailed,                   // Failed to create a backup generation before saving
+        EErrorJournalFailed,                  // Failed to open, read, or write the journal
+        EErrorMasterFileWriteFailed,          // Failed to write the MASTER, EMASTER, or XMASTER file
+        EErrorEquityAddFailed,                // Equity could not be added (eg: symbol already in use)
+        EErrorCompactFailed,                  // Failed to compact the database
+        EErrorWriteBehindFailed,              // Trading days queued in write-behind mode could not be saved
+        EErrorTransactionRecoveryFailed,      // An atomic save cut short by a crash could not be finished
+        EErrorCommitInterrupted               // A save or compact failed part way through replacing its files
+    };
+
+    // Outcome of adding each trading day passed to addTradingDaysBatch()
+    enum EBatchResults {
+        EBatchResultAdded,                    // The day was added
+        EBatchResultDuplicate,                // The equity already had a day with that date (or it was given twice)
+        EBatchResultUnknownSymbol,            // No equity has the symbol given
+        EBatchResultNotLoaded                 // The equity's trading data did not load, and there is no journal to keep the day
+    };
+
+    // Ways in which save() can write files
+    enum ESaveModes {
+        ESaveModeInPlace,   // Append new records to each data file in place (the default)
+        ESaveModeAtomic     // Write replacement files beside the originals and rename them into place
     };
 
     // Constructor: Builds a MetaStockDB object using MASTER, EMASTER, and XMASTER files at the path dbpath.
@@ -66,6 +99,23 @@ public:
     // Return the last error message
     std::string lastErrorMessage() const;
 
+    // Number of equities which failed to load in the last load or retry
+    unsigned long numLoadFailures() const;
+
+    // Get the symbol, error code and message of one failed equity (0 <= failureNum < numLoadFailures()).
+    // Return true if success, false if failureNum is out of range
+    bool getLoadFailure(const unsigned long failureNum, std::string &symbol, EErrors &error, std::string &errorMessage) const;
+
+    // Retry loading only the equities which failed to load previously (eg: after the
+    // data files have been repaired).  Return true if every failed equity now loaded
+    bool retryFailedEquities();
+
+    // Load the trading data of the equities with the symbols given which are not yet loaded (a
+    // database opened with lazyLoad loads none until asked), and publish a snapshot holding them.
+    // Symbols not in the database are skipped.  An equity which fails to load is recorded as
+    // in numLoadFailures().  Return true if every equity given that exists is now loaded
+    bool loadEquities(const std::vector<std::string> &symbols);
+
     // Reset at start of list, and copy first item in the list
     // into the parameter.  Return true if success, false otherwise
     bool getFirstEquity(Equity** equityPtr);
@@ -75,9 +125,140 @@ public:
     // Return true if success, false otherwise
     bool getNextEquityPtr(Equity** equityPtr);
 
-    // Return a pointer to the Equity object with the name specified.  Returns NULL if not found
+    // Return a pointer to the Equity object with the name specified.  Returns NULL if not found.
+    // Changes made through the Equity returned take the same lock as the methods below, so
+    // they are serialised with other writers and never block readers of snapshots
     Equity * find(std::string equityName) const;
 
+    // Return the most recently published snapshot of all equities.  May be called from any
+    // thread at any time; the snapshot returned never changes and stays valid for as long
+    // as the caller holds it, no matter what changes are made to the database meanwhile
+    std::shared_ptr<const DBSnapshot> snapshot() const;
+
+    // Publish a new snapshot holding the current state of all equities, so that readers
+    // see the changes made since the last one.  Equities whose trading days did not change
+    // share them with the previous snapshot
+    void publishSnapshot();
+
+    // Start recording every trading day added in a journal in the database directory, so that
+    // added days survive a crash before they are saved.  A database opened with a journal present
+    // reads it back (adding any days not yet saved) and keeps using it.  Each successful save()
+    // empties the journal, apart from days of equities not yet loaded (or which failed to load),
+    // which are added once the equity loads.  Return true if success
+    bool enableJournal();
+
+    // Start write-behind mode, so adding trading days never waits for the disk.  From then on
+    // addTradingDayData() and addTradingDays() only queue the days and return; a background
+    // thread adds them to the equities (as addTradingDaysBatch() does, publishing a new snapshot)
+    // and calls save(), so each changed file is written once however many days it gained.  A flush
+    // starts once flushDays are queued, or flushIntervalMs after the first was queued.  While
+    // maxQueuedDays are queued or being written, callers adding days wait (backpressure).
+    // Days for unknown symbols, or dates already held, are refused when queued as they would be
+    // without write-behind; a date queued twice is skipped when added, and reported by flush().
+    // Return true if success
+    bool enableWriteBehind(const unsigned long maxQueuedDays, const unsigned long flushDays, const unsigned int flushIntervalMs);
+
+    // Wait until every trading day queued in write-behind mode before this call has been added
+    // and saved.  Returns true at once if write-behind mode is not enabled.  Return true if
+    // success, otherwise false with lastError() EErrorWriteBehindFailed (also if a queued day
+    // was not added, eg: its date was queued twice)
+    bool flush();
+
+    // Flush the trading days queued, and leave write-behind mode.  Return true if success
+    bool disableWriteBehind();
+
+    // Adds the passed trading day data to the equity with the symbol specified.  Safe to call
+    // while other threads read snapshots; the change is seen by them after the next
+    // publishSnapshot().  If the journal is enabled, does not return until the day is on disk
+    // (days added by several threads at once are written together).  An equity not yet loaded is
+    // loaded first, so the day is not lost when it loads; if it fails to load, the day is only
+    // added when the journal is enabled (and kept there until the equity loads).  Returns true if succesfully
+    // added new day data; if it was added but could not be written to the journal, returns false
+    // with lastError() EErrorJournalFailed.  In write-behind mode the day is only queued, and
+    // true is returned once it is (false if the equity does not exist or already has the date)
+    bool addTradingDayData(const std::string symbol, const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest);
+
+    // Adds many trading days to the equity with the symbol specified, in any order.  Days whose
+    // date the equity already has are skipped.  Much faster than adding them one at a time.
+    // Journalled in the same way as addTradingDayData().  numAdded is set to the number of
+    // days added (in write-behind mode, the number queued, leaving out dates already held).
+    // Returns false if the equity does not exist, did not load (as addTradingDayData()), or the journal failed
+    bool addTradingDays(const std::string symbol, const std::vector<TradingDay> &days, unsigned long &numAdded);
+
+    // Adds trading days to many equities at once (eg: the end of day update of every symbol),
+    // given as (symbol, trading day) pairs in any order.  The pairs are sorted and the symbols
+    // found in a single pass through the equities, each equity's days are added in one go (days
+    // after its last are appended), and every day is journalled with one flush.  results is set
+    // to the outcome for each pair, in the order given.  The next save() appends to each changed
+    // data file and writes the ?MASTER records of all of them together, so each ?MASTER file is
+    // written once.  Returns false if the journal failed
+    bool addTradingDaysBatch(const std::vector<std::pair<std::string, TradingDay> > &days, std::vector<EBatchResults> &results);
+
+    // Adds a new equity with no trading days, using the lowest free data file number (an
+    // Fx.DAT listed in MASTER / EMASTER while one of 1 to 255 is free, otherwise listed in
+    // XMASTER).  Its files are only created by the next save().  Returns false with lastError()
+    // EErrorEquityAddFailed if the symbol is already in use, too long, or no file number is free
+    bool addEquity(const std::string symbol, const std::string description);
+
+    // Replaces the trading day the equity with the symbol specified already has for the date
+    // given.  The next save() writes only that day's record.  Not recorded in the journal, so a
+    // day changed this way is only kept once saved.  An equity not yet loaded is loaded first.
+    // Returns true if the day was replaced
+    bool updateTradingDayData(const std::string symbol, const Date date, const Time time, const float open, const float close, const float high, const float low, const unsigned long volume, const float openInterest);
+
+    // Changes the description of the equity with the symbol specified.  The next save() writes
+    // only that equity's ?MASTER records.  Returns true if the equity exists
+    bool updateDescription(const std::string symbol, const std::string description);
+
+    // Attaches an indicator (eg: an EMAState) to the equity with the symbol specified.  It is
+    // brought up to date with the equity's trading days, then kept up to date as days are added
+    // or changed: appending a day (or replacing the last, as an intraday refresh of the current
+    // bar does) updates it in constant time, while adding or changing an earlier day recomputes
+    // it.  Its value should be read by the thread adding days, or after flush() in write-behind
+    // mode.  Returns false if the equity does not exist
+    bool attachIndicator(const std::string symbol, const std::shared_ptr<IndicatorState> &indicator);
+
+    // Stops keeping the indicator given up to date.  Returns false if it was not attached to the
+    // equity with the symbol specified
+    bool detachIndicator(const std::string symbol, const std::shared_ptr<IndicatorState> &indicator);
+
+    // Write the trading days added or changed since each equity was loaded or last saved to its data file.
+    // Only the new and changed records are written (an equity with a day inserted before its last saved
+    // day has the records from that day onward rewritten), and equities with no changes are not touched.
+    // Equities whose trading data did not load are never written; days added to them stay in the
+    // journal, and if there are any without one the save returns false.
+    // In ESaveModeInPlace an equity which fails to save does not stop the others.
+    // In ESaveModeAtomic either every changed file is replaced or none is.  If the system crashes
+    // while the files are being renamed into place, the renames are finished the next time the
+    // database is opened.
+    // Each save which changes files first keeps the database as it was before the save as a backup
+    // generation (if numBackups was not 0), in BACKUP.1 in the database directory, with older
+    // generations moved to BACKUP.2 and so on.  If the backup fails nothing is saved.
+    // The ?MASTER records of equities whose data file or description changed are then written
+    // over the records already in the files.  When an equity was added (or the files were not
+    // read) the MASTER, EMASTER, and (if any equity needs it) XMASTER files are instead replaced whole.
+    // If files fail to be renamed into place after the transaction is committed, they are left for
+    // the next open to finish, and until then save() and compact() fail with EErrorCommitInterrupted.
+    // Return true if every changed equity was saved
+    bool save();
+
+    // Rewrite the whole database so that the data file numbers are dense (1, 2, 3...) and the
+    // data files are written one after another in file number order, making a full load read
+    // the disk sequentially.  Equities keep their order (MASTER equities first); equities move
+    // from XMASTER to MASTER while there is room and their symbol and description fit.  The
+    // ?MASTER files are rebuilt to match, and every data file is replaced in one transaction
+    // (as in ESaveModeAtomic), so after a crash the database reopens as either the old or the new one.  Equities
+    // not yet loaded are loaded first; if any cannot be, nothing is changed.  Unsaved trading
+    // days are written as well.  A failure after the transaction is committed is handled as in
+    // save().  Return true if success
+    bool compact();
+
+    // Set how save() writes files
+    void saveMode(const ESaveModes mode);
+
+    // Get how save() writes files
+    ESaveModes saveMode() const;
+
     // Print the entire metastock database
     void print();
 
@@ -89,9 +270,22 @@ private:
     // Description of last error
     string m_lastErrorMessage;
 
+    // An equity whose trading data could not be loaded
+    struct LoadFailure {
+        string symbol;     // Symbol of the equity
+        EErrors error;     // Why it failed
+        string message;    // Description of the failure
+    };
+
+    // Equities which failed to load in the last load or retry
+    vector<LoadFailure> m_loadFailures;
+
     // Path to the database (including trailing slash)
     string m_DBpath;
 
+    // Open descriptor and file listing of the database directory, taken once when opened
+    DirectorySnapshot m_directory;
+
     // Should FDAT files be lazy loaded
     bool m_lazyLoad;
 
@@ -101,6 +295,29 @@ private:
     // Number of backups to keep
     unsigned char m_numBackups;
 
+    // Journal of trading days added since the last save (only used once enabled)
+    Journal m_journal;
+
+    // Days in the journal which save() cannot write yet, by symbol (eg: for an equity not yet
+    // loaded, or which failed to load).  They are added to the equity once it loads, and until
+    // then are kept when the journal is emptied
+    std::map<std::string, std::vector<TradingDay> > m_pinnedDays;
+
+    // How save() writes files
+    ESaveModes m_saveMode;
+
+    // Queue and flusher thread of write-behind mode (only used once enabled)
+    WriteBehind m_writeBehind;
+
+    // Set when the ?MASTER files no longer list the equities (eg: an equity was added), so must
+    // be replaced whole rather than have changed records written over
+    bool m_mastersChanged;
+
+    // Set when a transaction failed after writing its commit record.  The files are only
+    // consistent once recover() has finished it, so nothing more is written until the
+    // database is reopened
+    bool m_commitInterrupted;
+
     // Is there an error in the structure / accessof the DB
     bool m_DBerror;
 
@@ -133,6 +350,18 @@ private:
     // stores position of the current equity from m_equityMap
     map<string, EquityInDB*>::iterator m_equityIt;
 
+    // Most recently published snapshot.  Only accessed with atomic_load / atomic_store
+    std::shared_ptr<const DBSnapshot> m_snapshot;
+
+    // Held by any thread changing equities or publishing a snapshot.  Readers of snapshots never take it
+    std::mutex m_writerMutex;
+
+    // Build and publish a new snapshot.  m_writerMutex must be held by the caller
+    void publishSnapshotWhileLocked();
+
+    // Read a whole file from the database directory into a stream
+    bool openDBFile(const string fileName, MemoryStream &file) const;
+
     // Read the MASTER file
     bool readMasterFile();
 
@@ -145,6 +374,61 @@ private:
     // Read the Fx.DAT files
     bool populateTradingData();
 
+    // Read the Fx.DAT file of one equity, reporting any problem in error / errorMessage
+    bool loadTradingData(EquityInDB* equity, EErrors &error, string &errorMessage);
+
+    // Read the Fx.DAT file of one equity, recording it in m_loadFailures if it fails, and add
+    // any of its days held only in the journal
+    void loadTradingDataOrRecordFailure(EquityInDB* equity);
+
+    // Load an equity not loaded yet before days are added to it, as loading replaces its days.
+    // Return true if days may be added (it loaded, or the journal keeps them until it does)
+    bool loadForChangeWhileLocked(EquityInDB* equity);
+
+    // Name of the Fx.DAT / Cx.MWD file holding the trading data of an equity
+    string dataFileName(EquityInDB* equity) const;
+
+    // Open the journal and add the trading days in it.  m_writerMutex must be held by the caller
+    bool openJournalWhileLocked();
+
+    // Empty the journal after a save, apart from the days in m_pinnedDays.  m_writerMutex must
+    // be held by the caller.  Return true if success
+    bool checkpointJournalWhileLocked();
+
+    // Add the trading days queued in write-behind mode and save them.  Called on the flusher thread.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool flushQueuedDays(const WriteBehind::Batch &days, string &errorMessage);
+
+    // Encode the MASTER record of equity into contents at recordOffset.  The EMASTER and XMASTER
+    // versions do the same for those files.  Return false if a value cannot be held in the record
+    bool encodeMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const;
+    bool encodeEMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const;
+    bool encodeXMasterRecord(EquityInDB* equity, string &contents, const unsigned int recordOffset) const;
+
+    // Build the contents of the MASTER file listing equities (in file number order)
+    bool buildMasterFile(const vector<EquityInDB*> &equities, string &contents) const;
+
+    // Build the contents of the EMASTER file listing equities (in file number order)
+    bool buildEMasterFile(const vector<EquityInDB*> &equities, string &contents) const;
+
+    // Build the contents of the XMASTER file listing equities (in file number order)
+    bool buildXMasterFile(const vector<EquityInDB*> &equities, string &contents) const;
+
+    // Write new ?MASTER files listing every equity, as part of transaction.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool writeMasterFiles(FileTransaction &transaction, string &errorMessage);
+
+    // Write the ?MASTER records of equities (each already listed) over their records in the
+    // files, leaving the rest of each file as it is.  In place the files are written directly,
+    // otherwise copies of them are changed as part of transaction.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool writeMasterRecords(const vector<EquityInDB*> &equities, FileTransaction &transaction, const bool inPlace, string &errorMessage);
+
+    // Write records (encoded, keyed by offset) over fileName, as writeMasterRecords() does.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool writeRecordsToFile(const string fileName, const map<long long, string> &records, FileTransaction &transaction,
+                            const bool inPlace, string &errorMessage);
+
 
 
 
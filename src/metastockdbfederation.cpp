@@ -0,0 +1,207 @@
+/*
+ * Class: MetaStockDBFederation
+ * Author: Marc Stahl
+ * Description: Opens a set of MetaStock database directories in parallel and
+ *   provides a single symbol index over all of them, remembering which directory
+ *   each equity came from.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <limits.h>
+#include <set>
+#include <stdlib.h>
+#include "metastockdbfederation.h"
+#include "parallelfor.h"
+
+using namespace std;
+
+
+// Constructor: Opens one MetaStockDB for each path in dbpaths, in parallel, and builds
+// the unified symbol index
+MetaStockDBFederation::MetaStockDBFederation(const vector<string> dbpaths, const bool lazyLoad, const unsigned char numBackups) :
+    m_equityItValid(false)
+{
+    set<string> canonicalPaths;
+
+    // Two workers must never open the same directory, so keep only the first of each
+    for (unsigned long pathNum = 0; pathNum < dbpaths.size(); pathNum++)
+        if (canonicalPaths.insert(canonicalPath(dbpaths[pathNum])).second) m_directories.push_back(dbpaths[pathNum]);
+    m_databases.assign(m_directories.size(), static_cast<MetaStockDB*>(0));
+
+    // Equities found in each directory, filled in by the worker which opened that directory
+    vector< vector<Equity*> > equitiesPerDirectory(m_directories.size());
+
+    // Open every directory (reading ?MASTER and data files) and list its equities.  Each worker
+    // only touches its own database and its own slot in the vectors, so no locking is required
+    try {
+        ParallelFor::run(m_directories.size(), [&](unsigned long directoryIndex) {
+            MetaStockDB* database = new MetaStockDB(m_directories[directoryIndex], lazyLoad, numBackups);
+            m_databases[directoryIndex] = database;
+
+            Equity* equityPtr;
+            for (bool found = database->getFirstEquity(&equityPtr); found; found = database->getNextEquityPtr(&equityPtr))
+                equitiesPerDirectory[directoryIndex].push_back(equityPtr);
+        }, 0);
+    } catch (...) {
+        // The destructor is not run for an object whose constructor throws
+        for (unsigned long directoryIndex = 0; directoryIndex < m_databases.size(); directoryIndex++)
+            delete m_databases[directoryIndex];
+        throw;
+    }
+
+    // Merge the per directory lists into one index.  Directories are merged in the order given,
+    // so the first directory holding a symbol wins
+    for (unsigned long directoryIndex = 0; directoryIndex < m_directories.size(); directoryIndex++) {
+        for (unsigned long equityNum = 0; equityNum < equitiesPerDirectory[directoryIndex].size(); equityNum++) {
+            IndexEntry entry;
+            entry.equity = equitiesPerDirectory[directoryIndex][equityNum];
+            entry.directoryIndex = directoryIndex;
+
+            // If already supplied by an earlier directory, remember it as shadowed
+            if (!m_symbolIndex.insert(pair<string, IndexEntry>(entry.equity->symbol(), entry)).second)
+                m_shadowed.push_back(pair<string, unsigned long>(entry.equity->symbol(), directoryIndex));
+        }
+    }
+}
+
+
+// Destructor
+MetaStockDBFederation::~MetaStockDBFederation()
+{
+    // Delete all databases (which delete their own equities)
+    for (unsigned long directoryIndex = 0; directoryIndex < m_databases.size(); directoryIndex++)
+        delete m_databases[directoryIndex];
+}
+
+
+// Absolute path of the directory path with every link resolved, or path itself (less any
+// trailing separator) if it does not exist yet
+string MetaStockDBFederation::canonicalPath(const string path)
+{
+    char resolved[PATH_MAX];
+
+    if (realpath(path.c_str(), resolved) != NULL) return resolved;
+
+    // A path still to be created is only compared as given, less any trailing separator
+    string trimmed = path;
+    while ( (trimmed.size() > 1) && (trimmed[trimmed.size() - 1] == PATHSEPERATOR) ) trimmed.erase(trimmed.size() - 1);
+    return trimmed;
+}
+
+
+//============================================================================
+// Getters
+
+// Number of directories in the federation
+unsigned long MetaStockDBFederation::numDirectories() const
+{
+    return m_directories.size();
+}
+
+
+// Path of the directory at the given index
+string MetaStockDBFederation::directory(const unsigned long directoryIndex) const
+{
+    return m_directories.at(directoryIndex);
+}
+
+
+// The database opened for the directory at the given index
+MetaStockDB* MetaStockDBFederation::database(const unsigned long directoryIndex) const
+{
+    return m_databases.at(directoryIndex);
+}
+
+
+// Return true if any directory reported an error while being opened
+bool MetaStockDBFederation::anyErrors() const
+{
+    for (unsigned long directoryIndex = 0; directoryIndex < m_databases.size(); directoryIndex++)
+        if (m_databases[directoryIndex]->lastError() != MetaStockDB::EErrorNone) return true;
+    return false;
+}
+
+
+// Number of equities in the unified index
+unsigned long MetaStockDBFederation::numEquities() const
+{
+    return m_symbolIndex.size();
+}
+
+
+// Number of equities which were hidden by the same symbol in an earlier directory
+unsigned long MetaStockDBFederation::numShadowed() const
+{
+    return m_shadowed.size();
+}
+
+
+// Get the symbol and directory of a hidden equity
+void MetaStockDBFederation::shadowed(const unsigned long shadowedIndex, string &symbol, unsigned long &directoryIndex) const
+{
+    symbol = m_shadowed.at(shadowedIndex).first;
+    directoryIndex = m_shadowed.at(shadowedIndex).second;
+}
+
+
+//============================================================================
+// Unified symbol index
+
+// Reset at start of the unified index, and copy first equity
+// into the parameter.  Return true if success, false otherwise
+bool MetaStockDBFederation::getFirstEquity(Equity** equityPtr)
+{
+    // If empty index, no first element
+    if (m_symbolIndex.empty()) return false;
+
+    // Get first element
+    m_equityIt = m_symbolIndex.begin();
+    *equityPtr = m_equityIt->second.equity;
+
+    // Set flag that iterator is valid
+    m_equityItValid = true;
+    return true;
+}
+
+
+// Advance the iterator, and if there is another equity
+// then copy it into the parameter.
+// Return true if success, false otherwise
+bool MetaStockDBFederation::getNextEquityPtr(Equity** equityPtr)
+{
+    // If iterator is not valid, return failure
+    if (!m_equityItValid) return false;
+
+    // Advance the iterator
+    m_equityIt++;
+
+    // If reached end, invalidate the iterator and return false
+    if (m_equityIt == m_symbolIndex.end()) {
+        m_equityItValid = false;
+        return false;
+    }
+
+    *equityPtr = m_equityIt->second.equity;
+    return true;
+}
+
+
+// Return a pointer to the Equity object with the name specified.  Returns NULL if not found
+Equity * MetaStockDBFederation::find(const string equityName) const
+{
+    map<string, IndexEntry>::const_iterator targetIt = m_symbolIndex.find(equityName);
+    if (targetIt == m_symbolIndex.end()) return NULL;
+    return targetIt->second.equity;
+}
+
+
+// Find the directory which supplied the equity with the name specified.
+// Return true and set directoryIndex if found, false otherwise
+bool MetaStockDBFederation::findDirectory(const string equityName, unsigned long &directoryIndex) const
+{
+    map<string, IndexEntry>::const_iterator targetIt = m_symbolIndex.find(equityName);
+    if (targetIt == m_symbolIndex.end()) return false;
+    directoryIndex = targetIt->second.directoryIndex;
+    return true;
+}
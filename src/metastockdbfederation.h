@@ -0,0 +1,106 @@
+/*
+ * Class: MetaStockDBFederation
+ * Author: Marc Stahl
+ * Description: Opens a set of MetaStock database directories in parallel and
+ *   provides a single symbol index over all of them, remembering which directory
+ *   each equity came from.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef METASTOCKDBFEDERATION_H
+#define METASTOCKDBFEDERATION_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "metastockdb.h"
+#include "equity.h"
+
+class MetaStockDBFederation
+{
+public:
+
+    // Constructor: Opens one MetaStockDB for each path in dbpaths, in parallel, and builds
+    // the unified symbol index.  lazyLoad and numBackups are passed to every MetaStockDB.
+    // If a symbol exists in more than one directory, the directory listed first in dbpaths
+    // wins and the others are recorded as shadowed.  A directory named more than once (eg:
+    // ./db and db) is only opened once, at its first position, as opening a database may write
+    // to it (finishing an interrupted save, or reading back its journal)
+    MetaStockDBFederation(const std::vector<std::string> dbpaths, const bool lazyLoad, const unsigned char numBackups);
+    ~MetaStockDBFederation();
+
+    // Number of directories in the federation
+    unsigned long numDirectories() const;
+
+    // Path of the directory at the given index (as passed to the constructor, less repeats)
+    std::string directory(const unsigned long directoryIndex) const;
+
+    // The database opened for the directory at the given index
+    MetaStockDB* database(const unsigned long directoryIndex) const;
+
+    // Return true if any directory reported an error while being opened
+    bool anyErrors() const;
+
+    // Reset at start of the unified index, and copy first equity
+    // into the parameter.  Return true if success, false otherwise
+    bool getFirstEquity(Equity** equityPtr);
+
+    // Advance the iterator, and if there is another equity
+    // then copy it into the parameter.
+    // Return true if success, false otherwise
+    bool getNextEquityPtr(Equity** equityPtr);
+
+    // Return a pointer to the Equity object with the name specified.  Returns NULL if not found
+    Equity * find(const std::string equityName) const;
+
+    // Find the directory which supplied the equity with the name specified.
+    // Return true and set directoryIndex if found, false otherwise
+    bool findDirectory(const std::string equityName, unsigned long &directoryIndex) const;
+
+    // Number of equities in the unified index
+    unsigned long numEquities() const;
+
+    // Number of equities which were hidden by the same symbol in an earlier directory
+    unsigned long numShadowed() const;
+
+    // Get the symbol and directory of a hidden equity (0 <= shadowedIndex < numShadowed())
+    void shadowed(const unsigned long shadowedIndex, std::string &symbol, unsigned long &directoryIndex) const;
+
+private:
+
+    // One entry in the unified symbol index
+    struct IndexEntry {
+        Equity* equity;                 // Equity held by one of the databases
+        unsigned long directoryIndex;   // Index of the directory holding the equity
+    };
+
+    // Paths to the directories, in the order given (without repeats)
+    std::vector<std::string> m_directories;
+
+    // One database per directory (same order as m_directories)
+    std::vector<MetaStockDB*> m_databases;
+
+    // Unified symbol index over all directories
+    std::map<std::string, IndexEntry> m_symbolIndex;
+
+    // Equities hidden by an earlier directory (symbol, directory index)
+    std::vector< std::pair<std::string, unsigned long> > m_shadowed;
+
+    // If the equity iterator has reached the end of the index, then false.
+    // Otherwise true.
+    bool m_equityItValid;
+
+    // stores position of the current equity from m_symbolIndex
+    std::map<std::string, IndexEntry>::iterator m_equityIt;
+
+    // Absolute path of the directory path with every link resolved, or path itself (less any
+    // trailing separator) if it does not exist yet
+    static std::string canonicalPath(const std::string path);
+
+    // The federation owns the databases, so copying is not allowed
+    MetaStockDBFederation(const MetaStockDBFederation &);
+    void operator=(const MetaStockDBFederation &);
+};
+
+#endif // METASTOCKDBFEDERATION_H
@@ -11,15 +11,28 @@
 #include <sys/stat.h>
 #include <string>
 #include <string.h>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "bytearray.h"
 #include "msfileio.h"
 
+// Size of each block copied when a file cannot be shared by reflink
+#define MSFILEIO_COPY_BLOCK    (1024 * 1024)
+
 
 // Read n bytes from the specified file and convert it to an unsigned int.
 // n is 2 or 4 depending on the integerType parameter.
 // Return true/false to indicate if successfull.
-bool MSFileIO::readUIntFromFile(ifstream &file, const unsigned int offset, unsigned long int &resultUInt, const EVariablesTypes integerType)
+bool MSFileIO::readUIntFromFile(istream &file, const unsigned int offset, unsigned long int &resultUInt, const EVariablesTypes integerType)
 {
     resultUInt = 0;  //  Initialize the unsigned integer to 0 as default
 
@@ -65,7 +78,7 @@ bool MSFileIO::readUIntFromFile(ifstream &file, const unsigned int offset, unsig
 
 // Read 1 byte from the specified file and convert it to an unsigned char.
 // Return true/false to indicate if successfull.
-bool MSFileIO::readUByteFromFile(ifstream &file, const unsigned int offset, unsigned char &resultUChar)
+bool MSFileIO::readUByteFromFile(istream &file, const unsigned int offset, unsigned char &resultUChar)
 {
     resultUChar = 0;  // Initialize the unsigned integer to 0 as default
     if (!file.seekg(offset)) return false;  // Set the file pointer in the stream, and return false if could not
@@ -79,7 +92,7 @@ bool MSFileIO::readUByteFromFile(ifstream &file, const unsigned int offset, unsi
 
 // Read specified number of bytes from the specified file and place in an array of unsigned char
 // Return true/false to indicate if successfull.
-bool MSFileIO::readByteArrayFromFile(ifstream &file, const unsigned int offset, ByteArray &resultByteArray)
+bool MSFileIO::readByteArrayFromFile(istream &file, const unsigned int offset, ByteArray &resultByteArray)
 {
     if (!file.seekg(offset)) return false;  // Set the file pointer in the stream, and return false if could not
     unsigned char* buffer = new unsigned char[resultByteArray.size()];  // Buffer to hold read byte
@@ -96,7 +109,7 @@ bool MSFileIO::readByteArrayFromFile(ifstream &file, const unsigned int offset,
 // string. Note that all strings stored in Master, EMaster
 // , and XMaster are null padded, with null's stretching from the end of the string to the end of the byte field.
 // Return true/false to indicate if successfull.
-bool MSFileIO::readStringFromFile(ifstream &file, const unsigned int offset, const int byteFieldSize, string &resultString)
+bool MSFileIO::readStringFromFile(istream &file, const unsigned int offset, const int byteFieldSize, string &resultString)
 {
     resultString = "";  // Initialize the string to empty
     if (!file.seekg(offset)) return false;  // Set the file pointer in the stream, and return false if could not
@@ -133,8 +146,8 @@ bool MSFileIO::MBF32ToFloat(const unsigned char inputBytes[4], float &resultFloa
     // Reset the resultant float to all 0's
     for (int i=0; i<4; i++) ieee[i] = 0;
 
-    // Initialize sign and exponent
-    unsigned char sign = 0x00;
+    // Initialize sign (held in the top bit of the third byte) and exponent
+    unsigned char sign = msbin[2] & 0x80;
     unsigned char ieee_exp = 0x00;
 
     // Transfer the sign, exponent, and mantissa to new float
@@ -151,6 +164,268 @@ bool MSFileIO::MBF32ToFloat(const unsigned char inputBytes[4], float &resultFloa
 
 
 
+// Converts from a floating point number to a MBF32 floating point number
+// Return false if the number is too large to be held as MBF32
+bool MSFileIO::floatToMBF32(const float inputFloat, unsigned char resultBytes[4])
+{
+    unsigned long ieee;
+    unsigned char ieeeBytes[4];
+
+    // Get at the bits of the float (little endian, as the rest of this file assumes)
+    memcpy(ieeeBytes, &inputFloat, 4);
+    ieee = ieeeBytes[3];
+    ieee = (ieee << 8) + ieeeBytes[2];
+    ieee = (ieee << 8) + ieeeBytes[1];
+    ieee = (ieee << 8) + ieeeBytes[0];
+
+    unsigned char sign = (ieee >> 31) & 0x01;
+    unsigned char ieee_exp = (ieee >> 23) & 0xff;
+
+    /* zero (and numbers too small for MBF) = msbin w/ exponent of zero */
+    if (ieee_exp == 0) {
+        for (int i=0; i<4; i++) resultBytes[i] = 0;
+        return true;
+    }
+
+    // MBF exponent is 2 higher than IEEE, so the top two IEEE exponents (including inf / NaN) do not fit
+    if (ieee_exp >= 0xfe) return false;
+
+    // Transfer the exponent, sign, and mantissa to the MBF
+    resultBytes[3] = ieee_exp + 2;    /* actually, ieee_exp+1+128-127 */
+    resultBytes[2] = (sign << 7) | ((ieee >> 16) & 0x7f);
+    resultBytes[1] = (ieee >> 8) & 0xff;
+    resultBytes[0] = ieee & 0xff;
+
+    return true;
+}
+
+
+// Converts a date to the floating point form used in MetaStock files (YYMMDD, or
+// CYYMMDD from the year 2000).  Only years 1980 to 2079 can be read back by floatToDate,
+// so any other date fails
+bool MSFileIO::dateToFloat(const Date inputDate, float &resultFloat)
+{
+    resultFloat = 0;
+    if ((inputDate.Year() < 1980) || (inputDate.Year() > 2079)) return false;
+
+    resultFloat = static_cast<float>((inputDate.Year() - 1900) * 10000 + inputDate.Month() * 100 + inputDate.day());
+    return true;
+}
+
+
+// Converts count floating point numbers to MBF32, writing 4 bytes per number to resultBytes.
+// Return false if any number is too large to be held as MBF32
+bool MSFileIO::floatsToMBF32(const float *inputFloats, const unsigned long count, unsigned char *resultBytes)
+{
+    bool allValid = true;
+    unsigned long floatNum = 0;
+
+#ifdef __SSE2__
+    // As a little endian 32 bit word, MBF32 is (exponent + 2) << 24 | sign << 23 | mantissa, where
+    // IEEE is sign << 31 | exponent << 23 | mantissa.  Convert four numbers at a time that way
+    const __m128i exponentMask = _mm_set1_epi32(0xff);
+    const __m128i mantissaMask = _mm_set1_epi32(0x7fffff);
+    const __m128i exponentBias = _mm_set1_epi32(2);
+    const __m128i largestExponent = _mm_set1_epi32(0xfd);
+    __m128i tooLarge = _mm_setzero_si128();
+
+    for (; floatNum + 4 <= count; floatNum += 4) {
+        __m128i ieee = _mm_castps_si128(_mm_loadu_ps(inputFloats + floatNum));
+        __m128i ieeeExponent = _mm_and_si128(_mm_srli_epi32(ieee, 23), exponentMask);
+        __m128i mbf = _mm_or_si128(_mm_slli_epi32(_mm_add_epi32(ieeeExponent, exponentBias), 24),
+                      _mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(ieee, 31), 23),
+                                   _mm_and_si128(ieee, mantissaMask)));
+
+        // Zero (and numbers too small for MBF) have an exponent of zero, and are all zero in MBF
+        mbf = _mm_andnot_si128(_mm_cmpeq_epi32(ieeeExponent, _mm_setzero_si128()), mbf);
+        tooLarge = _mm_or_si128(tooLarge, _mm_cmpgt_epi32(ieeeExponent, largestExponent));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(resultBytes + floatNum * 4), mbf);
+    }
+    if (_mm_movemask_epi8(tooLarge) != 0) allValid = false;
+#endif
+
+    // Convert any left over one at a time
+    for (; floatNum < count; floatNum++)
+        if (!floatToMBF32(inputFloats[floatNum], resultBytes + floatNum * 4)) allValid = false;
+
+    return allValid;
+}
+
+
+// Converts count dates to the floating point form used in MetaStock files.
+// Return false if any date cannot be held in this form
+bool MSFileIO::datesToFloats(const Date *inputDates, const unsigned long count, float *resultFloats)
+{
+    bool allValid = true;
+    unsigned long dateNum = 0;
+
+#ifdef __SSE2__
+    // Work out (year - 1900) * 10000 + month * 100 + day four dates at a time.  Every value is
+    // below 2^24, so the sums are exact in single precision
+    const __m128 yearScale = _mm_set1_ps(10000.0f);
+    const __m128 monthScale = _mm_set1_ps(100.0f);
+    const __m128i baseYear = _mm_set1_epi32(1900);
+    const __m128i firstYear = _mm_set1_epi32(1980 - 1900);
+    const __m128i lastYear = _mm_set1_epi32(2079 - 1900);
+    __m128i outOfRange = _mm_setzero_si128();
+
+    for (; dateNum + 4 <= count; dateNum += 4) {
+        const Date *date = inputDates + dateNum;
+        __m128i year = _mm_sub_epi32(_mm_set_epi32(date[3].Year(), date[2].Year(), date[1].Year(), date[0].Year()), baseYear);
+        __m128i month = _mm_set_epi32(date[3].Month(), date[2].Month(), date[1].Month(), date[0].Month());
+        __m128i day = _mm_set_epi32(date[3].day(), date[2].day(), date[1].day(), date[0].day());
+
+        outOfRange = _mm_or_si128(outOfRange, _mm_or_si128(_mm_cmplt_epi32(year, firstYear), _mm_cmpgt_epi32(year, lastYear)));
+
+        __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(year), yearScale),
+                                              _mm_mul_ps(_mm_cvtepi32_ps(month), monthScale)),
+                                   _mm_cvtepi32_ps(day));
+        _mm_storeu_ps(resultFloats + dateNum, result);
+    }
+
+    // dateToFloat gives 0 for a date out of range, so do the same for any found
+    if (_mm_movemask_epi8(outOfRange) != 0) {
+        allValid = false;
+        for (unsigned long checkNum = 0; checkNum < dateNum; checkNum++)
+            if ((inputDates[checkNum].Year() < 1980) || (inputDates[checkNum].Year() > 2079)) resultFloats[checkNum] = 0;
+    }
+#endif
+
+    // Convert any left over one at a time
+    for (; dateNum < count; dateNum++)
+        if (!dateToFloat(inputDates[dateNum], resultFloats[dateNum])) allValid = false;
+
+    return allValid;
+}
+
+
+// Copy the whole of the file open on sourceFd to destinationFd, by reflink if possible.
+// Return true if success, false otherwise
+bool MSFileIO::copyFileContents(const int sourceFd, const int destinationFd)
+{
+#ifdef FICLONE
+    // Share the data blocks rather than copy them, on file systems which support it
+    if (ioctl(destinationFd, FICLONE, sourceFd) == 0) return true;
+#endif
+
+    vector<char> block(MSFILEIO_COPY_BLOCK);
+    off_t offset = 0;
+
+    while (true) {
+        ssize_t bytesRead = pread(sourceFd, &block[0], block.size(), offset);
+        if ((bytesRead < 0) && (errno == EINTR)) continue;
+        if (bytesRead < 0) return false;
+        if (bytesRead == 0) return true;
+
+        ssize_t bytesWritten = 0;
+        while (bytesWritten < bytesRead) {
+            ssize_t result = pwrite(destinationFd, &block[bytesWritten], bytesRead - bytesWritten, offset + bytesWritten);
+            if ((result < 0) && (errno == EINTR)) continue;
+            if (result <= 0) return false;
+            bytesWritten += result;
+        }
+        offset += bytesRead;
+    }
+}
+
+
+// Write the whole of buffer to the file open on fd at offset, retrying short writes.
+// Return true if success, false otherwise
+bool MSFileIO::writeBufferToFile(const int fd, const long long offset, const string &buffer)
+{
+    size_t bytesWritten = 0;
+
+    while (bytesWritten < buffer.size()) {
+        ssize_t result = pwrite(fd, buffer.data() + bytesWritten, buffer.size() - bytesWritten, offset + bytesWritten);
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result <= 0) return false;
+        bytesWritten += result;
+    }
+    return true;
+}
+
+
+// Write an unsigned int into buffer at offset, as the integer type given.
+// Return true/false to indicate if successfull.
+bool MSFileIO::writeUIntToBuffer(string &buffer, const unsigned int offset, const unsigned long value, const EVariablesTypes integerType)
+{
+    unsigned int numBytesToWrite;
+
+    // Determine how many bytes to write based on integer type
+    if (integerType == EVariableTypeCVL) numBytesToWrite = 4;
+    else if (integerType == EVariableTypeUShort) numBytesToWrite = 2;
+    else if (integerType == EVariableTypeUByte) numBytesToWrite = 1;
+    else return false;
+
+    if (offset + numBytesToWrite > buffer.size()) return false;
+
+    // Least significant byte first
+    for (unsigned int byteNum = 0; byteNum < numBytesToWrite; byteNum++)
+        buffer[offset + byteNum] = static_cast<char>((value >> (8 * byteNum)) & 0xff);
+    return true;
+}
+
+
+// Copy the contents of a ByteArray into buffer at offset
+void MSFileIO::writeByteArrayToBuffer(string &buffer, const unsigned int offset, const ByteArray &value)
+{
+    if (offset + value.size() > buffer.size()) return;
+    value.getContents(reinterpret_cast<unsigned char *>(&buffer[offset]));
+}
+
+
+// Write a date into buffer at offset, in the form given.  An invalid date is written as 0.
+// Return true/false to indicate if successfull.
+bool MSFileIO::writeDateToBuffer(string &buffer, const unsigned int offset, const Date value, const EVariablesTypes varType)
+{
+    float dateAsFloat = 0;
+
+    if (varType == EVariableTypeCVL) return writeUIntToBuffer(buffer, offset, value.asYYYYMMDD(), varType);
+
+    if ( (value.isValid()) && (!dateToFloat(value, dateAsFloat)) ) return false;
+    return writeFloatToBuffer(buffer, offset, dateAsFloat, varType);
+}
+
+
+// Write a string into a 'byteFieldSize' field of buffer at offset, null padded
+void MSFileIO::writeStringToBuffer(string &buffer, const unsigned int offset, const int byteFieldSize, const string value)
+{
+    if (offset + byteFieldSize > buffer.size()) return;
+    for (int byteNum = 0; byteNum < byteFieldSize; byteNum++)
+        buffer[offset + byteNum] = (static_cast<unsigned int>(byteNum) < value.size()) ? value[byteNum] : '\0';
+}
+
+
+// Write a float into buffer at offset, in the form given (MBF32, CVS or CVSR).
+// Return true/false to indicate if successfull.
+bool MSFileIO::writeFloatToBuffer(string &buffer, const unsigned int offset, const float value, const EVariablesTypes floatType)
+{
+    unsigned char bytes[4];
+
+    if (offset + 4 > buffer.size()) return false;
+
+    switch (floatType) {
+    case EVariableTypeMBF32:
+        if (!floatToMBF32(value, bytes)) return false;
+        break;
+    case EVariableTypeCVS:
+        memcpy(bytes, &value, 4);
+        break;
+    case EVariableTypeCVSR:
+        memcpy(bytes, &value, 4);
+        swap(bytes[0], bytes[3]);
+        swap(bytes[1], bytes[2]);
+        break;
+    default:
+        return false;  // Unknown float type
+    }
+
+    memcpy(&buffer[offset], bytes, 4);
+    return true;
+}
+
+
 // Converts from a CVS floating point number to a floating point number
 // Note that CVS already in ieee single floating point format
 bool MSFileIO::CVSToFloat(unsigned char inputBytes[4], float &resultFloat, const bool reversed)
@@ -177,7 +452,7 @@ bool MSFileIO::CVSToFloat(unsigned char inputBytes[4], float &resultFloat, const
 
 // Read 4 bytes from the specified file as 32bit MBF and convert it to a float
 // Return true/false to indicate if successfull.
-bool MSFileIO::readFloatFromFile(ifstream &file, const unsigned int offset, float &resultFloat, const EVariablesTypes floatType)
+bool MSFileIO::readFloatFromFile(istream &file, const unsigned int offset, float &resultFloat, const EVariablesTypes floatType)
 {
     bool returnValue;
 
@@ -247,7 +522,7 @@ bool MSFileIO::floatToDate(const float dateAsFloat, Date &resultDate)
 
 // Read 4 bytes from the specified file and convert it to a date.
 // Return true/false to indicate if successfull.
-bool MSFileIO::readDateFromFile(ifstream &file, const unsigned int offset, Date &resultDate, const EVariablesTypes varType)
+bool MSFileIO::readDateFromFile(istream &file, const unsigned int offset, Date &resultDate, const EVariablesTypes varType)
 {
     resultDate = Date();  // Initialize an invalid date
     float tempFloat;  // Temporary holder for the read in float
@@ -262,14 +537,23 @@ bool MSFileIO::readDateFromFile(ifstream &file, const unsigned int offset, Date
         if (!MSFileIO::readFloatFromFile(file, offset, tempFloat, varType)) return false;
         break;
     case EVariableTypeCVL :
+        // Held as YYYYMMDD, which a float cannot hold exactly, so decode it directly
         if (!MSFileIO::readUIntFromFile(file, offset, tempInt, varType)) return false;
-        tempFloat = tempInt;
-        break;
+        if (tempInt == 0) return true;
+        if (tempInt < 10000000) {
+            tempFloat = tempInt;
+            break;
+        }
+        resultDate = Date(tempInt / 10000, (tempInt / 100) % 100, tempInt % 100);
+        return true;
     default :
         return false;
         break;
     }
 
+    // A date never set is held as 0, and read as an invalid date
+    if (tempFloat == 0) return true;
+
     // Create a date object from the information in the byte field.
     return MSFileIO::floatToDate(tempFloat, resultDate);
 }
@@ -44,28 +44,48 @@ public:
 
     // Read bytes from the specified file and convert it to an unsigned int.
     // Return true/false to indicate if successfull.
-    static bool readUIntFromFile(ifstream &file, const unsigned int offset, unsigned long &resultUInt, const EVariablesTypes integerType);
+    static bool readUIntFromFile(istream &file, const unsigned int offset, unsigned long &resultUInt, const EVariablesTypes integerType);
 
     // Read 1 byte from the specified file and convert it to an unsigned char.
     // Return true/false to indicate if successfull.
-    static bool readUByteFromFile(ifstream &file, const unsigned int offset, unsigned char &resultUChar);
+    static bool readUByteFromFile(istream &file, const unsigned int offset, unsigned char &resultUChar);
 
     // Read specified number of bytes from the specified file and place in an array of unsigned char
     // Return true/false to indicate if successfull.
-    static bool readByteArrayFromFile(ifstream &file, const unsigned int offset, ByteArray &resultByteArray);
+    static bool readByteArrayFromFile(istream &file, const unsigned int offset, ByteArray &resultByteArray);
 
     // Read 4 bytes from the specified file and convert it to a date.
     // Return true/false to indicate if successfull.
-    static bool readDateFromFile(ifstream &file, const unsigned int offset, Date &resultDate, const EVariablesTypes varType);
+    static bool readDateFromFile(istream &file, const unsigned int offset, Date &resultDate, const EVariablesTypes varType);
 
     // Read 'byteFieldSize' bytes from the specified file and convert it to a string. Note that all strings stored in Master, EMaster
     // , and XMaster are null padded, with null's stretching from the end of the string to the end of the byte field.
     // Return true/false to indicate if successfull.
-    static bool readStringFromFile(ifstream &file, const unsigned int offset, const int byteFieldSize, string &resultString);
+    static bool readStringFromFile(istream &file, const unsigned int offset, const int byteFieldSize, string &resultString);
 
     // Read 4 bytes from the specified file as 32bit MBF and convert it to a float
     // Return true/false to indicate if successfull.
-    static bool readFloatFromFile(ifstream &file, const unsigned int offset, float &resultFloat, const EVariablesTypes floatType);
+    static bool readFloatFromFile(istream &file, const unsigned int offset, float &resultFloat, const EVariablesTypes floatType);
+
+    // Write an unsigned int into buffer at offset, as the integer type given (CVL, UShort, or UByte).
+    // buffer must already be large enough.  Return true/false to indicate if successfull.
+    static bool writeUIntToBuffer(string &buffer, const unsigned int offset, const unsigned long value, const EVariablesTypes integerType);
+
+    // Copy the contents of a ByteArray into buffer at offset.  buffer must already be large enough.
+    static void writeByteArrayToBuffer(string &buffer, const unsigned int offset, const ByteArray &value);
+
+    // Write a date into buffer at offset, in the form given (MBF32, CVS, CVSR as YYMMDD/CYYMMDD, or CVL
+    // as YYYYMMDD).  An invalid date is written as 0.  buffer must already be large enough.
+    // Return true/false to indicate if successfull.
+    static bool writeDateToBuffer(string &buffer, const unsigned int offset, const Date value, const EVariablesTypes varType);
+
+    // Write a string into a 'byteFieldSize' field of buffer at offset, null padded as in all ?MASTER files (cut short if too long).
+    // buffer must already be large enough.
+    static void writeStringToBuffer(string &buffer, const unsigned int offset, const int byteFieldSize, const string value);
+
+    // Write a float into buffer at offset, in the form given (MBF32, CVS or CVSR).  buffer must already be
+    // large enough.  Return true/false to indicate if successfull.
+    static bool writeFloatToBuffer(string &buffer, const unsigned int offset, const float value, const EVariablesTypes floatType);
 
     // Converts from a CVS floating point number to a floating point number
     // Note that CVS already in ieee single floating point format
@@ -74,6 +94,33 @@ public:
     // Converts from a MBF32 floating point number to a floating point number
     static bool MBF32ToFloat(const unsigned char inputBytes[4], float &resultFloat);
 
+    // Converts from a floating point number to a MBF32 floating point number
+    // Return false if the number is too large to be held as MBF32
+    static bool floatToMBF32(const float inputFloat, unsigned char resultBytes[4]);
+
+    // Converts a date to the floating point form used in MetaStock files (YYMMDD, or
+    // CYYMMDD from the year 2000).  Return false if the date cannot be held in this form
+    static bool dateToFloat(const Date inputDate, float &resultFloat);
+
+    // Converts count floating point numbers to MBF32, writing 4 bytes per number to resultBytes.
+    // Gives the same bytes as floatToMBF32, several numbers at a time where SSE2 is available.
+    // Return false if any number is too large to be held as MBF32
+    static bool floatsToMBF32(const float *inputFloats, const unsigned long count, unsigned char *resultBytes);
+
+    // Converts count dates to the floating point form used in MetaStock files, as dateToFloat
+    // does, several dates at a time where SSE2 is available.
+    // Return false if any date cannot be held in this form
+    static bool datesToFloats(const Date *inputDates, const unsigned long count, float *resultFloats);
+
+    // Copy the whole of the file open on sourceFd to destinationFd.  Where the file system
+    // allows, the data is shared by reflink (FICLONE) rather than copied.
+    // Return true if success, false otherwise
+    static bool copyFileContents(const int sourceFd, const int destinationFd);
+
+    // Write the whole of buffer to the file open on fd at offset, retrying short writes.
+    // Return true if success, false otherwise (with the reason in errno)
+    static bool writeBufferToFile(const int fd, const long long offset, const string &buffer);
+
     // Tests if a path exists
     static bool DBPathExists(const string pathname);
 
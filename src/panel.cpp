@@ -0,0 +1,196 @@
+/*
+ * Class: Panel
+ * Author: Marc Stahl
+ * Description: A matrix of one field of several equities on a common axis of
+ *   dates, built with a k-way merge of their dates and filled in parallel.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include "panel.h"
+#include "parallelfor.h"
+
+using namespace std;
+
+
+// Constructor: Create an empty panel
+Panel::Panel()
+{
+}
+
+
+// Compare a trading day with a date held as YYYYMMDD, to search a list by date
+static bool tradingDayBefore(const TradingDay &tradingDay, const unsigned long date)
+{
+    return (tradingDay.date().asYYYYMMDD() < date);
+}
+
+
+// Merge two date ordered lists of dates (or copy the first if second is NULL) into merged, keeping
+// only the dates in both if intersect is true, otherwise every date in either (once)
+static void mergeDates(const vector<unsigned long> &first, const vector<unsigned long> *second, const bool intersect,
+                       vector<unsigned long> &merged)
+{
+    if (second == NULL) {
+        merged = first;
+    } else if (intersect) {
+        set_intersection(first.begin(), first.end(), second->begin(), second->end(), back_inserter(merged));
+    } else {
+        merged.reserve(first.size() > second->size() ? first.size() : second->size());
+        set_union(first.begin(), first.end(), second->begin(), second->end(), back_inserter(merged));
+    }
+}
+
+
+// Build the panel of field for the equities with the symbols given, over the dates from firstDate
+// to lastDate inclusive held by any of them.  Return true if success, otherwise false
+bool Panel::build(const DBSnapshot &snapshot, const vector<string> &symbols, const Indicators::EFields field,
+                  const Date firstDate, const Date lastDate, const EMissingPolicies missingPolicy, const unsigned int maxThreads)
+{
+    unsigned long numSymbols = symbols.size();
+    unsigned long first = firstDate.asYYYYMMDD();
+    unsigned long last = lastDate.asYYYYMMDD();
+
+    m_dates.clear();
+    m_symbols.clear();
+    m_values.clear();
+    m_lastErrorMessage = "";
+
+    // The trading days of each equity within the range, as [begin, end) positions in its list
+    vector<const vector<TradingDay> *> equityDays(numSymbols);
+    vector<unsigned long> begins(numSymbols);
+    vector<unsigned long> ends(numSymbols);
+    for (unsigned long symbolNum = 0; symbolNum < numSymbols; symbolNum++) {
+        const DBSnapshot::EquitySnapshot *equity = snapshot.find(symbols[symbolNum]);
+        if (equity == NULL) {
+            m_lastErrorMessage = "Symbol not found: " + symbols[symbolNum];
+            return false;
+        }
+        const vector<TradingDay> &days = *equity->tradingDays;
+        equityDays[symbolNum] = &days;
+        begins[symbolNum] = lower_bound(days.begin(), days.end(), first, tradingDayBefore) - days.begin();
+        ends[symbolNum] = lower_bound(days.begin(), days.end(), last + 1, tradingDayBefore) - days.begin();
+    }
+
+    // The dates of each equity within the range, as YYYYMMDD numbers
+    vector<vector<unsigned long> > dateColumns(numSymbols);
+    ParallelFor::run(numSymbols, [&](unsigned long symbolNum) {
+        const vector<TradingDay> &days = *equityDays[symbolNum];
+        dateColumns[symbolNum].reserve(ends[symbolNum] - begins[symbolNum]);
+        for (unsigned long dayNum = begins[symbolNum]; dayNum < ends[symbolNum]; dayNum++) {
+            dateColumns[symbolNum].push_back(days[dayNum].date().asYYYYMMDD());
+        }
+    }, maxThreads);
+
+    // k-way merge of the date columns, done as a tree of two-way merges: the columns are merged
+    // in pairs, then the results in pairs, until one is left.  Each merge reads its two inputs
+    // straight through (rather than jumping between every equity's list for each date), and
+    // the merges of each level run in parallel.  When dropping, only dates in both inputs are kept
+    vector<vector<unsigned long> > runs((numSymbols + 1) / 2);
+    ParallelFor::run(runs.size(), [&](unsigned long runNum) {
+        mergeDates(dateColumns[2 * runNum], (2 * runNum + 1 < numSymbols) ? &dateColumns[2 * runNum + 1] : NULL,
+                   missingPolicy == EMissingPolicyDrop, runs[runNum]);
+    }, maxThreads);
+    while (runs.size() > 1) {
+        vector<vector<unsigned long> > nextRuns((runs.size() + 1) / 2);
+        ParallelFor::run(nextRuns.size(), [&](unsigned long runNum) {
+            mergeDates(runs[2 * runNum], (2 * runNum + 1 < runs.size()) ? &runs[2 * runNum + 1] : NULL,
+                       missingPolicy == EMissingPolicyDrop, nextRuns[runNum]);
+        }, maxThreads);
+        runs.swap(nextRuns);
+    }
+    vector<unsigned long> axis;
+    if (!runs.empty()) axis.swap(runs[0]);
+    for (unsigned long dateNum = 0; dateNum < axis.size(); dateNum++) {
+        m_dates.push_back(Date(axis[dateNum] / 10000, (axis[dateNum] / 100) % 100, axis[dateNum] % 100));
+    }
+
+    // Fill each column by walking the equity's dates and the axis together.  Each thread writes
+    // only its own columns
+    unsigned long numDates = axis.size();
+    m_values.assign(numSymbols * numDates, numeric_limits<double>::quiet_NaN());
+    ParallelFor::run(numSymbols, [&](unsigned long symbolNum) {
+        const vector<TradingDay> &days = *equityDays[symbolNum];
+        const vector<unsigned long> &dates = dateColumns[symbolNum];
+        double *column = m_values.data() + symbolNum * numDates;
+        unsigned long begin = begins[symbolNum];
+        unsigned long dateNum = 0;
+
+        // Forward fill starts from the last day before the range, if there is one
+        double lastValue = numeric_limits<double>::quiet_NaN();
+        if ( (missingPolicy == EMissingPolicyForwardFill) && (begin > 0) ) lastValue = Indicators::fieldValue(days[begin - 1], field);
+
+        for (unsigned long axisNum = 0; axisNum < numDates; axisNum++) {
+            while ( (dateNum < dates.size()) && (dates[dateNum] < axis[axisNum]) ) dateNum++;
+            if ( (dateNum < dates.size()) && (dates[dateNum] == axis[axisNum]) ) {
+                lastValue = Indicators::fieldValue(days[begin + dateNum], field);
+                column[axisNum] = lastValue;
+                dateNum++;
+            } else if (missingPolicy == EMissingPolicyForwardFill) {
+                column[axisNum] = lastValue;
+            }
+        }
+    }, maxThreads);
+
+    m_symbols = symbols;
+    return true;
+}
+
+
+// Number of dates on the axis (rows)
+unsigned long Panel::numDates() const
+{
+    return m_dates.size();
+}
+
+
+// Number of equities (columns)
+unsigned long Panel::numSymbols() const
+{
+    return m_symbols.size();
+}
+
+
+// Date of a row, in date order
+Date Panel::date(const unsigned long dateNum) const
+{
+    return m_dates[dateNum];
+}
+
+
+// Symbol of a column
+string Panel::symbol(const unsigned long symbolNum) const
+{
+    return m_symbols[symbolNum];
+}
+
+
+// The numDates() values of a column, in date order
+const double * Panel::column(const unsigned long symbolNum) const
+{
+    return m_values.empty() ? NULL : &m_values[symbolNum * m_dates.size()];
+}
+
+
+// The whole matrix, column after column
+const double * Panel::data() const
+{
+    return m_values.empty() ? NULL : &m_values[0];
+}
+
+
+// Value for a date and symbol
+double Panel::value(const unsigned long dateNum, const unsigned long symbolNum) const
+{
+    return m_values[symbolNum * m_dates.size() + dateNum];
+}
+
+
+// Description of the last error
+string Panel::lastErrorMessage() const
+{
+    return m_lastErrorMessage;
+}
@@ -0,0 +1,83 @@
+/*
+ * Class: Panel
+ * Author: Marc Stahl
+ * Description: A matrix of one field (eg: the close) of several equities on a
+ *   common axis of dates, for portfolio and risk work.  The axis is the outer
+ *   join of the equities' dates within a range, found with a k-way merge of
+ *   their date ordered trading days.  The matrix is stored column major (the
+ *   dates of one equity are contiguous) and the columns are filled in parallel.
+ *   A date on which an equity has no trading day is NaN, takes the equity's last
+ *   value before it (forward fill), or is dropped from the axis altogether.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef PANEL_H
+#define PANEL_H
+
+#include <string>
+#include <vector>
+#include "date.h"
+#include "dbsnapshot.h"
+#include "indicators.h"
+
+class Panel
+{
+public:
+
+    // What to do about a date on which an equity has no trading day
+    enum EMissingPolicies {
+        EMissingPolicyNaN,          // The cell is NaN
+        EMissingPolicyForwardFill,  // The cell takes the equity's last value before the date (NaN if none)
+        EMissingPolicyDrop          // The date is left out of the axis, so only dates every equity has are kept
+    };
+
+    // Constructor: Create an empty panel
+    Panel();
+
+    // Build the panel of field for the equities with the symbols given (one column each, in the order
+    // given), over the dates from firstDate to lastDate inclusive held by any of them.  Uses at most
+    // maxThreads threads (0 = one per hardware thread).  Return true if success, otherwise false
+    // (with the panel left empty) with the reason in lastErrorMessage() (eg: a symbol is not in snapshot)
+    bool build(const DBSnapshot &snapshot, const std::vector<std::string> &symbols, const Indicators::EFields field,
+               const Date firstDate, const Date lastDate, const EMissingPolicies missingPolicy, const unsigned int maxThreads);
+
+    // Number of dates on the axis (rows)
+    unsigned long numDates() const;
+
+    // Number of equities (columns)
+    unsigned long numSymbols() const;
+
+    // Date of a row (0 <= dateNum < numDates()), in date order
+    Date date(const unsigned long dateNum) const;
+
+    // Symbol of a column (0 <= symbolNum < numSymbols())
+    std::string symbol(const unsigned long symbolNum) const;
+
+    // The numDates() values of a column, in date order
+    const double * column(const unsigned long symbolNum) const;
+
+    // The whole matrix, column after column (the value for a date and symbol is at
+    // symbolNum * numDates() + dateNum)
+    const double * data() const;
+
+    // Value for a date and symbol
+    double value(const unsigned long dateNum, const unsigned long symbolNum) const;
+
+    // Description of the last error
+    std::string lastErrorMessage() const;
+
+private:
+
+    // The axis of dates, and the symbol of each column
+    std::vector<Date> m_dates;
+    std::vector<std::string> m_symbols;
+
+    // The matrix, column major
+    std::vector<double> m_values;
+
+    // Description of the last error
+    std::string m_lastErrorMessage;
+};
+
+#endif // PANEL_H
@@ -0,0 +1,71 @@
+/*
+ * Class: ParallelFor
+ * Author: Marc Stahl
+ * Description: Internal helper which runs a loop body over a range of indexes
+ *   using a fixed number of worker threads.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "parallelfor.h"
+
+
+// Number of threads which run() will use when maxThreads is 0
+unsigned int ParallelFor::defaultThreads()
+{
+    unsigned int numThreads = std::thread::hardware_concurrency();
+
+    // hardware_concurrency() may return 0 if it cannot tell
+    return (numThreads == 0) ? 1 : numThreads;
+}
+
+
+// Call body(index) once for every index in [0, count), spreading the calls over
+// at most maxThreads threads (0 = one per hardware thread)
+void ParallelFor::run(const unsigned long count, const std::function<void(unsigned long)> &body, const unsigned int maxThreads)
+{
+    unsigned long numThreads = (maxThreads == 0) ? defaultThreads() : maxThreads;
+    if (numThreads > count) numThreads = count;
+
+    // Nothing to spread out, so run on the calling thread
+    if (numThreads <= 1) {
+        for (unsigned long index = 0; index < count; index++) body(index);
+        return;
+    }
+
+    // Next index to be handed out to a worker, and whether to stop handing them out
+    std::atomic<unsigned long> nextIndex(0);
+    std::atomic<bool> stopped(false);
+
+    // Exception thrown on each worker (or in starting it), to be rethrown once all have finished
+    std::vector<std::exception_ptr> errors(numThreads);
+
+    // Each worker takes the next free index until all have been handed out, or one fails
+    std::vector<std::thread> workers;
+    for (unsigned long threadNum = 0; threadNum < numThreads; threadNum++) {
+        try {
+            workers.push_back(std::thread([&, threadNum]() {
+                try {
+                    for (unsigned long index = nextIndex++; (index < count) && (!stopped); index = nextIndex++) body(index);
+                } catch (...) {
+                    errors[threadNum] = std::current_exception();
+                    stopped = true;
+                }
+            }));
+        } catch (...) {
+            errors[threadNum] = std::current_exception();
+            stopped = true;
+            break;
+        }
+    }
+
+    // Wait for all workers to finish
+    for (unsigned long threadNum = 0; threadNum < workers.size(); threadNum++) workers[threadNum].join();
+
+    for (unsigned long threadNum = 0; threadNum < errors.size(); threadNum++)
+        if (errors[threadNum]) std::rethrow_exception(errors[threadNum]);
+}
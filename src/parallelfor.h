@@ -0,0 +1,31 @@
+/*
+ * Class: ParallelFor
+ * Author: Marc Stahl
+ * Description: Internal helper which runs a loop body over a range of indexes
+ *   using a fixed number of worker threads.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <functional>
+
+class ParallelFor
+{
+public:
+
+    // Call body(index) once for every index in [0, count), spreading the calls over
+    // at most maxThreads threads (0 = one per hardware thread).  Indexes are handed out
+    // one at a time, so uneven work per index is balanced between the threads.
+    // Returns once every call has completed.  If a call throws (or a thread cannot be started)
+    // no more indexes are handed out, every thread started is waited for, and the first
+    // exception is rethrown on the calling thread.
+    static void run(const unsigned long count, const std::function<void(unsigned long)> &body, const unsigned int maxThreads);
+
+    // Number of threads which run() will use when maxThreads is 0
+    static unsigned int defaultThreads();
+};
+
+#endif // PARALLELFOR_H
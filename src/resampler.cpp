@@ -0,0 +1,206 @@
+/*
+ * Class: Resampler
+ * Author: Marc Stahl
+ * Description: Builds coarser trading histories from finer ones in a single
+ *   pass over the days, on several threads across equities, keeping the results
+ *   until the days they were built from change.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include "parallelfor.h"
+#include "resampler.h"
+
+using namespace std;
+
+
+// Constructor: Create a resampler, which keeps the bars it builds if cacheResults is true
+Resampler::Resampler(const bool cacheResults) :
+    m_cacheResults(cacheResults)
+{
+}
+
+
+// Number of days from 1970-01-01 to date (negative before it), for the proleptic Gregorian calendar
+static long daysFromEpoch(const Date date)
+{
+    long year = date.Year();
+    long month = date.Month();
+
+    // Count years from March, so the leap day is the last day of the year
+    if (month <= 2) year--;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + date.day() - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+
+// The bar a trading day falls in, as a number which is the same for every day in the bar and
+// increases from one bar to the next.  periodicity is the interday letter, or minus the number of minutes
+static long long barOf(const TradingDay &tradingDay, const int periodicity)
+{
+    Date date = tradingDay.date();
+
+    switch (periodicity) {
+    case EquityInDB::EInterdayPeriodicityDaily:
+        return date.asYYYYMMDD();
+    case EquityInDB::EInterdayPeriodicityWeekly: {
+        // 1970-01-01 was a Thursday, so weeks starting on a Monday start 3 days before a multiple of 7
+        long shifted = daysFromEpoch(date) + 3;
+        return (shifted >= 0) ? shifted / 7 : -((6 - shifted) / 7);
+    }
+    case EquityInDB::EInterdayPeriodicityMonthly:
+        return date.Year() * 12LL + date.Month();
+    case EquityInDB::EInterdayPeriodicityQuarterly:
+        return date.Year() * 4LL + (date.Month() - 1) / 3;
+    case EquityInDB::EInterdayPeriodicityYearly:
+        return date.Year();
+    }
+
+    // Intraday: the period of the day the time (HHMMSS) falls in
+    long time = static_cast<long>(tradingDay.time());
+    long minuteOfDay = (time / 10000) * 60 + (time / 100) % 100;
+    return date.asYYYYMMDD() * 10000LL + minuteOfDay / -periodicity;
+}
+
+
+// Write out a bar running from first to lastDay.  Interday bars are dated the last day in them;
+// intraday bars are timed at the start of their period
+static void addBar(vector<TradingDay> &bars, const TradingDay &first, const TradingDay &lastDay, const float high, const float low,
+                   const unsigned long volume, const long long bar, const int periodicity)
+{
+    Time time = lastDay.time();
+
+    if (periodicity < 0) {
+        long minuteOfDay = static_cast<long>(bar % 10000) * -periodicity;
+        time = static_cast<Time>((minuteOfDay / 60) * 10000 + (minuteOfDay % 60) * 100);
+    }
+    bars.push_back(TradingDay(lastDay.date(), time, first.open(), lastDay.close(), high, low, volume, lastDay.openInterest()));
+}
+
+
+// Merge days into bars of the periodicity given (the interday letter, or minus the number of
+// minutes).  Return false if it is not a periodicity days can be merged into
+bool Resampler::resampleByKey(const vector<TradingDay> &days, const int periodicity, vector<TradingDay> &bars)
+{
+    bars.clear();
+    if ( (periodicity == 0) || (periodicity == EquityInDB::EInterdayPeriodicityNone) ) return false;
+    if (days.empty()) return true;
+
+    // The bar being built, written out when a day falls in the next one
+    long long bar = barOf(days[0], periodicity);
+    unsigned long first = 0;
+    float high = days[0].high();
+    float low = days[0].low();
+    unsigned long volume = days[0].volume();
+
+    for (unsigned long dayNum = 1; dayNum < days.size(); dayNum++) {
+        const TradingDay &tradingDay = days[dayNum];
+        long long dayBar = barOf(tradingDay, periodicity);
+
+        if (dayBar == bar) {
+            if (tradingDay.high() > high) high = tradingDay.high();
+            if (tradingDay.low() < low) low = tradingDay.low();
+            volume += tradingDay.volume();
+            continue;
+        }
+
+        addBar(bars, days[first], days[dayNum - 1], high, low, volume, bar, periodicity);
+        bar = dayBar;
+        first = dayNum;
+        high = tradingDay.high();
+        low = tradingDay.low();
+        volume = tradingDay.volume();
+    }
+    addBar(bars, days[first], days.back(), high, low, volume, bar, periodicity);
+    return true;
+}
+
+
+// Merge days into one bar per week, month, quarter, or year (or day).
+// Return false if periodicity is EInterdayPeriodicityNone
+bool Resampler::resample(const vector<TradingDay> &days, const EquityInDB::EInterdayPeriodicity periodicity, vector<TradingDay> &bars)
+{
+    return resampleByKey(days, periodicity, bars);
+}
+
+
+// Merge intraday bars into bars of the number of minutes given.
+// Return false if periodicity is EIntradayPeriodicityNone
+bool Resampler::resample(const vector<TradingDay> &days, const EquityInDB::EIntradayPeriodicity periodicity, vector<TradingDay> &bars)
+{
+    return resampleByKey(days, -static_cast<int>(periodicity), bars);
+}
+
+
+// Resample every equity in snapshot into bars, using the cache if on
+void Resampler::resampleAllByKey(const DBSnapshot &snapshot, const int periodicity, const unsigned int maxThreads, vector<Bars> &bars)
+{
+    bars.assign(snapshot.numEquities(), Bars());
+
+    ParallelFor::run(snapshot.numEquities(), [&](unsigned long equityNum) {
+        const DBSnapshot::EquitySnapshot &equity = snapshot.equity(equityNum);
+        pair<string, int> key(equity.symbol, periodicity);
+
+        // Use the cached bars if they were built from the same list of trading days
+        if (m_cacheResults) {
+            lock_guard<mutex> cacheLock(m_cacheMutex);
+            map<pair<string, int>, CacheEntry>::const_iterator cacheIt = m_cache.find(key);
+            if ( (cacheIt != m_cache.end()) && (cacheIt->second.source.lock() == equity.tradingDays) ) {
+                bars[equityNum] = cacheIt->second.bars;
+                return;
+            }
+        }
+
+        // Build them without holding the lock, so the equities are resampled side by side
+        shared_ptr<vector<TradingDay> > equityBars(new vector<TradingDay>);
+        resampleByKey(*equity.tradingDays, periodicity, *equityBars);
+        bars[equityNum] = equityBars;
+
+        if (m_cacheResults) {
+            lock_guard<mutex> cacheLock(m_cacheMutex);
+            CacheEntry &entry = m_cache[key];
+            entry.source = equity.tradingDays;
+            entry.bars = equityBars;
+        }
+    }, maxThreads);
+}
+
+
+// Resample the trading days of every equity in snapshot into interday bars.
+// Return false if periodicity is EInterdayPeriodicityNone
+bool Resampler::resampleAll(const DBSnapshot &snapshot, const EquityInDB::EInterdayPeriodicity periodicity,
+                            const unsigned int maxThreads, vector<Bars> &bars)
+{
+    if (periodicity == EquityInDB::EInterdayPeriodicityNone) {
+        bars.clear();
+        return false;
+    }
+    resampleAllByKey(snapshot, periodicity, maxThreads, bars);
+    return true;
+}
+
+
+// Resample the trading days of every equity in snapshot into intraday bars.
+// Return false if periodicity is EIntradayPeriodicityNone
+bool Resampler::resampleAll(const DBSnapshot &snapshot, const EquityInDB::EIntradayPeriodicity periodicity,
+                            const unsigned int maxThreads, vector<Bars> &bars)
+{
+    if (periodicity == EquityInDB::EIntradayPeriodicityNone) {
+        bars.clear();
+        return false;
+    }
+    resampleAllByKey(snapshot, -static_cast<int>(periodicity), maxThreads, bars);
+    return true;
+}
+
+
+// Forget every cached result
+void Resampler::clearCache()
+{
+    lock_guard<mutex> cacheLock(m_cacheMutex);
+
+    m_cache.clear();
+}
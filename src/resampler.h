@@ -0,0 +1,97 @@
+/*
+ * Class: Resampler
+ * Author: Marc Stahl
+ * Description: Builds coarser trading histories from finer ones: daily (or
+ *   intraday) bars into weekly, monthly, quarterly, or yearly bars, and 1 minute
+ *   bars into 5, 10, or 60 minute bars.  The days are read once, in order, each
+ *   being merged into the bar it falls in: the first open, the highest high, the
+ *   lowest low, the last close and open interest, and the total volume.
+ *
+ *   resampleAll() resamples every equity in a snapshot on several threads.  If
+ *   caching is on, the bars built for an equity are kept and handed out again
+ *   until its trading days change (a snapshot's list of trading days for an
+ *   equity is shared by later snapshots until the equity changes, so the list
+ *   itself identifies the version the bars were built from).
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dbsnapshot.h"
+#include "equityindb.h"
+#include "tradingday.h"
+
+class Resampler
+{
+public:
+
+    // Resampled trading days, shared between the cache and its callers
+    typedef std::shared_ptr<const std::vector<TradingDay> > Bars;
+
+    // Constructor: Create a resampler, which keeps the bars it builds if cacheResults is true
+    Resampler(const bool cacheResults);
+
+    // Merge days (in date order) into one bar per week (Monday to Sunday), month, quarter,
+    // or year, dated the last day in it.  Daily bars may also be built from intraday ones.
+    // Return false (with bars empty) if periodicity is EInterdayPeriodicityNone
+    static bool resample(const std::vector<TradingDay> &days, const EquityInDB::EInterdayPeriodicity periodicity,
+                         std::vector<TradingDay> &bars);
+
+    // Merge intraday bars (in date and time order, with times held as HHMMSS) into bars of the
+    // number of minutes given, each timed at the start of its period (eg: 5 minute bars at
+    // 93000, 93500, ...).  Return false (with bars empty) if periodicity is EIntradayPeriodicityNone
+    static bool resample(const std::vector<TradingDay> &days, const EquityInDB::EIntradayPeriodicity periodicity,
+                         std::vector<TradingDay> &bars);
+
+    // Resample the trading days of every equity in snapshot, using at most maxThreads threads
+    // (0 = one per hardware thread).  bars is set to the bars of each equity, in the same order
+    // as the snapshot's equities.  Return false if periodicity is EInterdayPeriodicityNone
+    bool resampleAll(const DBSnapshot &snapshot, const EquityInDB::EInterdayPeriodicity periodicity,
+                     const unsigned int maxThreads, std::vector<Bars> &bars);
+
+    // As above, for intraday bars.  Return false if periodicity is EIntradayPeriodicityNone
+    bool resampleAll(const DBSnapshot &snapshot, const EquityInDB::EIntradayPeriodicity periodicity,
+                     const unsigned int maxThreads, std::vector<Bars> &bars);
+
+    // Forget every cached result
+    void clearCache();
+
+private:
+
+    // Bars built for one equity, and the trading days they were built from
+    struct CacheEntry {
+        std::weak_ptr<const std::vector<TradingDay> > source;
+        Bars bars;
+    };
+
+    // Keep results between calls
+    bool m_cacheResults;
+
+    // Cached bars by symbol and periodicity (the interday letter, or minus the number of minutes)
+    std::map<std::pair<std::string, int>, CacheEntry> m_cache;
+
+    // Guards m_cache
+    std::mutex m_cacheMutex;
+
+    // Merge days into bars of the periodicity given (the interday letter, or minus the number
+    // of minutes).  Return false if it is not a periodicity days can be merged into
+    static bool resampleByKey(const std::vector<TradingDay> &days, const int periodicity, std::vector<TradingDay> &bars);
+
+    // Resample every equity in snapshot into bars, using the cache if on
+    void resampleAllByKey(const DBSnapshot &snapshot, const int periodicity, const unsigned int maxThreads,
+                          std::vector<Bars> &bars);
+
+    // The resampler holds a cache guarded by a mutex, so copying is not allowed
+    Resampler(const Resampler &);
+    void operator=(const Resampler &);
+};
+
+#endif // RESAMPLER_H
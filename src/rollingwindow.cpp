@@ -0,0 +1,237 @@
+/*
+ * Class: RollingWindow
+ * Author: Marc Stahl
+ * Description: Statistics over a window moved along a contiguous array, each
+ *   in a single O(n) pass whatever the length of the window.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include "parallelfor.h"
+#include "rollingwindow.h"
+
+using namespace std;
+
+
+// Fill result[0, end) with NaN, for the positions before the window is full
+template <typename T>
+static void fillNaN(T *result, const unsigned long end)
+{
+    const T notANumber = numeric_limits<T>::quiet_NaN();
+    for (unsigned long position = 0; position < end; position++) result[position] = notANumber;
+}
+
+
+// Highest (or, with less, lowest) of the last window values.  The queue holds the positions
+// of the window which could still become its extreme, oldest first, with their values in
+// order: a newer value which beats an older one means the older can never be the extreme
+// again, so it is dropped.  Each position is queued and dropped once, giving O(n) overall
+template <typename T, typename Compare>
+static void extreme(const T *values, const unsigned long count, const unsigned int window, T *result, const Compare beats)
+{
+    if ( (window == 0) || (count < window) ) {
+        fillNaN(result, count);
+        return;
+    }
+
+    // The position leaving the window is dropped before the newest is queued, so the queue never
+    // holds more than window positions and a ring of that size needs no allocation while running
+    vector<unsigned long> queue(window);
+    unsigned long head = 0;
+    unsigned long size = 0;
+
+    fillNaN(result, window - 1);
+    for (unsigned long position = 0; position < count; position++) {
+        if ( (size > 0) && (queue[head] + window <= position) ) {
+            head = (head + 1) % window;
+            size--;
+        }
+
+        while ( (size > 0) && (!beats(values[queue[(head + size - 1) % window]], values[position])) ) size--;
+        queue[(head + size) % window] = position;
+        size++;
+        if (position + 1 >= window) result[position] = values[queue[head]];
+    }
+}
+
+
+// Add value to a sum, carrying the part rounded off in compensation so it is added back next time
+template <typename Accumulator>
+static inline void compensatedAdd(Accumulator &sum, Accumulator &compensation, const Accumulator value)
+{
+    Accumulator corrected = value - compensation;
+    Accumulator newSum = sum + corrected;
+    compensation = (newSum - sum) - corrected;
+    sum = newSum;
+}
+
+
+// Mean of window values, and the sum of their squared differences from it, added one at a
+// time with Welford's method
+template <typename T, typename Accumulator>
+static void windowMoments(const T *values, const unsigned int window, Accumulator &average, Accumulator &squares)
+{
+    average = 0;
+    squares = 0;
+    for (unsigned long position = 0; position < window; position++) {
+        Accumulator value = values[position];
+        Accumulator difference = value - average;
+        average += difference / (position + 1);
+        squares += difference * (value - average);
+    }
+}
+
+
+// Mean, population standard deviation, and z-score of the last window values (each written
+// only if not NULL).  Each step replaces the oldest value with the newest, moving the mean by
+// their difference over window and the sum of squared differences from the mean by
+// (newest - oldest) * (newest - new mean + oldest - old mean).  What rounding those updates
+// leave behind is wiped out by working the window out afresh every window steps, which
+// keeps the total work O(n) (a small variance left after a large one would otherwise be lost
+// in the rounding of the large one)
+template <typename T, typename Accumulator>
+static void moments(const T *values, const unsigned long count, const unsigned int window, T *mean, T *stdDev, T *zScore)
+{
+    if ( (window == 0) || (count < window) ) {
+        if (mean) fillNaN(mean, count);
+        if (stdDev) fillNaN(stdDev, count);
+        if (zScore) fillNaN(zScore, count);
+        return;
+    }
+
+    const Accumulator scale = Accumulator(1) / window;
+    Accumulator average;
+    Accumulator averageCompensation = 0;
+    Accumulator squares;
+    Accumulator squaresCompensation = 0;
+
+    windowMoments(values, window, average, squares);
+    if (mean) fillNaN(mean, window - 1);
+    if (stdDev) fillNaN(stdDev, window - 1);
+    if (zScore) fillNaN(zScore, window - 1);
+
+    for (unsigned long position = window - 1; position < count; position++) {
+        if ( (position >= window) && ((position + 1) % window == 0) ) {
+            windowMoments(values + position + 1 - window, window, average, squares);
+            averageCompensation = 0;
+            squaresCompensation = 0;
+        } else if (position >= window) {
+            Accumulator newest = values[position];
+            Accumulator oldest = values[position - window];
+            Accumulator previousAverage = average;
+            compensatedAdd(average, averageCompensation, (newest - oldest) * scale);
+            compensatedAdd(squares, squaresCompensation, (newest - oldest) * ((newest - average) + (oldest - previousAverage)));
+        }
+
+        // Rounding can take the squares of a flat window just below zero
+        Accumulator deviation = sqrt(((squares > 0) ? squares : 0) * scale);
+        if (mean) mean[position] = static_cast<T>(average);
+        if (stdDev) stdDev[position] = static_cast<T>(deviation);
+        if (zScore) {
+            zScore[position] = (deviation > 0) ? static_cast<T>((values[position] - average) / deviation)
+                                               : numeric_limits<T>::quiet_NaN();
+        }
+    }
+}
+
+
+// Highest of the last window values
+template <typename T>
+void RollingWindow::max(const T *values, const unsigned long count, const unsigned int window, T *result)
+{
+    extreme(values, count, window, result, greater<T>());
+}
+
+
+// Lowest of the last window values
+template <typename T>
+void RollingWindow::min(const T *values, const unsigned long count, const unsigned int window, T *result)
+{
+    extreme(values, count, window, result, less<T>());
+}
+
+
+// Each value less the highest of the last window values, as a fraction of that highest value
+template <typename T>
+void RollingWindow::drawdown(const T *values, const unsigned long count, const unsigned int window, T *result)
+{
+    extreme(values, count, window, result, greater<T>());
+    for (unsigned long position = 0; position < count; position++) result[position] = values[position] / result[position] - 1;
+}
+
+
+// Mean of the last window values
+template <typename T, typename Accumulator>
+void RollingWindow::mean(const T *values, const unsigned long count, const unsigned int window, T *result)
+{
+    moments<T, Accumulator>(values, count, window, result, NULL, NULL);
+}
+
+
+// Mean and population standard deviation of the last window values
+template <typename T, typename Accumulator>
+void RollingWindow::meanStdDev(const T *values, const unsigned long count, const unsigned int window, T *mean, T *stdDev)
+{
+    moments<T, Accumulator>(values, count, window, mean, stdDev, NULL);
+}
+
+
+// Each value less the mean of the last window values, in standard deviations
+template <typename T, typename Accumulator>
+void RollingWindow::zScore(const T *values, const unsigned long count, const unsigned int window, T *result)
+{
+    moments<T, Accumulator>(values, count, window, NULL, NULL, result);
+}
+
+
+// Work out statistic over field of the trading days of every equity in snapshot, in parallel
+void RollingWindow::computeAll(const DBSnapshot &snapshot, const Indicators::EFields field, const EStatistics statistic,
+                               const unsigned int window, const unsigned int maxThreads, vector<vector<double> > &results)
+{
+    results.assign(snapshot.numEquities(), vector<double>());
+
+    ParallelFor::run(snapshot.numEquities(), [&](unsigned long equityNum) {
+        const DBSnapshot::EquitySnapshot &equity = snapshot.equity(equityNum);
+        vector<double> &result = results[equityNum];
+        vector<double> values;
+
+        if (!equity.tradingDays) return;
+        Indicators::column(*equity.tradingDays, field, values);
+        result.resize(values.size());
+        if (values.empty()) return;
+
+        switch (statistic) {
+        case EStatisticMax: max(values.data(), values.size(), window, result.data()); break;
+        case EStatisticMin: min(values.data(), values.size(), window, result.data()); break;
+        case EStatisticMean: mean(values.data(), values.size(), window, result.data()); break;
+        case EStatisticStdDev: moments<double, double>(values.data(), values.size(), window, NULL, result.data(), NULL); break;
+        case EStatisticZScore: zScore(values.data(), values.size(), window, result.data()); break;
+        case EStatisticDrawdown: drawdown(values.data(), values.size(), window, result.data()); break;
+        }
+    }, maxThreads);
+}
+
+
+// The versions provided: float and double values, with the mean based kernels accumulating
+// float values in float or double, and double values in double
+template void RollingWindow::max<float>(const float *, const unsigned long, const unsigned int, float *);
+template void RollingWindow::max<double>(const double *, const unsigned long, const unsigned int, double *);
+template void RollingWindow::min<float>(const float *, const unsigned long, const unsigned int, float *);
+template void RollingWindow::min<double>(const double *, const unsigned long, const unsigned int, double *);
+template void RollingWindow::drawdown<float>(const float *, const unsigned long, const unsigned int, float *);
+template void RollingWindow::drawdown<double>(const double *, const unsigned long, const unsigned int, double *);
+
+#define ROLLINGWINDOW_INSTANTIATE(T, Accumulator)                                                                       \
+    template void RollingWindow::mean<T, Accumulator>(const T *, const unsigned long, const unsigned int, T *);         \
+    template void RollingWindow::meanStdDev<T, Accumulator>(const T *, const unsigned long, const unsigned int,         \
+                                                            T *, T *);                                                  \
+    template void RollingWindow::zScore<T, Accumulator>(const T *, const unsigned long, const unsigned int, T *);
+
+ROLLINGWINDOW_INSTANTIATE(float, float)
+ROLLINGWINDOW_INSTANTIATE(float, double)
+ROLLINGWINDOW_INSTANTIATE(double, double)
+
+#undef ROLLINGWINDOW_INSTANTIATE
@@ -0,0 +1,77 @@
+/*
+ * Class: RollingWindow
+ * Author: Marc Stahl
+ * Description: Statistics over a window of the last so many values, moved along
+ *   a contiguous array one position at a time (eg: the highest high of the last
+ *   20 days for a Donchian channel, or the z-score of the close over the last
+ *   252 days).  Every kernel runs in O(n) however long the window is: the
+ *   highest and lowest values are kept in a monotonic queue of positions, from
+ *   which each position is added and removed once, and the mean and variance are
+ *   updated for the value entering and the value leaving the window (Welford's
+ *   method), with compensated (Kahan) sums, and worked out afresh once every
+ *   window positions so rounding cannot build up over millions of positions.
+ *   Results for positions before the window is full are NaN, and the values must
+ *   not hold NaN.
+ *
+ *   Like Indicators, the mean based kernels are templates over the type of the
+ *   values (T) and the type they are accumulated in (Accumulator), provided for
+ *   float/float, float/double, and double/double.  computeAll() runs a kernel
+ *   over one field of every equity in a snapshot on several threads.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef ROLLINGWINDOW_H
+#define ROLLINGWINDOW_H
+
+#include <vector>
+#include "dbsnapshot.h"
+#include "indicators.h"
+
+class RollingWindow
+{
+public:
+
+    // Statistic computeAll() works out
+    enum EStatistics {
+        EStatisticMax,       // Highest value in the window
+        EStatisticMin,       // Lowest value in the window
+        EStatisticMean,      // Mean of the window
+        EStatisticStdDev,    // Population standard deviation of the window
+        EStatisticZScore,    // Number of standard deviations the newest value is from the window's mean
+        EStatisticDrawdown   // Fraction the newest value is below the highest in the window (0 to -1)
+    };
+
+    // Highest of the last window values
+    template <typename T>
+    static void max(const T *values, const unsigned long count, const unsigned int window, T *result);
+
+    // Lowest of the last window values
+    template <typename T>
+    static void min(const T *values, const unsigned long count, const unsigned int window, T *result);
+
+    // Each value less the highest of the last window values, as a fraction of that highest value
+    template <typename T>
+    static void drawdown(const T *values, const unsigned long count, const unsigned int window, T *result);
+
+    // Mean of the last window values
+    template <typename T, typename Accumulator = double>
+    static void mean(const T *values, const unsigned long count, const unsigned int window, T *result);
+
+    // Mean and population standard deviation (as Indicators::bollinger() uses) of the last window values
+    template <typename T, typename Accumulator = double>
+    static void meanStdDev(const T *values, const unsigned long count, const unsigned int window, T *mean, T *stdDev);
+
+    // Each value less the mean of the last window values, in standard deviations.  NaN where
+    // the window's values are all the same
+    template <typename T, typename Accumulator = double>
+    static void zScore(const T *values, const unsigned long count, const unsigned int window, T *result);
+
+    // Work out statistic over field of the trading days of every equity in snapshot, using at most
+    // maxThreads threads (0 = one per hardware thread).  results is set to one value per trading
+    // day of each equity, in the same order as the snapshot's equities
+    static void computeAll(const DBSnapshot &snapshot, const Indicators::EFields field, const EStatistics statistic,
+                           const unsigned int window, const unsigned int maxThreads, std::vector<std::vector<double> > &results);
+};
+
+#endif // ROLLINGWINDOW_H
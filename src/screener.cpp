@@ -0,0 +1,188 @@
+/*
+ * Class: Screener
+ * Author: Marc Stahl
+ * Description: Finds the equities in a snapshot which meet some condition on
+ *   their most recent trading days, screening them on several threads at once.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <algorithm>
+#include "parallelfor.h"
+#include "screener.h"
+
+using namespace std;
+
+
+// Constructor: Create a condition of the type given
+Screener::Condition::Condition(const EConditionTypes conditionType, const unsigned int conditionPeriod, const double conditionLevel) :
+    type(conditionType),
+    period(conditionPeriod),
+    level(conditionLevel)
+{
+}
+
+
+// Number of trading days evaluate() reads to test condition
+unsigned long Screener::windowDays(const Condition &condition)
+{
+    switch (condition.type) {
+    case EConditionCloseAboveSMA:
+    case EConditionCloseBelowSMA:
+    case EConditionNewHigh:
+    case EConditionNewLow:
+        return condition.period;
+    case EConditionCloseCrossedAboveSMA:
+    case EConditionCloseCrossedBelowSMA:
+    case EConditionVolumeAboveAverage:
+    case EConditionChangeAbove:
+    case EConditionChangeBelow:
+        return condition.period + 1;
+    }
+    return condition.period;
+}
+
+
+// Average close of the period days ending at end (exclusive)
+static double averageClose(const TradingDay *days, const unsigned long end, const unsigned int period)
+{
+    double sum = 0;
+
+    for (unsigned long dayNum = end - period; dayNum < end; dayNum++) sum += days[dayNum].close();
+    return sum / period;
+}
+
+
+// True if the last of the days given (oldest first) meets condition.  False if there are too few days to tell
+bool Screener::evaluate(const Condition &condition, const TradingDay *days, const unsigned long numDays)
+{
+    if ( (condition.period == 0) || (numDays < windowDays(condition)) ) return false;
+
+    const TradingDay &lastDay = days[numDays - 1];
+
+    switch (condition.type) {
+    case EConditionCloseCrossedAboveSMA:
+        return ( (lastDay.close() > averageClose(days, numDays, condition.period)) &&
+                 (days[numDays - 2].close() <= averageClose(days, numDays - 1, condition.period)) );
+
+    case EConditionCloseCrossedBelowSMA:
+        return ( (lastDay.close() < averageClose(days, numDays, condition.period)) &&
+                 (days[numDays - 2].close() >= averageClose(days, numDays - 1, condition.period)) );
+
+    case EConditionCloseAboveSMA:
+        return (lastDay.close() > averageClose(days, numDays, condition.period));
+
+    case EConditionCloseBelowSMA:
+        return (lastDay.close() < averageClose(days, numDays, condition.period));
+
+    case EConditionNewHigh:
+        for (unsigned long dayNum = numDays - condition.period; dayNum < numDays - 1; dayNum++) {
+            if (days[dayNum].high() > lastDay.high()) return false;
+        }
+        return true;
+
+    case EConditionNewLow:
+        for (unsigned long dayNum = numDays - condition.period; dayNum < numDays - 1; dayNum++) {
+            if (days[dayNum].low() < lastDay.low()) return false;
+        }
+        return true;
+
+    case EConditionVolumeAboveAverage: {
+        double sum = 0;
+        for (unsigned long dayNum = numDays - 1 - condition.period; dayNum < numDays - 1; dayNum++) sum += days[dayNum].volume();
+        return (lastDay.volume() > condition.level * sum / condition.period);
+    }
+
+    case EConditionChangeAbove:
+    case EConditionChangeBelow: {
+        double before = days[numDays - 1 - condition.period].close();
+        if (before == 0) return false;
+        double change = (lastDay.close() - before) * 100.0 / before;
+        return (condition.type == EConditionChangeAbove) ? (change > condition.level) : (change < condition.level);
+    }
+    }
+    return false;
+}
+
+
+// List every equity in snapshot for which predicate returns true, passing it the last windowDays trading days
+void Screener::screen(const DBSnapshot &snapshot, const unsigned long windowDays, const Predicate &predicate,
+                      const unsigned int maxThreads, vector<string> &symbols)
+{
+    // One flag per equity, so the threads never write to the same place
+    vector<char> matched(snapshot.numEquities(), 0);
+
+    ParallelFor::run(snapshot.numEquities(), [&](unsigned long equityNum) {
+        const DBSnapshot::EquitySnapshot &equity = snapshot.equity(equityNum);
+        const vector<TradingDay> &days = *equity.tradingDays;
+
+        // Only the tail of the list is looked at, in place
+        unsigned long numDays = (days.size() < windowDays) ? days.size() : windowDays;
+        const TradingDay *window = days.empty() ? NULL : &days[days.size() - numDays];
+        matched[equityNum] = predicate(equity.symbol, window, numDays) ? 1 : 0;
+    }, maxThreads);
+
+    symbols.clear();
+    for (unsigned long equityNum = 0; equityNum < matched.size(); equityNum++) {
+        if (matched[equityNum]) symbols.push_back(snapshot.equity(equityNum).symbol);
+    }
+}
+
+
+// List every equity in snapshot meeting all the conditions given
+void Screener::screen(const DBSnapshot &snapshot, const vector<Condition> &conditions, const unsigned int maxThreads,
+                      vector<string> &symbols)
+{
+    unsigned long window = 0;
+
+    for (unsigned long conditionNum = 0; conditionNum < conditions.size(); conditionNum++) {
+        if (windowDays(conditions[conditionNum]) > window) window = windowDays(conditions[conditionNum]);
+    }
+
+    screen(snapshot, window, [&](const string &, const TradingDay *days, const unsigned long numDays) {
+        for (unsigned long conditionNum = 0; conditionNum < conditions.size(); conditionNum++) {
+            if (!evaluate(conditions[conditionNum], days, numDays)) return false;
+        }
+        return true;
+    }, maxThreads, symbols);
+}
+
+
+// Order a trading day before a date, as YYYYMMDD
+static bool dayBeforeDate(const TradingDay &tradingDay, const unsigned long date)
+{
+    return (tradingDay.date().asYYYYMMDD() < date);
+}
+
+
+// List every equity in snapshot with a trading day, from firstDate on, whose field lies between
+// minValue and maxValue.  An equity without a zone map (eg: in a snapshot built by hand) has one
+// built for it
+void Screener::screenRange(const DBSnapshot &snapshot, const Indicators::EFields field, const double minValue,
+                           const double maxValue, const Date firstDate, const unsigned int maxThreads, vector<string> &symbols)
+{
+    vector<char> matched(snapshot.numEquities(), 0);
+
+    ParallelFor::run(snapshot.numEquities(), [&](unsigned long equityNum) {
+        const DBSnapshot::EquitySnapshot &equity = snapshot.equity(equityNum);
+        if ( (!equity.tradingDays) || (equity.tradingDays->empty()) ) return;
+        const vector<TradingDay> &days = *equity.tradingDays;
+
+        ZoneMap builtZoneMap;
+        const ZoneMap *zoneMap = equity.zoneMap.get();
+        if ( (zoneMap == NULL) || (zoneMap->summary().count != days.size()) ) {
+            builtZoneMap.update(days, 0, false);
+            zoneMap = &builtZoneMap;
+        }
+
+        unsigned long firstDay = 0;
+        if (firstDate.isValid()) firstDay = lower_bound(days.begin(), days.end(), firstDate.asYYYYMMDD(), dayBeforeDate) - days.begin();
+        unsigned long position;
+        matched[equityNum] = zoneMap->findFirst(days, field, minValue, maxValue, firstDay, position) ? 1 : 0;
+    }, maxThreads);
+
+    symbols.clear();
+    for (unsigned long equityNum = 0; equityNum < matched.size(); equityNum++) {
+        if (matched[equityNum]) symbols.push_back(snapshot.equity(equityNum).symbol);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Class: Screener
+ * Author: Marc Stahl
+ * Description: Finds the equities in a snapshot which meet some condition on
+ *   their most recent trading days (eg: the close crossed above its 50 day
+ *   average on the last day).  The equities are screened on several threads at
+ *   once, straight from the snapshot's lists of trading days, and only the last
+ *   few days each condition needs are read.  The condition is either a function
+ *   given by the caller, or a list of built in conditions which must all hold.
+ *   screenRange() instead looks for a value in a range anywhere in each equity's
+ *   days, using its zone map to skip the equities and zones which cannot match.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef SCREENER_H
+#define SCREENER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "date.h"
+#include "dbsnapshot.h"
+#include "indicators.h"
+#include "tradingday.h"
+
+class Screener
+{
+public:
+
+    // Built in conditions, each tested on the last trading day held
+    enum EConditionTypes {
+        EConditionCloseCrossedAboveSMA,  // Close above its period day average, having been at or below it the day before
+        EConditionCloseCrossedBelowSMA,  // Close below its period day average, having been at or above it the day before
+        EConditionCloseAboveSMA,         // Close above its period day average
+        EConditionCloseBelowSMA,         // Close below its period day average
+        EConditionNewHigh,               // High is the highest of the last period days
+        EConditionNewLow,                // Low is the lowest of the last period days
+        EConditionVolumeAboveAverage,    // Volume is more than level times the average of the period days before
+        EConditionChangeAbove,           // Close has changed by more than level percent over period days
+        EConditionChangeBelow            // Close has changed by less than level percent over period days
+    };
+
+    // A built in condition, with its number of days and level (where used)
+    struct Condition {
+        EConditionTypes type;
+        unsigned int period;
+        double level;
+
+        // Constructor: Create a condition of the type given
+        Condition(const EConditionTypes conditionType, const unsigned int conditionPeriod, const double conditionLevel = 0);
+    };
+
+    // A condition given by the caller: passed the symbol and its last days (fewer if it has fewer),
+    // oldest first.  Returns true if the equity should be listed.  Called from several threads at once
+    typedef std::function<bool(const std::string &symbol, const TradingDay *days, const unsigned long numDays)> Predicate;
+
+    // List in symbols (in symbol order) every equity in snapshot for which predicate returns true,
+    // passing it the last windowDays trading days.  Uses at most maxThreads threads (0 = one per
+    // hardware thread)
+    static void screen(const DBSnapshot &snapshot, const unsigned long windowDays, const Predicate &predicate,
+                       const unsigned int maxThreads, std::vector<std::string> &symbols);
+
+    // List in symbols (in symbol order) every equity in snapshot meeting all the conditions given.
+    // Uses at most maxThreads threads (0 = one per hardware thread)
+    static void screen(const DBSnapshot &snapshot, const std::vector<Condition> &conditions, const unsigned int maxThreads,
+                       std::vector<std::string> &symbols);
+
+    // List in symbols (in symbol order) every equity in snapshot with a trading day, from firstDate
+    // on (Date() for every day), whose field lies between minValue and maxValue (inclusive).  An
+    // equity whose zone map summary rules it out is skipped without reading its days, and only the
+    // zones of the others which could hold such a day are read.  Uses at most maxThreads threads
+    // (0 = one per hardware thread)
+    static void screenRange(const DBSnapshot &snapshot, const Indicators::EFields field, const double minValue,
+                            const double maxValue, const Date firstDate, const unsigned int maxThreads,
+                            std::vector<std::string> &symbols);
+
+    // True if the last of the days given (oldest first) meets condition.  False if there are too few
+    // days to tell
+    static bool evaluate(const Condition &condition, const TradingDay *days, const unsigned long numDays);
+
+    // Number of trading days evaluate() reads to test condition
+    static unsigned long windowDays(const Condition &condition);
+};
+
+#endif // SCREENER_H
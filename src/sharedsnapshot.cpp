@@ -0,0 +1,460 @@
+/*
+ * Class: SharedSnapshot
+ * Author: Marc Stahl
+ * Description: Publishes a decoded DBSnapshot into a POSIX shared memory segment
+ *   (or a memory mapped file), and attaches to one read only.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedsnapshot.h"
+
+using namespace std;
+
+// Identifies the shared layout, and its version
+#define SHAREDSNAPSHOT_MAGIC            "MSDBSNAP"
+#define SHAREDSNAPSHOT_LAYOUT_VERSION   1
+
+// Identifies the link segment giving the generation of a snapshot published to shared memory
+#define SHAREDSNAPSHOT_LINK_MAGIC       "MSDBLINK"
+
+
+// Constructor: Create an object not attached to any snapshot
+SharedSnapshot::SharedSnapshot() :
+    m_base(NULL),
+    m_size(0),
+    m_header(NULL),
+    m_equities(NULL),
+    m_bars(NULL)
+{
+}
+
+
+// Destructor: Detach from the snapshot, if attached
+SharedSnapshot::~SharedSnapshot()
+{
+    detach();
+}
+
+
+// True if name refers to a shared memory segment rather than a file
+bool SharedSnapshot::isSegmentName(const string &name)
+{
+    return ( (!name.empty()) && (name[0] == '/') && (name.find('/', 1) == string::npos) );
+}
+
+
+// Copy a string into a fixed size null terminated field, cutting it short if needed
+void SharedSnapshot::copyField(char *field, const size_t fieldSize, const string &value)
+{
+    memset(field, 0, fieldSize);
+    memcpy(field, value.c_str(), (value.size() < fieldSize) ? value.size() : fieldSize - 1);
+}
+
+
+// Name of the segment holding generation of the snapshot published under name
+string SharedSnapshot::generationName(const string &name, const uint64_t generation)
+{
+    char suffix[24];
+
+    snprintf(suffix, sizeof(suffix), ".%llu", static_cast<unsigned long long>(generation));
+    return name + suffix;
+}
+
+
+// Map the link segment called name read / write, creating it if needed.
+// Return NULL (with the reason in errorMessage) if it cannot be, or is not a link
+SharedSnapshot::Link * SharedSnapshot::openLink(const string &name, string &errorMessage)
+{
+    struct stat info;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        errorMessage = "Failed to create '" + name + "': " + strerror(errno);
+        return NULL;
+    }
+
+    // A new segment is empty until sized; ftruncate zeroes it, so the generation starts at 0
+    if ( (fstat(fd, &info) != 0) ||
+         ( (info.st_size == 0) && (ftruncate(fd, sizeof(Link)) != 0) ) ) {
+        errorMessage = "Failed to size '" + name + "': " + strerror(errno);
+        close(fd);
+        return NULL;
+    }
+    if ( (info.st_size != 0) && (static_cast<size_t>(info.st_size) != sizeof(Link)) ) {
+        errorMessage = "'" + name + "' is not a snapshot link";
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, sizeof(Link), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errorMessage = "Failed to map '" + name + "': " + strerror(errno);
+        return NULL;
+    }
+
+    Link *link = static_cast<Link *>(mapping);
+    static const char noMagic[sizeof(link->magic)] = {0};
+    if (memcmp(link->magic, noMagic, sizeof(link->magic)) == 0) memcpy(link->magic, SHAREDSNAPSHOT_LINK_MAGIC, sizeof(link->magic));
+    if (memcmp(link->magic, SHAREDSNAPSHOT_LINK_MAGIC, sizeof(link->magic)) != 0) {
+        errorMessage = "'" + name + "' is not a snapshot link";
+        munmap(mapping, sizeof(Link));
+        return NULL;
+    }
+    return link;
+}
+
+
+// Read the generation of the snapshot published under the segment name (0 if none yet).
+// Return true if success, otherwise false with the reason in errorMessage
+bool SharedSnapshot::readGeneration(const string &name, uint64_t &generation, string &errorMessage)
+{
+    struct stat info;
+
+    generation = 0;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        errorMessage = "Failed to open '" + name + "': " + strerror(errno);
+        return false;
+    }
+
+    if (fstat(fd, &info) != 0) {
+        errorMessage = "Failed to read '" + name + "': " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // Just created by a publisher and not yet sized, so nothing is published yet
+    if (info.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    if (static_cast<size_t>(info.st_size) != sizeof(Link)) {
+        errorMessage = "'" + name + "' is not a snapshot link";
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, sizeof(Link), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errorMessage = "Failed to map '" + name + "': " + strerror(errno);
+        return false;
+    }
+
+    // A publisher writes the magic before the first generation, so a link without it has none yet
+    const Link *link = static_cast<const Link *>(mapping);
+    if (memcmp(link->magic, SHAREDSNAPSHOT_LINK_MAGIC, sizeof(link->magic)) == 0) generation = link->generation.load(memory_order_acquire);
+    munmap(mapping, sizeof(Link));
+    return true;
+}
+
+
+// Write the snapshot given to the shared memory segment or file called name.
+// Return true if success, otherwise false with the reason in errorMessage
+bool SharedSnapshot::publish(const DBSnapshot &snapshot, const string name, string &errorMessage)
+{
+    bool isSegment = isSegmentName(name);
+    Link *link = NULL;
+    uint64_t generation = 0;
+    string targetName;
+    uint64_t numBars = 0;
+    int fd;
+
+    errorMessage = "";
+
+    // Work out where each table starts.  Both tables are 8 byte aligned, as every record is a multiple of 8 bytes
+    for (unsigned long equityNum = 0; equityNum < snapshot.numEquities(); equityNum++)
+        numBars += snapshot.equity(equityNum).tradingDays->size();
+    uint64_t equityTableOffset = sizeof(Header);
+    uint64_t barTableOffset = equityTableOffset + snapshot.numEquities() * sizeof(EquityRecord);
+    uint64_t totalSize = barTableOffset + numBars * sizeof(Bar);
+
+    // A segment is written under the next generation's name, so processes attaching meanwhile still
+    // find the current one whole.  A segment of that generation can only be left by a publish which
+    // failed part way, and nothing points at it
+    if (isSegment) {
+        link = openLink(name, errorMessage);
+        if (link == NULL) return false;
+        generation = link->generation.load(memory_order_acquire) + 1;
+        targetName = generationName(name, generation);
+        shm_unlink(targetName.c_str());
+        fd = shm_open(targetName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    } else {
+        targetName = name + ".tmp";
+        fd = open(targetName.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        errorMessage = "Failed to create '" + targetName + "': " + strerror(errno);
+        if (link != NULL) munmap(link, sizeof(Link));
+        return false;
+    }
+
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, totalSize) != 0) {
+        errorMessage = "Failed to size '" + targetName + "': " + strerror(errno);
+    } else {
+        mapping = mmap(NULL, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) errorMessage = "Failed to map '" + targetName + "': " + strerror(errno);
+    }
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        if (isSegment) shm_unlink(targetName.c_str());
+        else unlink(targetName.c_str());
+        if (link != NULL) munmap(link, sizeof(Link));
+        return false;
+    }
+
+    unsigned char *base = static_cast<unsigned char *>(mapping);
+    Header *header = reinterpret_cast<Header *>(base);
+    EquityRecord *equityRecord = reinterpret_cast<EquityRecord *>(base + equityTableOffset);
+    Bar *bar = reinterpret_cast<Bar *>(base + barTableOffset);
+    uint64_t barNum = 0;
+
+    // Fill in the equity and bar tables (ftruncate has already zeroed everything)
+    for (unsigned long equityNum = 0; equityNum < snapshot.numEquities(); equityNum++, equityRecord++) {
+        const DBSnapshot::EquitySnapshot &equity = snapshot.equity(equityNum);
+        const vector<TradingDay> &tradingDays = *equity.tradingDays;
+
+        copyField(equityRecord->symbol, ESymbolSize, equity.symbol);
+        copyField(equityRecord->description, EDescriptionSize, equity.description);
+        equityRecord->activeFieldsBitmask = equity.activeFields.bitMask();
+        equityRecord->firstDate = equity.firstDate.asYYYYMMDD();
+        equityRecord->lastDate = equity.lastDate.asYYYYMMDD();
+        equityRecord->firstBar = barNum;
+        equityRecord->numBars = tradingDays.size();
+
+        for (unsigned long dayNum = 0; dayNum < tradingDays.size(); dayNum++, bar++, barNum++) {
+            bar->date = tradingDays[dayNum].date().asYYYYMMDD();
+            bar->time = tradingDays[dayNum].time();
+            bar->open = tradingDays[dayNum].open();
+            bar->high = tradingDays[dayNum].high();
+            bar->low = tradingDays[dayNum].low();
+            bar->close = tradingDays[dayNum].close();
+            bar->openInterest = tradingDays[dayNum].openInterest();
+            bar->volume = tradingDays[dayNum].volume();
+        }
+    }
+
+    // Fill in the header, marking it complete only once everything else is visible
+    memcpy(header->magic, SHAREDSNAPSHOT_MAGIC, sizeof(header->magic));
+    header->layoutVersion = SHAREDSNAPSHOT_LAYOUT_VERSION;
+    header->snapshotVersion = snapshot.version();
+    header->numEquities = snapshot.numEquities();
+    header->equityTableOffset = equityTableOffset;
+    header->barTableOffset = barTableOffset;
+    header->totalSize = totalSize;
+    atomic_thread_fence(memory_order_release);
+    header->complete = 1;
+
+    bool success = true;
+    if (isSegment) {
+        // Point the link at the new generation, and only then remove the one it replaces.
+        // Processes still attached to that keep their mapping of it
+        link->generation.store(generation, memory_order_release);
+        if (generation > 1) shm_unlink(generationName(name, generation - 1).c_str());
+        munmap(link, sizeof(Link));
+    } else {
+        // A file must reach the disk before it replaces the previous one
+        if ( (msync(mapping, totalSize, MS_SYNC) != 0) || (rename(targetName.c_str(), name.c_str()) != 0) ) {
+            errorMessage = "Failed to write '" + name + "': " + strerror(errno);
+            unlink(targetName.c_str());
+            success = false;
+        }
+    }
+
+    munmap(mapping, totalSize);
+    close(fd);
+    return success;
+}
+
+
+// Open the segment or file holding the snapshot published under name, read only.  For a segment
+// the link is read first; if the generation it gives is unlinked before it can be opened, a newer
+// one has been published, so the link is read again.
+// Return the descriptor, or -1 (with the reason in errorMessage) on failure
+int SharedSnapshot::openPublished(const string &name, string &errorMessage)
+{
+    if (!isSegmentName(name)) {
+        int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) errorMessage = "Failed to open '" + name + "': " + strerror(errno);
+        return fd;
+    }
+
+    uint64_t previousGeneration = 0;
+    while (true) {
+        uint64_t generation;
+        if (!readGeneration(name, generation, errorMessage)) return -1;
+        if (generation == 0) {
+            errorMessage = "No snapshot has been published to '" + name + "'";
+            return -1;
+        }
+
+        string segmentName = generationName(name, generation);
+        int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+        if (fd >= 0) return fd;
+
+        // Retry only while the link keeps moving on; otherwise the segment is really missing
+        if ( (errno != ENOENT) || (generation == previousGeneration) ) {
+            errorMessage = "Failed to open '" + segmentName + "': " + strerror(errno);
+            return -1;
+        }
+        previousGeneration = generation;
+    }
+}
+
+
+// Map the snapshot published under name read only.
+// Return true if success, otherwise false with the reason in errorMessage
+bool SharedSnapshot::attach(const string name, string &errorMessage)
+{
+    struct stat info;
+
+    detach();
+    errorMessage = "";
+
+    int fd = openPublished(name, errorMessage);
+    if (fd < 0) return false;
+
+    if ( (fstat(fd, &info) != 0) || (static_cast<size_t>(info.st_size) < sizeof(Header)) ) {
+        errorMessage = "'" + name + "' is too small to hold a snapshot";
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errorMessage = "Failed to map '" + name + "': " + strerror(errno);
+        return false;
+    }
+
+    m_base = static_cast<const unsigned char *>(mapping);
+    m_size = info.st_size;
+    m_header = reinterpret_cast<const Header *>(m_base);
+
+    // Check the layout is one we understand, that it was completely written, and that nothing
+    // in it points outside the mapping
+    if ( (memcmp(m_header->magic, SHAREDSNAPSHOT_MAGIC, sizeof(m_header->magic)) != 0) ||
+         (m_header->layoutVersion != SHAREDSNAPSHOT_LAYOUT_VERSION) ||
+         (m_header->complete != 1) ) {
+        errorMessage = "'" + name + "' does not hold a complete snapshot";
+        detach();
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    if (!layoutValid()) {
+        errorMessage = "'" + name + "' holds a truncated or corrupt snapshot";
+        detach();
+        return false;
+    }
+
+    m_equities = reinterpret_cast<const EquityRecord *>(m_base + m_header->equityTableOffset);
+    m_bars = reinterpret_cast<const Bar *>(m_base + m_header->barTableOffset);
+    return true;
+}
+
+
+// True if the header, tables and every equity's bars lie within the m_size bytes mapped.
+// Each comparison is arranged so that no sum can overflow
+bool SharedSnapshot::layoutValid() const
+{
+    uint64_t totalSize = m_header->totalSize;
+    uint64_t equityTableOffset = m_header->equityTableOffset;
+    uint64_t barTableOffset = m_header->barTableOffset;
+
+    // The tables follow the header, in order, 8 byte aligned, within the layout, within the mapping
+    if ( (totalSize > m_size) ||
+         (equityTableOffset < sizeof(Header)) || (equityTableOffset % 8 != 0) || (barTableOffset % 8 != 0) ||
+         (equityTableOffset > barTableOffset) || (barTableOffset > totalSize) ||
+         (m_header->numEquities > (barTableOffset - equityTableOffset) / sizeof(EquityRecord)) ) return false;
+
+    const EquityRecord *equities = reinterpret_cast<const EquityRecord *>(m_base + equityTableOffset);
+    uint64_t numBars = (totalSize - barTableOffset) / sizeof(Bar);
+
+    for (uint64_t equityNum = 0; equityNum < m_header->numEquities; equityNum++) {
+        const EquityRecord &equity = equities[equityNum];
+        if ( (equity.symbol[ESymbolSize - 1] != '\0') || (equity.description[EDescriptionSize - 1] != '\0') ||
+             (equity.firstBar > numBars) || (equity.numBars > numBars - equity.firstBar) ) return false;
+    }
+    return true;
+}
+
+
+// Unmap the attached snapshot
+void SharedSnapshot::detach()
+{
+    if (m_base != NULL) munmap(const_cast<unsigned char *>(m_base), m_size);
+    m_base = NULL;
+    m_size = 0;
+    m_header = NULL;
+    m_equities = NULL;
+    m_bars = NULL;
+}
+
+
+// True if a snapshot is attached
+bool SharedSnapshot::isAttached() const
+{
+    return (m_equities != NULL);
+}
+
+
+// Version of the DBSnapshot which was published
+unsigned long SharedSnapshot::version() const
+{
+    return isAttached() ? m_header->snapshotVersion : 0;
+}
+
+
+// Number of equities in the attached snapshot
+unsigned long SharedSnapshot::numEquities() const
+{
+    return isAttached() ? m_header->numEquities : 0;
+}
+
+
+// Get the equity at the given position, in symbol order
+const SharedSnapshot::EquityRecord & SharedSnapshot::equity(const unsigned long equityNum) const
+{
+    return m_equities[equityNum];
+}
+
+
+// Find the equity with the symbol specified, by binary search of the sorted equity table.
+// Return true and set equityNum if found, false otherwise
+bool SharedSnapshot::find(const string symbol, unsigned long &equityNum) const
+{
+    unsigned long low = 0;
+    unsigned long high = numEquities();
+
+    while (low < high) {
+        unsigned long middle = low + (high - low) / 2;
+        int comparison = strncmp(m_equities[middle].symbol, symbol.c_str(), ESymbolSize);
+        if (comparison == 0) {
+            equityNum = middle;
+            return true;
+        }
+        if (comparison < 0) low = middle + 1;
+        else high = middle;
+    }
+    return false;
+}
+
+
+// Return the bars of the equity at the given position, in date order
+const SharedSnapshot::Bar * SharedSnapshot::bars(const unsigned long equityNum) const
+{
+    return m_bars + m_equities[equityNum].firstBar;
+}
@@ -0,0 +1,165 @@
+/*
+ * Class: SharedSnapshot
+ * Author: Marc Stahl
+ * Description: Publishes a decoded DBSnapshot into a POSIX shared memory segment
+ *   (or a memory mapped file), and attaches to one read only.  The layout uses
+ *   offsets rather than pointers, so every process can map it at any address and
+ *   read the trading days in place without parsing any MetaStock files.
+ *
+ *   A snapshot published to shared memory is written to a new segment for each
+ *   version (the name followed by '.' and a generation number), and a small
+ *   segment under the name itself then switched to point at it, so processes
+ *   attaching while a snapshot is replaced see either the old or the new one.
+ *   Everything in a layout is checked against the size of the mapping when
+ *   attached, so a truncated or corrupt snapshot is refused rather than read.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef SHAREDSNAPSHOT_H
+#define SHAREDSNAPSHOT_H
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "dbsnapshot.h"
+
+class SharedSnapshot
+{
+public:
+
+    // Size of the fixed length text fields (including the null terminator)
+    enum EFieldSizes {
+        ESymbolSize = 16,
+        EDescriptionSize = 24
+    };
+
+    // One equity in the shared layout
+    struct EquityRecord {
+        char symbol[ESymbolSize];            // Null terminated symbol
+        char description[EDescriptionSize];  // Null terminated description
+        uint8_t activeFieldsBitmask;         // Which fields in the bars hold data (see ActiveFields)
+        uint8_t reserved[7];                 // Unused, always 0
+        uint32_t firstDate;                  // Date of first trading day as YYYYMMDD
+        uint32_t lastDate;                   // Date of last trading day as YYYYMMDD
+        uint64_t firstBar;                   // Index of this equity's first bar in the bar table
+        uint64_t numBars;                    // Number of bars held for this equity
+    };
+
+    // One trading day in the shared layout
+    struct Bar {
+        uint32_t date;                       // Date as YYYYMMDD
+        float time;
+        float open;
+        float high;
+        float low;
+        float close;
+        float openInterest;
+        uint32_t reserved;                   // Unused, always 0
+        uint64_t volume;
+    };
+
+    // Constructor: Create an object not attached to any snapshot
+    SharedSnapshot();
+
+    // Destructor: Detach from the snapshot, if attached
+    ~SharedSnapshot();
+
+    // Write the snapshot given to the shared memory segment called name (if name begins with '/'),
+    // or else to the file at the path name.  A file is written beside the target and renamed into
+    // place; a segment is written under the next generation's name, the segment called name is
+    // switched to it, and only then is the previous generation unlinked.  Either way processes
+    // already attached keep the version they mapped.  Only one process may publish under a name
+    // at a time.  Return true if success, otherwise false with the reason in errorMessage
+    static bool publish(const DBSnapshot &snapshot, const std::string name, std::string &errorMessage);
+
+    // Map the snapshot published under name read only.  Any snapshot already attached is detached first.
+    // The header and every equity's bars are checked to lie within the mapping.
+    // Return true if success, otherwise false with the reason in errorMessage
+    bool attach(const std::string name, std::string &errorMessage);
+
+    // Unmap the attached snapshot
+    void detach();
+
+    // True if a snapshot is attached
+    bool isAttached() const;
+
+    // Version of the DBSnapshot which was published
+    unsigned long version() const;
+
+    // Number of equities in the attached snapshot
+    unsigned long numEquities() const;
+
+    // Get the equity at the given position (0 <= equityNum < numEquities()), in symbol order
+    const EquityRecord & equity(const unsigned long equityNum) const;
+
+    // Find the equity with the symbol specified.
+    // Return true and set equityNum if found, false otherwise
+    bool find(const std::string symbol, unsigned long &equityNum) const;
+
+    // Return the bars of the equity at the given position, in date order (equity(equityNum).numBars of them)
+    const Bar * bars(const unsigned long equityNum) const;
+
+private:
+
+    // Header at the start of the shared layout
+    struct Header {
+        char magic[8];                       // Identifies the layout
+        uint32_t layoutVersion;              // Version of this layout
+        uint32_t complete;                   // Set to 1 once everything else has been written
+        uint64_t snapshotVersion;            // Version of the DBSnapshot published
+        uint64_t numEquities;                // Number of equity records
+        uint64_t equityTableOffset;          // Offset from the start of the layout to the first equity record
+        uint64_t barTableOffset;             // Offset from the start of the layout to the first bar
+        uint64_t totalSize;                  // Size of the whole layout in bytes
+    };
+
+    // Contents of the segment called by the name a snapshot is published under, giving the
+    // generation of the segment which holds it (shared memory only)
+    struct Link {
+        char magic[8];                       // Identifies the link
+        std::atomic<uint64_t> generation;    // Generation of the segment holding the snapshot, 0 if none yet
+    };
+
+    // Start of the mapped layout, or NULL if not attached
+    const unsigned char *m_base;
+
+    // Size of the mapping
+    size_t m_size;
+
+    // Pointers into the mapping, worked out from the header offsets when attached
+    const Header *m_header;
+    const EquityRecord *m_equities;
+    const Bar *m_bars;
+
+    // True if name refers to a shared memory segment rather than a file
+    static bool isSegmentName(const std::string &name);
+
+    // Name of the segment holding generation of the snapshot published under name
+    static std::string generationName(const std::string &name, const uint64_t generation);
+
+    // Map the link segment called name read / write, creating it if needed.
+    // Return NULL (with the reason in errorMessage) if it cannot be, or is not a link
+    static Link * openLink(const std::string &name, std::string &errorMessage);
+
+    // Read the generation of the snapshot published under the segment name (0 if none yet).
+    // Return true if success, otherwise false with the reason in errorMessage
+    static bool readGeneration(const std::string &name, uint64_t &generation, std::string &errorMessage);
+
+    // Open the segment or file holding the snapshot published under name, read only.
+    // Return the descriptor, or -1 (with the reason in errorMessage) on failure
+    static int openPublished(const std::string &name, std::string &errorMessage);
+
+    // True if the header, tables and every equity's bars lie within the m_size bytes mapped
+    bool layoutValid() const;
+
+    // Copy a string into a fixed size null terminated field, cutting it short if needed
+    static void copyField(char *field, const size_t fieldSize, const std::string &value);
+
+    // The object owns a mapping, so copying is not allowed
+    SharedSnapshot(const SharedSnapshot &);
+    void operator=(const SharedSnapshot &);
+};
+
+#endif // SHAREDSNAPSHOT_H
@@ -0,0 +1,293 @@
+/*
+ * Class: TradingDataWriter
+ * Author: Marc Stahl
+ * Description: Writes trading days to an Fx.DAT / Cx.MWD file in the MetaStock
+ *   record layout.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "msfileio.h"
+#include "tradingdatawriter.h"
+
+using namespace std;
+
+// Offset of the number of records (an unsigned short) in the header record
+#define TRADINGDATAFILE_NUM_RECORDS_OFFSET   2
+
+// The number of records (including the header) is held in an unsigned short
+#define TRADINGDATAFILE_MAX_RECORDS          65535
+
+// Most records encoded before the buffer is written out
+#define TRADINGDATAWRITER_RECORDS_PER_WRITE  4096
+
+
+// Constructor: Create a writer with an empty buffer
+TradingDataWriter::TradingDataWriter()
+{
+}
+
+
+// Write tradingDays[firstDay] onward to the data file open on fd, then set the number of records in the header.
+// Return true if success, otherwise false with the reason in errorMessage
+bool TradingDataWriter::write(const int fd, const ActiveFields activeFields, const vector<TradingDay> &tradingDays,
+                              const unsigned long firstDay, string &errorMessage)
+{
+    const unsigned long recordSize = activeFields.recordSize();
+    const unsigned long numRecords = tradingDays.size() + 1;  // Trading days plus the header record
+
+    errorMessage = "";
+
+    if (recordSize < 4) {
+        errorMessage = "no active fields to write";
+        return false;
+    }
+    if (numRecords > TRADINGDATAFILE_MAX_RECORDS) {
+        errorMessage = "too many trading days (" + to_string(tradingDays.size()) + ") for one data file";
+        return false;
+    }
+
+    // Record 0 is the header; trading day n is record n+1
+    if (!writeRecords(fd, activeFields, tradingDays, (firstDay == 0) ? 0 : firstDay + 1, numRecords, errorMessage)) return false;
+
+    // Now that every record is in place, let readers see them by updating the count (little endian)
+    unsigned char countBytes[2];
+    countBytes[0] = numRecords & 0xff;
+    countBytes[1] = (numRecords >> 8) & 0xff;
+    if (!writeAt(fd, countBytes, 2, TRADINGDATAFILE_NUM_RECORDS_OFFSET)) {
+        errorMessage = string("failed to update number of records: ") + strerror(errno);
+        return false;
+    }
+
+    // Trim anything left beyond the last record (eg: the file had been written with a different layout)
+    struct stat info;
+    long long fileSize = static_cast<long long>(numRecords) * recordSize;
+    if ( (fstat(fd, &info) == 0) && (info.st_size > fileSize) && (ftruncate(fd, fileSize) != 0) ) {
+        errorMessage = string("failed to trim file: ") + strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+
+// Write the numDays trading days from tradingDays[firstDay] over their records in the data file open on fd.
+// Return true if success, otherwise false with the reason in errorMessage
+bool TradingDataWriter::rewrite(const int fd, const ActiveFields activeFields, const vector<TradingDay> &tradingDays,
+                                const unsigned long firstDay, const unsigned long numDays, string &errorMessage)
+{
+    errorMessage = "";
+
+    if (activeFields.recordSize() < 4) {
+        errorMessage = "no active fields to write";
+        return false;
+    }
+    if (firstDay + numDays > tradingDays.size()) {
+        errorMessage = "trading days to rewrite are beyond the last one held";
+        return false;
+    }
+    return writeRecords(fd, activeFields, tradingDays, firstDay + 1, firstDay + numDays + 1, errorMessage);
+}
+
+
+// Encode and write records [firstRecord, endRecord) of the file, a chunk at a time.  Record 0
+// is the header (kept, apart from the number of records) and trading day n is record n+1.
+// Return true if success, otherwise false with the reason in errorMessage
+bool TradingDataWriter::writeRecords(const int fd, const ActiveFields &activeFields, const vector<TradingDay> &tradingDays,
+                                     const unsigned long firstRecord, const unsigned long endRecord, string &errorMessage)
+{
+    const unsigned long recordSize = activeFields.recordSize();
+    unsigned long recordNum = firstRecord;
+    unsigned long dayNum = (firstRecord == 0) ? 0 : firstRecord - 1;
+
+    while (recordNum < endRecord) {
+        unsigned long chunkRecords = endRecord - recordNum;
+        if (chunkRecords > TRADINGDATAWRITER_RECORDS_PER_WRITE) chunkRecords = TRADINGDATAWRITER_RECORDS_PER_WRITE;
+
+        // Encode a chunk of records into the buffer.  The header record keeps the bytes already
+        // in the file, apart from the number of records, which is zeroed here and written last
+        m_buffer.assign(chunkRecords * recordSize, 0);
+        unsigned long headerRecords = (recordNum == 0) ? 1 : 0;
+        if (headerRecords > 0) {
+            if (!readHeader(fd, recordSize, &m_buffer[0])) {
+                errorMessage = string("failed to read header: ") + strerror(errno);
+                return false;
+            }
+            m_buffer[TRADINGDATAFILE_NUM_RECORDS_OFFSET] = 0;
+            m_buffer[TRADINGDATAFILE_NUM_RECORDS_OFFSET + 1] = 0;
+        }
+        unsigned long chunkDays = chunkRecords - headerRecords;
+        if (!encodeRecords(activeFields, tradingDays, dayNum, chunkDays, &m_buffer[headerRecords * recordSize])) {
+            // Find the day at fault, so it can be reported
+            vector<unsigned char> record(recordSize);
+            while ( (dayNum + 1 < tradingDays.size()) && (encodeRecord(activeFields, tradingDays[dayNum], &record[0])) ) dayNum++;
+            errorMessage = "trading day " + tradingDays[dayNum].date().asString(Date::EDateFormatYYYYMMMDD) +
+                           " has a value which cannot be written in MetaStock format";
+            return false;
+        }
+        dayNum += chunkDays;
+
+        if (!writeAt(fd, &m_buffer[0], m_buffer.size(), static_cast<long long>(recordNum) * recordSize)) {
+            errorMessage = string("write failed: ") + strerror(errno);
+            return false;
+        }
+        recordNum += chunkRecords;
+    }
+    return true;
+}
+
+
+// Copy one field of the numDays trading days from tradingDays[firstDay] into values, as floats
+template <typename T>
+static void gatherField(const vector<TradingDay> &tradingDays, const unsigned long firstDay, const unsigned long numDays,
+                        T (TradingDay::*field)() const, vector<float> &values)
+{
+    for (unsigned long dayNum = 0; dayNum < numDays; dayNum++)
+        values[dayNum] = static_cast<float>((tradingDays[firstDay + dayNum].*field)());
+}
+
+
+// Encode numDays trading days from tradingDays[firstDay] into consecutive zeroed records
+// starting at records.  Each field is gathered from every day and converted in one batch.
+// Return false if a value cannot be held in MBF32 format
+bool TradingDataWriter::encodeRecords(const ActiveFields &activeFields, const vector<TradingDay> &tradingDays,
+                                      const unsigned long firstDay, const unsigned long numDays, unsigned char *records)
+{
+    const unsigned long recordSize = activeFields.recordSize();
+    bool allValid = true;
+
+    if (numDays == 0) return true;
+
+    m_values.resize(numDays);
+    m_encoded.resize(numDays * 4);
+
+    if (activeFields.dateActive()) {
+        m_dates.resize(numDays);
+        for (unsigned long dayNum = 0; dayNum < numDays; dayNum++) m_dates[dayNum] = tradingDays[firstDay + dayNum].date();
+        allValid &= MSFileIO::datesToFloats(&m_dates[0], numDays, &m_values[0]);
+        allValid &= encodeField(numDays, recordSize, activeFields.dateOffset(), records);
+    }
+    if (activeFields.timeActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::time, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.timeOffset(), records);
+    }
+    if (activeFields.openActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::open, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.openOffset(), records);
+    }
+    if (activeFields.highActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::high, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.highOffset(), records);
+    }
+    if (activeFields.lowActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::low, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.lowOffset(), records);
+    }
+    if (activeFields.closeActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::close, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.closeOffset(), records);
+    }
+    if (activeFields.volumeActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::volume, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.volumeOffset(), records);
+    }
+    if (activeFields.openInterestActive()) {
+        gatherField(tradingDays, firstDay, numDays, &TradingDay::openInterest, m_values);
+        allValid &= encodeField(numDays, recordSize, activeFields.openInterestOffset(), records);
+    }
+
+    return allValid;
+}
+
+
+// Convert the numDays values in m_values to MBF32 in m_encoded, and place them in the field at
+// fieldOffset of consecutive records.  Return false if a value cannot be held in MBF32 format
+bool TradingDataWriter::encodeField(const unsigned long numDays, const unsigned long recordSize, const unsigned char fieldOffset, unsigned char *records)
+{
+    bool allValid = MSFileIO::floatsToMBF32(&m_values[0], numDays, &m_encoded[0]);
+
+    for (unsigned long dayNum = 0; dayNum < numDays; dayNum++)
+        memcpy(records + dayNum * recordSize + fieldOffset, &m_encoded[dayNum * 4], 4);
+    return allValid;
+}
+
+
+// Encode one trading day into the record at the position given, which must be zeroed.
+// Return false if a value cannot be held in MBF32 format
+bool TradingDataWriter::encodeRecord(const ActiveFields &activeFields, const TradingDay &tradingDay, unsigned char *record)
+{
+    float date;
+
+    if (activeFields.dateActive()) {
+        if (!MSFileIO::dateToFloat(tradingDay.date(), date)) return false;
+        if (!MSFileIO::floatToMBF32(date, record + activeFields.dateOffset())) return false;
+    }
+    if ( (activeFields.timeActive()) && (!MSFileIO::floatToMBF32(tradingDay.time(), record + activeFields.timeOffset())) ) return false;
+    if ( (activeFields.openActive()) && (!MSFileIO::floatToMBF32(tradingDay.open(), record + activeFields.openOffset())) ) return false;
+    if ( (activeFields.highActive()) && (!MSFileIO::floatToMBF32(tradingDay.high(), record + activeFields.highOffset())) ) return false;
+    if ( (activeFields.lowActive()) && (!MSFileIO::floatToMBF32(tradingDay.low(), record + activeFields.lowOffset())) ) return false;
+    if ( (activeFields.closeActive()) && (!MSFileIO::floatToMBF32(tradingDay.close(), record + activeFields.closeOffset())) ) return false;
+    if ( (activeFields.volumeActive()) &&
+         (!MSFileIO::floatToMBF32(static_cast<float>(tradingDay.volume()), record + activeFields.volumeOffset())) ) return false;
+    if ( (activeFields.openInterestActive()) &&
+         (!MSFileIO::floatToMBF32(tradingDay.openInterest(), record + activeFields.openInterestOffset())) ) return false;
+
+    return true;
+}
+
+
+// Copy the header record of the data file open on sourceFd into the file open on fd.
+// Return true if success, otherwise false with the reason in errorMessage
+bool TradingDataWriter::copyHeader(const int sourceFd, const int fd, const ActiveFields activeFields, string &errorMessage)
+{
+    vector<unsigned char> header(activeFields.recordSize(), 0);
+
+    errorMessage = "";
+    if (!readHeader(sourceFd, header.size(), &header[0])) {
+        errorMessage = string("failed to read header: ") + strerror(errno);
+        return false;
+    }
+    if (!writeAt(fd, &header[0], header.size(), 0)) {
+        errorMessage = string("failed to write header: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+
+// Read the header record of the file open on fd into header, with zeros past the end of the file.
+// Return true if success, false otherwise
+bool TradingDataWriter::readHeader(const int fd, const unsigned long recordSize, unsigned char *header)
+{
+    size_t bytesRead = 0;
+
+    while (bytesRead < recordSize) {
+        ssize_t result = pread(fd, header + bytesRead, recordSize - bytesRead, bytesRead);
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result < 0) return false;
+        if (result == 0) break;
+        bytesRead += result;
+    }
+    memset(header + bytesRead, 0, recordSize - bytesRead);
+    return true;
+}
+
+
+// Write size bytes of data at offset in the file, retrying short writes.
+// Return true if success, false otherwise
+bool TradingDataWriter::writeAt(const int fd, const unsigned char *data, const size_t size, const long long offset)
+{
+    size_t bytesWritten = 0;
+
+    while (bytesWritten < size) {
+        ssize_t result = pwrite(fd, data + bytesWritten, size - bytesWritten, offset + bytesWritten);
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result <= 0) return false;
+        bytesWritten += result;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+/*
+ * Class: TradingDataWriter
+ * Author: Marc Stahl
+ * Description: Writes trading days to an Fx.DAT / Cx.MWD file in the MetaStock
+ *   record layout.  Only the records from a given position onward are written,
+ *   so bringing a file up to date after a day is added appends one record rather
+ *   than rewriting the file, and days changed in place are written over just
+ *   their own records.  Records are encoded a field at a time across many
+ *   days (so the conversion to MBF32 can be vectorised) into one buffer, which is
+ *   kept between calls, and written with as few system calls as possible.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef TRADINGDATAWRITER_H
+#define TRADINGDATAWRITER_H
+
+#include <string>
+#include <vector>
+#include "activefields.h"
+#include "tradingday.h"
+
+class TradingDataWriter
+{
+public:
+
+    // Constructor: Create a writer with an empty buffer
+    TradingDataWriter();
+
+    // Write tradingDays[firstDay] onward to the data file open (for writing) on fd, using the
+    // record layout in activeFields, then set the number of records in the header.  The header
+    // is only updated once all records are written, so if writing is interrupted the file still
+    // reads back as it was.  If firstDay is 0 the header record is written too, keeping every
+    // byte of the header already in the file other than the number of records (zeros for a new
+    // file).  Return true if success, otherwise false with the reason in errorMessage
+    bool write(const int fd, const ActiveFields activeFields, const std::vector<TradingDay> &tradingDays,
+               const unsigned long firstDay, std::string &errorMessage);
+
+    // Write the numDays trading days from tradingDays[firstDay] over their records in the data
+    // file open on fd (eg: days changed in place), leaving the header and every other record as
+    // they are.  Return true if success, otherwise false with the reason in errorMessage
+    bool rewrite(const int fd, const ActiveFields activeFields, const std::vector<TradingDay> &tradingDays,
+                 const unsigned long firstDay, const unsigned long numDays, std::string &errorMessage);
+
+    // Copy the header record of the data file open on sourceFd into the file open on fd, which
+    // is about to be written whole (eg: the same equity under a new file number), so write()
+    // keeps it.  Return true if success, otherwise false with the reason in errorMessage
+    static bool copyHeader(const int sourceFd, const int fd, const ActiveFields activeFields, std::string &errorMessage);
+
+private:
+
+    // Records encoded but not yet written
+    std::vector<unsigned char> m_buffer;
+
+    // One field of every trading day being encoded, before and after conversion to MBF32
+    std::vector<Date> m_dates;
+    std::vector<float> m_values;
+    std::vector<unsigned char> m_encoded;
+
+    // Encode and write records [firstRecord, endRecord) of the file, where record 0 is the header
+    // (as already in the file, with the number of records zeroed) and trading day n is record n+1.  Return true if success, otherwise false
+    // with the reason in errorMessage
+    bool writeRecords(const int fd, const ActiveFields &activeFields, const std::vector<TradingDay> &tradingDays,
+                      const unsigned long firstRecord, const unsigned long endRecord, std::string &errorMessage);
+
+    // Encode numDays trading days from tradingDays[firstDay] into consecutive zeroed records
+    // starting at records.  Return false if a value cannot be held in MBF32 format
+    bool encodeRecords(const ActiveFields &activeFields, const std::vector<TradingDay> &tradingDays,
+                       const unsigned long firstDay, const unsigned long numDays, unsigned char *records);
+
+    // Convert the numDays values in m_values to MBF32, and place them in the field at fieldOffset of
+    // consecutive records.  Return false if a value cannot be held in MBF32 format
+    bool encodeField(const unsigned long numDays, const unsigned long recordSize, const unsigned char fieldOffset, unsigned char *records);
+
+    // Encode one trading day into the record at the position given, which must be zeroed.
+    // Return false if a value cannot be held in MBF32 format
+    static bool encodeRecord(const ActiveFields &activeFields, const TradingDay &tradingDay, unsigned char *record);
+
+    // Read the header record (recordSize bytes) of the file open on fd into header, with zeros
+    // past the end of the file.  Return true if success, false otherwise
+    static bool readHeader(const int fd, const unsigned long recordSize, unsigned char *header);
+
+    // Write size bytes of data at offset in the file, retrying short writes.
+    // Return true if success, false otherwise
+    static bool writeAt(const int fd, const unsigned char *data, const size_t size, const long long offset);
+};
+
+#endif // TRADINGDATAWRITER_H
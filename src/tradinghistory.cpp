@@ -2,12 +2,15 @@
  * Class: TradingHistory
  * Author: Marc Stahl
  * Description: Stores the data for one stock over zero or more days.
- *     This class has a list of TradingDay objects.
+ *     This class has a list of TradingDay objects, shared copy-on-write with
+ *     any snapshots taken of it.
  * History:
  *   MKS    2018-Jan-19   Original coding
  */
 
 #include "tradinghistory.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include "activefields.h"
@@ -22,16 +25,45 @@ TradingHistory::TradingHistory(
         const Date firstTradingDayInData,
         const Date lastTradingDayInData) :
     m_loaded(false),
+    m_tradingData(new vector<TradingDay>),
     m_tradingDataItValid(false),
+    m_tradingDataIt(0),
+    m_firstUnsavedDay(0),
     m_firstTradingDayInData(firstTradingDayInData),
-    m_lastTradingDayInData(lastTradingDayInData)
+    m_lastTradingDayInData(lastTradingDayInData),
+    m_zoneMap(new ZoneMap)
 {
 }
 
 
 // Return number of trading days held in this object
 unsigned long TradingHistory::days() const {
-    return m_tradingData.size();
+    return m_tradingData->size();
+}
+
+
+// Return the current list of trading days.  Once returned the list is shared,
+// so the next change to this object will be made to a copy
+shared_ptr<const vector<TradingDay> > TradingHistory::sharedTradingDays() const {
+    return m_tradingData;
+}
+
+
+// Return the current zone map of the trading days.  Once returned it is shared, so the
+// next change to this object will be made to a copy
+shared_ptr<const ZoneMap> TradingHistory::sharedZoneMap() const {
+    return m_zoneMap;
+}
+
+
+// If the list of trading days is shared with a snapshot, take a private copy
+// so it can be changed.  Snapshots are only taken by the thread changing this
+// object, so the count cannot go up between the check and the change.  use_count()
+// is only a relaxed read, so when the list is not copied a fence makes the last reads
+// of it by a snapshot which has just let it go happen before it is changed here
+void TradingHistory::makeWritable() {
+    if (m_tradingData.use_count() > 1) m_tradingData.reset(new vector<TradingDay>(*m_tradingData));
+    else atomic_thread_fence(memory_order_acquire);
 }
 
 
@@ -40,6 +72,107 @@ void TradingHistory::loaded(const bool isLoaded) {
     m_loaded = isLoaded;
 }
 
+// Remove all trading days and set the first / last dates, returning the object
+// to the state it had when constructed
+void TradingHistory::reset(const Date firstTradingDayInData, const Date lastTradingDayInData) {
+    // Start a new list rather than clearing, as the old one may be held by a snapshot
+    m_tradingData.reset(new vector<TradingDay>);
+    m_tradingDataItValid = false;
+    m_loaded = false;
+    m_firstUnsavedDay = 0;
+    m_modifiedDays.clear();
+    daysChanged(0, false);
+    m_firstTradingDayInData = firstTradingDayInData;
+    m_lastTradingDayInData = lastTradingDayInData;
+}
+
+// Position of the first trading day which differs from the data file
+unsigned long TradingHistory::firstUnsavedDay() const {
+    return m_firstUnsavedDay;
+}
+
+
+// Lower the position of the first trading day which differs from the data file.  Days
+// changed in place from there on are written anyway, so are no longer tracked
+void TradingHistory::firstUnsavedDay(const unsigned long position) {
+    if (position >= m_firstUnsavedDay) return;
+    m_firstUnsavedDay = position;
+    m_modifiedDays.erase(m_modifiedDays.lower_bound(position), m_modifiedDays.end());
+}
+
+
+// Ranges [first, last) of the positions of trading days changed in place before
+// firstUnsavedDay(), in order, with neighbouring days joined into one range
+void TradingHistory::modifiedRanges(vector<pair<unsigned long, unsigned long> > &ranges) const {
+    set<unsigned long>::const_iterator dayIt;
+
+    ranges.clear();
+    for (dayIt = m_modifiedDays.begin(); dayIt != m_modifiedDays.end(); dayIt++) {
+        if ( (!ranges.empty()) && (ranges.back().second == *dayIt) ) ranges.back().second++;
+        else ranges.push_back(make_pair(*dayIt, *dayIt + 1));
+    }
+}
+
+
+// True if any trading day differs from the data file
+bool TradingHistory::hasUnsavedDays() const {
+    return ( (m_firstUnsavedDay < m_tradingData->size()) || (!m_modifiedDays.empty()) );
+}
+
+
+// Record that the data file now holds every trading day in this object
+void TradingHistory::markSaved() {
+    m_firstUnsavedDay = m_tradingData->size();
+    m_modifiedDays.clear();
+}
+
+
+// Attach an indicator, bringing it up to date with every trading day held
+void TradingHistory::attachIndicator(const shared_ptr<IndicatorState> &indicator) {
+    indicator->reset();
+    for (unsigned long dayNum = 0; dayNum < m_tradingData->size(); dayNum++) indicator->add((*m_tradingData)[dayNum]);
+    m_indicators.push_back(indicator);
+}
+
+
+// Stop keeping the indicator given up to date.  Return false if it was not attached
+bool TradingHistory::detachIndicator(const shared_ptr<IndicatorState> &indicator) {
+    vector<shared_ptr<IndicatorState> >::iterator indicatorIt = find(m_indicators.begin(), m_indicators.end(), indicator);
+    if (indicatorIt == m_indicators.end()) return false;
+    m_indicators.erase(indicatorIt);
+    return true;
+}
+
+
+// Bring the attached indicators and the zone map up to date after the days from position onward
+// have been added or changed.  A zone map shared with a snapshot is copied before it is changed
+// (with the same fence as makeWritable() when it is not)
+void TradingHistory::daysChanged(const unsigned long position, const bool lastReplaced) {
+    updateIndicators(position, lastReplaced);
+    if (m_zoneMap.use_count() > 1) m_zoneMap.reset(new ZoneMap(*m_zoneMap));
+    else atomic_thread_fence(memory_order_acquire);
+    m_zoneMap->update(*m_tradingData, position, lastReplaced);
+}
+
+
+// Bring the attached indicators up to date after the days from position onward have been added
+// or changed.  Days appended are simply added, and a change to the last day replaces it, but an
+// indicator which has already seen a changed day must start again from the first
+void TradingHistory::updateIndicators(const unsigned long position, const bool lastReplaced) {
+    const vector<TradingDay> &days = *m_tradingData;
+
+    for (unsigned long indicatorNum = 0; indicatorNum < m_indicators.size(); indicatorNum++) {
+        IndicatorState *indicator = m_indicators[indicatorNum].get();
+
+        if ( (lastReplaced) && (indicator->numDays() == days.size()) && (position + 1 == days.size()) ) {
+            indicator->replaceLast(days[position]);
+            continue;
+        }
+        if (position < indicator->numDays()) indicator->reset();
+        for (unsigned long dayNum = indicator->numDays(); dayNum < days.size(); dayNum++) indicator->add(days[dayNum]);
+    }
+}
+
 // Create a single horizontal divider line to match the active fields
 string TradingHistory::dividerLine(const ActiveFields activeFields) const {
 
@@ -116,46 +249,145 @@ std::string TradingHistory::headerLine(const ActiveFields activeFields) const {
 bool TradingHistory::addTradingDayData(TradingDay newDayData)
 {
     // If list is empty then set everything
-    if (m_tradingData.begin() == m_tradingData.end()) {
+    if (m_tradingData->empty()) {
+        makeWritable();
         m_firstTradingDayInData = newDayData.date();
         m_lastTradingDayInData = newDayData.date();
-        m_tradingData.push_back(newDayData);
+        m_tradingData->push_back(newDayData);
+        firstUnsavedDay(0);
+        daysChanged(0, false);
     }
 
     // Else there is some data in the list
     else {
 
-        // Create an interator starting at the end
-        std::list<TradingDay>::reverse_iterator tradingDayIterator;
-
-        // Go through list until reach end (before first item),
+        // Go back from the end of the list until reach the begining,
         // or found a date which is <= newDataData date
-        for(tradingDayIterator = m_tradingData.rbegin(); ( (tradingDayIterator != m_tradingData.rend()) && ((*tradingDayIterator).date() > newDayData.date()) ); tradingDayIterator++);
+        unsigned long position = m_tradingData->size();
+        while ( (position > 0) && ((*m_tradingData)[position - 1].date() > newDayData.date()) ) position--;
 
-        // If hit the begining of the list (before first element), add
-        // to front and update range
-        if (tradingDayIterator == m_tradingData.rend()) {
-            m_firstTradingDayInData = newDayData.date();
-            m_tradingData.push_front(newDayData);
-        }
+        // If this date alread exists then
+        if ( (position > 0) && ((*m_tradingData)[position - 1].date() == newDayData.date()) ) return false;
 
-        // Else insert into list middle or end
-        else {
+        // If hit the begining of the list, update range
+        if (position == 0) m_firstTradingDayInData = newDayData.date();
 
-            // If this date alread exists then
-            if ((*tradingDayIterator).date() == newDayData.date()) return false;
+        // If still at the end of the list, update range
+        if (position == m_tradingData->size()) m_lastTradingDayInData = newDayData.date();
 
+        // Insert into the list at the position found.  Everything after it moves along
+        // one record, so must be written again when saved
+        makeWritable();
+        m_tradingData->insert(m_tradingData->begin() + position, newDayData);
+        firstUnsavedDay(position);
+        daysChanged(position, false);
+    }
+    return true;
+}
 
-            // If still at the end of the list, add to back and update range
-            if (tradingDayIterator == m_tradingData.rbegin()) {
-                m_lastTradingDayInData = newDayData.date();
-                m_tradingData.push_back(newDayData);
-            }
 
-            // else insert into the middle of the list
-            else m_tradingData.insert(tradingDayIterator.base(), newDayData);
+// Adds many trading days at once, merging the date ordered newDays into the list in one pass.
+// Days whose date is already held are skipped and counted in numDuplicates.
+// Returns the number of days added
+unsigned long TradingHistory::addTradingDays(const vector<TradingDay> &newDays, unsigned long &numDuplicates)
+{
+    numDuplicates = 0;
+    if (newDays.empty()) return 0;
+
+    // Compare dates as YYYYMMDD numbers, which is much cheaper than comparing Date objects
+    const vector<TradingDay> &oldDays = *m_tradingData;
+
+    // Days after the last one held (eg: an end of day update) are appended, leaving the
+    // days already held where they are
+    if ( (!oldDays.empty()) && (newDays[0].date().asYYYYMMDD() > oldDays.back().date().asYYYYMMDD()) ) {
+        unsigned long oldSize = oldDays.size();
+        makeWritable();
+        for (unsigned long newNum = 0; newNum < newDays.size(); newNum++) {
+            if ( (newNum > 0) && (newDays[newNum - 1].date().asYYYYMMDD() == newDays[newNum].date().asYYYYMMDD()) ) numDuplicates++;
+            else m_tradingData->push_back(newDays[newNum]);
         }
+        m_lastTradingDayInData = m_tradingData->back().date();
+        firstUnsavedDay(oldSize);
+        daysChanged(oldSize, false);
+        return m_tradingData->size() - oldSize;
     }
+
+    unsigned long oldNum = 0;
+    unsigned long newNum = 0;
+    vector<TradingDay> merged;
+    merged.reserve(oldDays.size() + newDays.size());
+
+    // Days before the first new one are unchanged, and are copied as a block
+    unsigned long firstNewDate = newDays[0].date().asYYYYMMDD();
+    while ( (oldNum < oldDays.size()) && (oldDays[oldNum].date().asYYYYMMDD() < firstNewDate) ) oldNum++;
+    unsigned long firstChanged = oldNum;
+    merged.insert(merged.end(), oldDays.begin(), oldDays.begin() + oldNum);
+
+    while (newNum < newDays.size()) {
+        unsigned long newDate = newDays[newNum].date().asYYYYMMDD();
+
+        // Keep the days already held which come before this one
+        while ( (oldNum < oldDays.size()) && (oldDays[oldNum].date().asYYYYMMDD() < newDate) ) merged.push_back(oldDays[oldNum++]);
+
+        // Skip a date already held, or given twice
+        if ( ((oldNum < oldDays.size()) && (oldDays[oldNum].date().asYYYYMMDD() == newDate)) ||
+             ((newNum > 0) && (newDays[newNum - 1].date().asYYYYMMDD() == newDate)) ) {
+            numDuplicates++;
+        } else {
+            merged.push_back(newDays[newNum]);
+        }
+        newNum++;
+    }
+    merged.insert(merged.end(), oldDays.begin() + oldNum, oldDays.end());
+
+    unsigned long numAdded = merged.size() - oldDays.size();
+    if (numAdded == 0) return 0;
+
+    // Replace the list rather than changing it, as the old one may be held by a snapshot
+    m_tradingData.reset(new vector<TradingDay>());
+    m_tradingData->swap(merged);
+    m_tradingDataItValid = false;
+    m_firstTradingDayInData = m_tradingData->front().date();
+    m_lastTradingDayInData = m_tradingData->back().date();
+    firstUnsavedDay(firstChanged);
+    daysChanged(firstChanged, false);
+    return numAdded;
+}
+
+
+// Compare a trading day with a date held as YYYYMMDD, to search the list by date
+static bool tradingDayBefore(const TradingDay &tradingDay, const unsigned long date)
+{
+    return (tradingDay.date().asYYYYMMDD() < date);
+}
+
+
+// True if a trading day with the date given is held
+bool TradingHistory::containsDate(const Date date) const
+{
+    unsigned long dateNum = date.asYYYYMMDD();
+
+    // Most often asked of a date after the last one held
+    if ( (m_tradingData->empty()) || (m_tradingData->back().date().asYYYYMMDD() < dateNum) ) return false;
+    vector<TradingDay>::const_iterator dayIt = lower_bound(m_tradingData->begin(), m_tradingData->end(), dateNum, tradingDayBefore);
+    return ( (dayIt != m_tradingData->end()) && (dayIt->date().asYYYYMMDD() == dateNum) );
+}
+
+
+// Replace the trading day held for the date of tradingDay with tradingDay.
+// Returns true if the date was held (and so replaced), false otherwise
+bool TradingHistory::updateTradingDayData(const TradingDay &tradingDay)
+{
+    unsigned long date = tradingDay.date().asYYYYMMDD();
+    vector<TradingDay>::const_iterator dayIt = lower_bound(m_tradingData->begin(), m_tradingData->end(), date, tradingDayBefore);
+    if ( (dayIt == m_tradingData->end()) || (dayIt->date().asYYYYMMDD() != date) ) return false;
+
+    // Only this record changes.  Days from m_firstUnsavedDay on are written anyway
+    unsigned long position = dayIt - m_tradingData->begin();
+    makeWritable();
+    (*m_tradingData)[position] = tradingDay;
+    if (position < m_firstUnsavedDay) m_modifiedDays.insert(position);
+    daysChanged(position, true);
     return true;
 }
 
@@ -165,11 +397,11 @@ bool TradingHistory::addTradingDayData(TradingDay newDayData)
 bool TradingHistory::getFirstTradingDayData(TradingDay& tradingDayData)
 {
     // If empty list, no first element
-    if (m_tradingData.empty()) return false;
+    if (m_tradingData->empty()) return false;
 
     // Get first element
-    m_tradingDataIt = m_tradingData.begin();
-    tradingDayData = *m_tradingDataIt;
+    m_tradingDataIt = 0;
+    tradingDayData = (*m_tradingData)[m_tradingDataIt];
 
     // Set flag that iterator is valid
     m_tradingDataItValid = true;
@@ -189,13 +421,13 @@ bool TradingHistory::getNextTradingDayData(TradingDay& tradingDayData)
     m_tradingDataIt++;
 
     // If reached end, invalidate the iterator and return false
-    if (m_tradingDataIt == m_tradingData.end()) {
+    if (m_tradingDataIt >= m_tradingData->size()) {
         m_tradingDataItValid = false;
         return false;
     }
 
     // Copy last element as my data
-    tradingDayData = *m_tradingDataIt;
+    tradingDayData = (*m_tradingData)[m_tradingDataIt];
     return true;
 }
 
@@ -220,7 +452,7 @@ void TradingHistory::print(const ActiveFields activeFields) {
     std::cout << "First Date...............................: " << m_firstTradingDayInData.asString(Date::EDateFormatYYYYMMMDD) << endl;
     std::cout << "Last Date................................: " << m_lastTradingDayInData.asString(Date::EDateFormatYYYYMMMDD) << endl;
     std::cout << "Trading data loaded......................: " << (m_loaded?"Yes":"No") << endl;
-    std::cout << "Number of trading days...................: " << m_tradingData.size() << endl;
+    std::cout << "Number of trading days...................: " << m_tradingData->size() << endl;
     std::cout << dividerLine(activeFields) << std::endl;
     std::cout << headerLine(activeFields) << std::endl;
     std::cout << dividerLine(activeFields) << std::endl;
@@ -2,6 +2,8 @@
  * Class: TradingHistory
  * Author: Marc Stahl
  * Description: Stores the data for one stock over many days. This class has a list of TradingDay objects.
+ *   The list is shared copy-on-write with any snapshots taken of it, so a snapshot
+ *   never changes once taken.
  * History:
  *   MKS    2018-Jan-19   Original coding
  */
@@ -9,9 +11,14 @@
 #ifndef TRADINGHISTORY_H
 #define TRADINGHISTORY_H
 
-#include <list>
+#include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
+#include "indicatorstate.h"
 #include "tradingday.h"
+#include "zonemap.h"
 using namespace std;
 
 class TradingHistory
@@ -40,6 +47,21 @@ public:
     // Returns true if succesfully added new day data
     bool addTradingDayData(TradingDay newDayData);
 
+    // Adds many trading days at once.  newDays must be in date order.  Days whose date is
+    // already held (or repeated within newDays) are skipped and counted in numDuplicates.
+    // Faster than adding the days one at a time, as the list is merged in a single pass (or,
+    // when every new day is after the last one held, simply appended).
+    // Returns the number of days added
+    unsigned long addTradingDays(const std::vector<TradingDay> &newDays, unsigned long &numDuplicates);
+
+    // True if a trading day with the date given is held
+    bool containsDate(const Date date) const;
+
+    // Replace the trading day held for the date of tradingDay with tradingDay, recording
+    // its position so only that record is written when saved.
+    // Returns true if the date was held (and so replaced), false otherwise
+    bool updateTradingDayData(const TradingDay &tradingDay);
+
     // Reset at start of list, and copy first item in the list
     // into the parameter.  Return true if success, false otherwise
     bool getFirstTradingDayData(TradingDay& tradingDayData);
@@ -52,23 +74,67 @@ public:
     // Return number of trading days held in this object
     unsigned long days() const;
 
+    // Return the current list of trading days.  The list returned is never changed
+    // afterwards: later changes to this object are made to a private copy
+    std::shared_ptr<const std::vector<TradingDay> > sharedTradingDays() const;
+
+    // Return the current zone map of the trading days (see ZoneMap).  Like the list of trading
+    // days, the zone map returned is never changed afterwards
+    std::shared_ptr<const ZoneMap> sharedZoneMap() const;
+
     // Setter for trading history loaded
     void loaded(const bool isLoaded);
 
+    // Remove all trading days and set the first / last dates, returning the object
+    // to the state it had when constructed
+    void reset(const Date firstTradingDayInData, const Date lastTradingDayInData);
+
+    // Position of the first trading day which differs from the data file (equal to
+    // days() if nothing has changed since it was read or saved).  Every day from this
+    // position onward must be written to bring the file up to date
+    unsigned long firstUnsavedDay() const;
+
+    // Ranges [first, last) of the positions of trading days changed in place before
+    // firstUnsavedDay(), in order, with neighbouring days joined into one range.  Only these
+    // records and those from firstUnsavedDay() onward differ from the data file
+    void modifiedRanges(std::vector<std::pair<unsigned long, unsigned long> > &ranges) const;
+
+    // True if any trading day differs from the data file
+    bool hasUnsavedDays() const;
+
+    // Record that the data file now holds every trading day in this object
+    void markSaved();
+
+    // Attach an indicator, bringing it up to date with every trading day held.  From then on it
+    // is kept up to date as days are added or changed: a day appended, or a change to the last
+    // day, updates it in constant time, while a day added or changed before the last has it
+    // recomputed from the first day
+    void attachIndicator(const std::shared_ptr<IndicatorState> &indicator);
+
+    // Stop keeping the indicator given up to date.  Return false if it was not attached
+    bool detachIndicator(const std::shared_ptr<IndicatorState> &indicator);
+
 private:
 
     // Has the data been loaded from the database
     bool m_loaded;
 
-    // List of trading day data
-    std::list<TradingDay> m_tradingData;
+    // List of trading day data, in date order.  May be shared with snapshots
+    std::shared_ptr< std::vector<TradingDay> > m_tradingData;
 
     // If the trading day iterator has reached the end of the trading day list, then false.
     // Otherwise true.
     bool m_tradingDataItValid;
 
-    // stores position of the current node from m_tradingData
-    std::list<TradingDay>::iterator m_tradingDataIt;
+    // stores position of the current element in m_tradingData
+    unsigned long m_tradingDataIt;
+
+    // Position of the first trading day which differs from the data file
+    unsigned long m_firstUnsavedDay;
+
+    // Positions (before m_firstUnsavedDay) of trading days changed in place since the data
+    // file was read or saved
+    std::set<unsigned long> m_modifiedDays;
 
     // The first date that the trading day list has stock data for, on this particular stock.
     Date m_firstTradingDayInData;
@@ -76,6 +142,28 @@ private:
     // The last date that the trading day list has stock data for, on this particular stock.
     Date m_lastTradingDayInData;
 
+    // Indicators kept up to date with the trading days
+    std::vector<std::shared_ptr<IndicatorState> > m_indicators;
+
+    // Summaries of the trading days, kept up to date with them.  May be shared with snapshots
+    std::shared_ptr<ZoneMap> m_zoneMap;
+
+
+    // If the list of trading days is shared with a snapshot, take a private copy
+    // so it can be changed
+    void makeWritable();
+
+    // Lower m_firstUnsavedDay to position, dropping the days changed in place which are now
+    // covered by it
+    void firstUnsavedDay(const unsigned long position);
+
+    // Bring the attached indicators and the zone map up to date after the days from position
+    // onward have been added or changed.  lastReplaced is true if only the last day was changed in place
+    void daysChanged(const unsigned long position, const bool lastReplaced);
+
+    // Bring the attached indicators up to date after the days from position onward have been
+    // added or changed.  lastReplaced is true if only the last day was changed in place
+    void updateIndicators(const unsigned long position, const bool lastReplaced);
 
     // Create a single horizontal divider line to match the active fields
     std::string dividerLine(const ActiveFields activeFields) const;
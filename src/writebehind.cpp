@@ -0,0 +1,181 @@
+/*
+ * Class: WriteBehind
+ * Author: Marc Stahl
+ * Description: A bounded queue of trading days waiting to be written, with a
+ *   background thread which flushes them.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include "writebehind.h"
+
+using namespace std;
+
+
+// Constructor: Create a queue with no flusher thread running
+WriteBehind::WriteBehind() :
+    m_maxQueuedDays(0),
+    m_flushDays(0),
+    m_flushInterval(0),
+    m_queuedDays(0),
+    m_flushedDays(0),
+    m_flushesStarted(0),
+    m_flushesFinished(0),
+    m_lastFlushSucceeded(true),
+    m_flushRequested(false),
+    m_running(false),
+    m_stopping(false)
+{
+}
+
+
+// Destructor: Flush anything queued and stop the flusher thread
+WriteBehind::~WriteBehind()
+{
+    string errorMessage;
+    stop(errorMessage);
+}
+
+
+// Start the flusher thread, which passes queued days to flushFunction.  Return false if already running
+bool WriteBehind::start(const FlushFunction flushFunction, const unsigned long maxQueuedDays, const unsigned long flushDays,
+                        const unsigned int flushIntervalMs)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_running) return false;
+
+    m_flushFunction = flushFunction;
+    m_maxQueuedDays = (maxQueuedDays > 0) ? maxQueuedDays : 1;
+    m_flushDays = (flushDays > 0) ? flushDays : 1;
+    if (m_flushDays > m_maxQueuedDays) m_flushDays = m_maxQueuedDays;
+    m_flushInterval = chrono::milliseconds(flushIntervalMs);
+    m_lastFlushSucceeded = true;
+    m_lastFlushError = "";
+    m_flushRequested = false;
+    m_stopping = false;
+    m_running = true;
+    m_thread = thread(&WriteBehind::run, this);
+    return true;
+}
+
+
+// True if the flusher thread is running
+bool WriteBehind::isRunning()
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    return ( (m_running) && (!m_stopping) );
+}
+
+
+// Queue a trading day, waiting while the queue is full.
+// Return false if the flusher thread is not running
+bool WriteBehind::enqueue(const string symbol, const TradingDay &tradingDay)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    // Days being flushed still count, so callers cannot get further ahead of the disk than allowed
+    while ( (m_running) && (!m_stopping) && (m_queuedDays - m_flushedDays >= m_maxQueuedDays) ) m_flushFinished.wait(lock);
+    if ( (!m_running) || (m_stopping) ) return false;
+
+    if (m_queue.empty()) m_firstQueuedTime = chrono::steady_clock::now();
+    m_queue.push_back(make_pair(symbol, tradingDay));
+    m_queuedDays++;
+
+    // Only wake the flusher when it has something to do, not for every day queued
+    if ( (m_queue.size() == 1) || (m_queue.size() >= m_flushDays) ) m_workAvailable.notify_one();
+    return true;
+}
+
+
+// Wait until a flush started after this call has finished.
+// Return true if that flush succeeded, otherwise false with the reason in errorMessage
+bool WriteBehind::flush(string &errorMessage)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    errorMessage = "";
+    if (!m_running) return true;
+
+    // A flush already under way may have taken the queue before the latest days were added,
+    // so wait for the next one to start and finish
+    unsigned long long flushNeeded = m_flushesStarted + 1;
+    m_flushRequested = true;
+    m_workAvailable.notify_one();
+    while ( (m_running) && (m_flushesFinished < flushNeeded) ) m_flushFinished.wait(lock);
+
+    if (!m_lastFlushSucceeded) errorMessage = m_lastFlushError;
+    return m_lastFlushSucceeded;
+}
+
+
+// Flush everything queued and stop the flusher thread.
+// Return true if the last flush succeeded, otherwise false with the reason in errorMessage
+bool WriteBehind::stop(string &errorMessage)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        errorMessage = "";
+        if ( (!m_running) || (m_stopping) ) return m_lastFlushSucceeded;
+        m_stopping = true;
+        m_flushRequested = true;
+        m_workAvailable.notify_one();
+        m_flushFinished.notify_all();
+    }
+
+    // The thread makes a last flush of anything queued before it ends
+    m_thread.join();
+
+    lock_guard<mutex> lock(m_mutex);
+    m_running = false;
+    m_stopping = false;
+    m_flushFinished.notify_all();
+    if (!m_lastFlushSucceeded) errorMessage = m_lastFlushError;
+    return m_lastFlushSucceeded;
+}
+
+
+// True if the flusher thread should start a flush now.  m_mutex must be held by the caller
+bool WriteBehind::flushDue() const
+{
+    if ( (m_flushRequested) || (m_stopping) ) return true;
+    if (m_queue.empty()) return false;
+    return ( (m_queue.size() >= m_flushDays) || (chrono::steady_clock::now() >= m_firstQueuedTime + m_flushInterval) );
+}
+
+
+// Body of the flusher thread: wait for work, and flush it, until asked to stop
+void WriteBehind::run()
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    while (true) {
+        while (!flushDue()) {
+            if (m_queue.empty()) m_workAvailable.wait(lock);
+            else m_workAvailable.wait_until(lock, m_firstQueuedTime + m_flushInterval);
+        }
+
+        // Take everything queued, so callers can carry on queueing while it is written
+        Batch batch;
+        batch.swap(m_queue);
+        m_flushRequested = false;
+        m_flushesStarted++;
+        bool stopping = m_stopping;
+        lock.unlock();
+
+        string errorMessage;
+        bool flushed = m_flushFunction(batch, errorMessage);
+
+        lock.lock();
+        m_flushedDays += batch.size();
+        m_flushesFinished++;
+        m_lastFlushSucceeded = flushed;
+        m_lastFlushError = errorMessage;
+        m_flushFinished.notify_all();
+
+        // Nothing more can be queued once stopping, so the flush after that was the last
+        if (stopping) break;
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * Class: WriteBehind
+ * Author: Marc Stahl
+ * Description: A bounded queue of trading days waiting to be written, with a
+ *   background thread which flushes them.  Callers queue days and return at
+ *   once; the flusher thread takes everything queued in one go and hands it to
+ *   a flush function (which adds the days to the database and saves, so writes
+ *   to the same file are coalesced).  A flush starts once enough days are
+ *   queued, once the oldest has waited long enough, or when asked for.  When the
+ *   queue is full callers wait for the flusher to catch up (backpressure), and
+ *   flush() waits until every day queued before it has been written.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef WRITEBEHIND_H
+#define WRITEBEHIND_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "tradingday.h"
+
+class WriteBehind
+{
+public:
+
+    // Trading days to flush, each with the symbol of its equity
+    typedef std::vector<std::pair<std::string, TradingDay> > Batch;
+
+    // Writes a batch of days.  Return true if success, otherwise false with the reason in errorMessage
+    typedef std::function<bool(const Batch &days, std::string &errorMessage)> FlushFunction;
+
+    // Constructor: Create a queue with no flusher thread running
+    WriteBehind();
+
+    // Destructor: Flush anything queued and stop the flusher thread
+    ~WriteBehind();
+
+    // Start the flusher thread, which passes queued days to flushFunction.  At most maxQueuedDays
+    // may be queued or being flushed at once.  A flush starts when flushDays are queued, or
+    // flushIntervalMs after the first day was queued.  Return false if already running
+    bool start(const FlushFunction flushFunction, const unsigned long maxQueuedDays, const unsigned long flushDays,
+               const unsigned int flushIntervalMs);
+
+    // True if the flusher thread is running
+    bool isRunning();
+
+    // Queue a trading day for the equity with the symbol given.  Waits while the queue is full.
+    // Return false if the flusher thread is not running (so the day was not queued)
+    bool enqueue(const std::string symbol, const TradingDay &tradingDay);
+
+    // Wait until a flush started after this call has finished, so every day queued before it
+    // has been written.  Return true if that flush succeeded, otherwise false with the reason in errorMessage
+    bool flush(std::string &errorMessage);
+
+    // Flush everything queued and stop the flusher thread.
+    // Return true if the last flush succeeded, otherwise false with the reason in errorMessage
+    bool stop(std::string &errorMessage);
+
+private:
+
+    // Passed each batch of days
+    FlushFunction m_flushFunction;
+
+    // Most days queued or being flushed at once
+    unsigned long m_maxQueuedDays;
+
+    // Number of queued days which starts a flush
+    unsigned long m_flushDays;
+
+    // Longest a day waits before a flush starts
+    std::chrono::milliseconds m_flushInterval;
+
+    // Days waiting for the next flush, and when the first of them was queued
+    Batch m_queue;
+    std::chrono::steady_clock::time_point m_firstQueuedTime;
+
+    // Number of days ever queued, and number taken by flushes which have finished
+    unsigned long long m_queuedDays;
+    unsigned long long m_flushedDays;
+
+    // Number of flushes started and finished, and the outcome of the last one finished
+    unsigned long long m_flushesStarted;
+    unsigned long long m_flushesFinished;
+    bool m_lastFlushSucceeded;
+    std::string m_lastFlushError;
+
+    // Has a caller asked for a flush to start now
+    bool m_flushRequested;
+
+    // Is the flusher thread running, and has it been asked to stop
+    bool m_running;
+    bool m_stopping;
+
+    // Guards every member above
+    std::mutex m_mutex;
+
+    // Signalled when there may be work for the flusher thread
+    std::condition_variable m_workAvailable;
+
+    // Signalled whenever a flush finishes
+    std::condition_variable m_flushFinished;
+
+    // The flusher thread
+    std::thread m_thread;
+
+    // Body of the flusher thread: wait for work, and flush it, until asked to stop
+    void run();
+
+    // True if the flusher thread should start a flush now.  m_mutex must be held by the caller
+    bool flushDue() const;
+
+    // The object owns a thread, so copying is not allowed
+    WriteBehind(const WriteBehind &);
+    void operator=(const WriteBehind &);
+};
+
+#endif // WRITEBEHIND_H
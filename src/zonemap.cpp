@@ -0,0 +1,224 @@
+/*
+ * Class: ZoneMap
+ * Author: Marc Stahl
+ * Description: Per zone and whole list summaries of a list of trading days,
+ *   kept up to date as days are added, and used to skip zones in range queries.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <limits>
+#include "zonemap.h"
+
+using namespace std;
+
+
+// Constructor: Create the summary of no days
+ZoneMap::Stats::Stats() :
+    count(0),
+    firstDate(0),
+    lastDate(0)
+{
+    for (unsigned int field = 0; field < NUM_FIELDS; field++) {
+        fields[field].minimum = numeric_limits<double>::infinity();
+        fields[field].maximum = -numeric_limits<double>::infinity();
+        fields[field].sum = 0;
+    }
+}
+
+
+// Lowest value of a field
+double ZoneMap::Stats::minimum(const Indicators::EFields field) const
+{
+    return fields[field].minimum;
+}
+
+
+// Highest value of a field
+double ZoneMap::Stats::maximum(const Indicators::EFields field) const
+{
+    return fields[field].maximum;
+}
+
+
+// Total of a field
+double ZoneMap::Stats::sum(const Indicators::EFields field) const
+{
+    return fields[field].sum;
+}
+
+
+// Average of a field (NaN if there are no days)
+double ZoneMap::Stats::mean(const Indicators::EFields field) const
+{
+    return (count > 0) ? fields[field].sum / count : numeric_limits<double>::quiet_NaN();
+}
+
+
+// Constructor: Create the zone map of no trading days
+ZoneMap::ZoneMap()
+{
+}
+
+
+// Add one trading day to a summary
+void ZoneMap::addDay(Stats &stats, const TradingDay &tradingDay)
+{
+    const double values[NUM_FIELDS] = {tradingDay.open(), tradingDay.high(), tradingDay.low(), tradingDay.close(),
+                                       static_cast<double>(tradingDay.volume()), tradingDay.openInterest()};
+    unsigned long date = tradingDay.date().asYYYYMMDD();
+
+    if (stats.count == 0) stats.firstDate = date;
+    stats.lastDate = date;
+    stats.count++;
+    for (unsigned int field = 0; field < NUM_FIELDS; field++) {
+        FieldStats &fieldStats = stats.fields[field];
+        if (values[field] < fieldStats.minimum) fieldStats.minimum = values[field];
+        if (values[field] > fieldStats.maximum) fieldStats.maximum = values[field];
+        fieldStats.sum += values[field];
+    }
+}
+
+
+// Add one summary to another, which covers the days before it
+void ZoneMap::combine(Stats &stats, const Stats &later)
+{
+    if (later.count == 0) return;
+
+    if (stats.count == 0) stats.firstDate = later.firstDate;
+    stats.lastDate = later.lastDate;
+    stats.count += later.count;
+    for (unsigned int field = 0; field < NUM_FIELDS; field++) {
+        FieldStats &fieldStats = stats.fields[field];
+        if (later.fields[field].minimum < fieldStats.minimum) fieldStats.minimum = later.fields[field].minimum;
+        if (later.fields[field].maximum > fieldStats.maximum) fieldStats.maximum = later.fields[field].maximum;
+        fieldStats.sum += later.fields[field].sum;
+    }
+}
+
+
+// Bring the zone map up to date after the days from position onward were added or changed.
+// Days appended are added to the last zone and the summary; otherwise the zones from the one
+// holding position onward are worked out again, and the summary from the zones
+void ZoneMap::update(const vector<TradingDay> &days, const unsigned long position, const bool lastReplaced)
+{
+    if ( (!lastReplaced) && (position == m_summary.count) ) {
+        for (unsigned long dayNum = position; dayNum < days.size(); dayNum++) {
+            if ( (m_zones.empty()) || (m_zones.back().count == ZONE_DAYS) ) m_zones.push_back(Stats());
+            addDay(m_zones.back(), days[dayNum]);
+            addDay(m_summary, days[dayNum]);
+        }
+        return;
+    }
+
+    unsigned long firstZone = position / ZONE_DAYS;
+    if (firstZone >= m_zones.size()) firstZone = m_zones.empty() ? 0 : m_zones.size() - 1;
+    m_zones.resize(firstZone);
+    for (unsigned long dayNum = firstZone * ZONE_DAYS; dayNum < days.size(); dayNum++) {
+        if ( (m_zones.empty()) || (m_zones.back().count == ZONE_DAYS) ) m_zones.push_back(Stats());
+        addDay(m_zones.back(), days[dayNum]);
+    }
+
+    m_summary = Stats();
+    for (unsigned long zoneNum = 0; zoneNum < m_zones.size(); zoneNum++) combine(m_summary, m_zones[zoneNum]);
+}
+
+
+// Summary of every trading day
+const ZoneMap::Stats & ZoneMap::summary() const
+{
+    return m_summary;
+}
+
+
+// Number of zones
+unsigned long ZoneMap::numZones() const
+{
+    return m_zones.size();
+}
+
+
+// Summary of one zone
+const ZoneMap::Stats & ZoneMap::zone(const unsigned long zoneNum) const
+{
+    return m_zones[zoneNum];
+}
+
+
+// Set stats to the summary of days [firstDay, endDay), reading only the days of the zones
+// the range starts and ends part way through
+void ZoneMap::rangeStats(const vector<TradingDay> &days, const unsigned long firstDay, const unsigned long endDay,
+                         Stats &stats) const
+{
+    unsigned long end = (endDay < days.size()) ? endDay : days.size();
+    unsigned long dayNum = firstDay;
+
+    stats = Stats();
+    while (dayNum < end) {
+        unsigned long zoneNum = dayNum / ZONE_DAYS;
+        unsigned long zoneEnd = (zoneNum + 1) * ZONE_DAYS;
+        if ( (dayNum == zoneNum * ZONE_DAYS) && (zoneEnd <= end) && (zoneNum < m_zones.size()) ) {
+            combine(stats, m_zones[zoneNum]);
+            dayNum = zoneEnd;
+            continue;
+        }
+        if (zoneEnd > end) zoneEnd = end;
+        for ( ; dayNum < zoneEnd; dayNum++) addDay(stats, days[dayNum]);
+    }
+}
+
+
+// Find the first trading day, from firstDay on, whose field lies between minValue and maxValue.
+// Return false if there is none
+bool ZoneMap::findFirst(const vector<TradingDay> &days, const Indicators::EFields field, const double minValue,
+                        const double maxValue, const unsigned long firstDay, unsigned long &position) const
+{
+    if ( (m_summary.fields[field].maximum < minValue) || (m_summary.fields[field].minimum > maxValue) ) return false;
+
+    for (unsigned long zoneNum = firstDay / ZONE_DAYS; zoneNum < m_zones.size(); zoneNum++) {
+        const FieldStats &fieldStats = m_zones[zoneNum].fields[field];
+        if ( (fieldStats.maximum < minValue) || (fieldStats.minimum > maxValue) ) continue;
+
+        unsigned long zoneStart = zoneNum * ZONE_DAYS;
+        unsigned long zoneEnd = zoneStart + m_zones[zoneNum].count;
+        if (zoneEnd > days.size()) zoneEnd = days.size();
+        for (unsigned long dayNum = (firstDay > zoneStart) ? firstDay : zoneStart; dayNum < zoneEnd; dayNum++) {
+            double value = Indicators::fieldValue(days[dayNum], field);
+            if ( (value >= minValue) && (value <= maxValue) ) {
+                position = dayNum;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// Number of trading days in [firstDay, endDay) whose field lies between minValue and maxValue
+unsigned long ZoneMap::countInRange(const vector<TradingDay> &days, const Indicators::EFields field, const double minValue,
+                                    const double maxValue, const unsigned long firstDay, const unsigned long endDay) const
+{
+    unsigned long end = (endDay < days.size()) ? endDay : days.size();
+    unsigned long count = 0;
+
+    for (unsigned long zoneNum = firstDay / ZONE_DAYS; (zoneNum < m_zones.size()) && (zoneNum * ZONE_DAYS < end); zoneNum++) {
+        const FieldStats &fieldStats = m_zones[zoneNum].fields[field];
+        if ( (fieldStats.maximum < minValue) || (fieldStats.minimum > maxValue) ) continue;
+
+        unsigned long zoneStart = zoneNum * ZONE_DAYS;
+        unsigned long zoneEnd = zoneStart + m_zones[zoneNum].count;
+        unsigned long first = (firstDay > zoneStart) ? firstDay : zoneStart;
+        unsigned long last = (end < zoneEnd) ? end : zoneEnd;
+
+        // Every day of a whole zone inside the range matches
+        if ( (first == zoneStart) && (last == zoneEnd) && (fieldStats.minimum >= minValue) && (fieldStats.maximum <= maxValue) ) {
+            count += m_zones[zoneNum].count;
+            continue;
+        }
+        for (unsigned long dayNum = first; dayNum < last; dayNum++) {
+            double value = Indicators::fieldValue(days[dayNum], field);
+            if ( (value >= minValue) && (value <= maxValue) ) count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,119 @@
+/*
+ * Class: ZoneMap
+ * Author: Marc Stahl
+ * Description: Summaries of a list of trading days: for each zone of
+ *   ZONE_DAYS consecutive days, and for the whole list, the number of days, the
+ *   first and last dates, and the lowest, highest, and total of every field.
+ *   Questions such as "what is the all time low" are answered from the whole
+ *   list's summary in O(1), and range queries ("did the high ever exceed X")
+ *   skip every zone whose lowest and highest values show it cannot match.
+ *
+ *   A TradingHistory keeps its zone map up to date as days are added or
+ *   changed: days appended are added to the last zone and the summary in
+ *   constant time, while a day inserted or changed earlier has the zones from
+ *   it onward worked out again.  Snapshots share the zone map of each equity
+ *   in the same way as its trading days.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <vector>
+#include "indicators.h"
+#include "tradingday.h"
+
+class ZoneMap
+{
+public:
+
+    // Number of trading days in each zone (the last zone may hold fewer)
+    static const unsigned long ZONE_DAYS = 256;
+
+    // Number of fields summarised (one for each Indicators::EFields)
+    static const unsigned int NUM_FIELDS = Indicators::EFieldOpenInterest + 1;
+
+    // Lowest, highest, and total of one field
+    struct FieldStats {
+        double minimum;
+        double maximum;
+        double sum;
+    };
+
+    // Summary of a run of trading days.  With no days, the minimums are +infinity, the maximums
+    // -infinity, and the dates 0
+    struct Stats {
+        unsigned long count;                 // Number of trading days
+        unsigned long firstDate;             // Date of the first, as YYYYMMDD
+        unsigned long lastDate;              // Date of the last, as YYYYMMDD
+        FieldStats fields[NUM_FIELDS];       // By Indicators::EFields
+
+        // Constructor: Create the summary of no days
+        Stats();
+
+        // Lowest value of a field
+        double minimum(const Indicators::EFields field) const;
+
+        // Highest value of a field
+        double maximum(const Indicators::EFields field) const;
+
+        // Total of a field
+        double sum(const Indicators::EFields field) const;
+
+        // Average of a field (NaN if there are no days)
+        double mean(const Indicators::EFields field) const;
+    };
+
+    // Constructor: Create the zone map of no trading days
+    ZoneMap();
+
+    // Bring the zone map up to date with days after the days from position onward were added or
+    // changed (lastReplaced is true if only the last day was changed in place).  Days appended
+    // after those already summarised are added in constant time each
+    void update(const std::vector<TradingDay> &days, const unsigned long position, const bool lastReplaced);
+
+    // Summary of every trading day
+    const Stats & summary() const;
+
+    // Number of zones
+    unsigned long numZones() const;
+
+    // Summary of one zone (0 <= zoneNum < numZones()), holding days [zoneNum * ZONE_DAYS, (zoneNum + 1) * ZONE_DAYS)
+    const Stats & zone(const unsigned long zoneNum) const;
+
+    // The methods below are passed the trading days the zone map was last updated with
+
+    // Set stats to the summary of days [firstDay, endDay).  Whole zones in the range are taken
+    // from their summaries, and only the days in the zones at either end are read
+    void rangeStats(const std::vector<TradingDay> &days, const unsigned long firstDay, const unsigned long endDay,
+                    Stats &stats) const;
+
+    // Find the first trading day, from firstDay on, whose field lies between minValue and maxValue
+    // (inclusive), setting position to it.  Zones which cannot hold such a day are skipped.
+    // Return false if there is none
+    bool findFirst(const std::vector<TradingDay> &days, const Indicators::EFields field, const double minValue,
+                   const double maxValue, const unsigned long firstDay, unsigned long &position) const;
+
+    // Number of trading days in [firstDay, endDay) whose field lies between minValue and maxValue
+    // (inclusive).  Zones which cannot hold such a day are skipped, and zones every day of which
+    // must lie in the range are counted whole
+    unsigned long countInRange(const std::vector<TradingDay> &days, const Indicators::EFields field, const double minValue,
+                               const double maxValue, const unsigned long firstDay, const unsigned long endDay) const;
+
+private:
+
+    // Summary of each zone
+    std::vector<Stats> m_zones;
+
+    // Summary of every trading day
+    Stats m_summary;
+
+    // Add one trading day to a summary
+    static void addDay(Stats &stats, const TradingDay &tradingDay);
+
+    // Add one summary to another, which covers the days before it
+    static void combine(Stats &stats, const Stats &later);
+};
+
+#endif // ZONEMAP_H
@@ -0,0 +1,236 @@
+/*
+ * Class: Main
+ * Author: Marc Stahl
+ * Description: Checks the batch encoders used when saving (MSFileIO::floatsToMBF32 and
+ *   MSFileIO::datesToFloats) against the one at a time encoders and the decoders used
+ *   when reading.  Prints each failure, and returns 1 if there were any.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <limits>
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include "msfileio.h"
+
+using namespace std;
+
+// Number of failures found
+static unsigned long numFailures = 0;
+
+
+// Report a failure
+static void fail(const string &message)
+{
+    if (numFailures < 50) cout << "FAILED: " << message << endl;
+    numFailures++;
+}
+
+
+// Make a float from its bits
+static float floatFromBits(const unsigned long bits)
+{
+    unsigned char bytes[4] = {static_cast<unsigned char>(bits), static_cast<unsigned char>(bits >> 8),
+                              static_cast<unsigned char>(bits >> 16), static_cast<unsigned char>(bits >> 24)};
+    float value;
+
+    memcpy(&value, bytes, 4);
+    return value;
+}
+
+
+// The bits of a float, as text
+static string bitsOf(const float value)
+{
+    unsigned char bytes[4];
+    ostringstream text;
+
+    memcpy(bytes, &value, 4);
+    text << hex << ((static_cast<unsigned long>(bytes[3]) << 24) | (bytes[2] << 16) | (bytes[1] << 8) | bytes[0]);
+    return text.str();
+}
+
+
+// Number of days in a month
+static unsigned int daysInMonth(const unsigned int year, const unsigned int month)
+{
+    static const unsigned int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leapYear = ( (year % 4 == 0) && ( (year % 100 != 0) || (year % 400 == 0) ) );
+
+    return ( (month == 2) && (leapYear) ) ? 29 : days[month - 1];
+}
+
+
+// Convert values[first, first + count) in one batch, and check every number against floatToMBF32
+// (byte for byte where it fits in MBF32) and the result against whether they all fit
+static void checkFloatBatch(const vector<float> &values, const unsigned long first, const unsigned long count)
+{
+    vector<unsigned char> batchBytes(count * 4 + 1);
+    bool allValid = true;
+
+    bool batchValid = MSFileIO::floatsToMBF32(count > 0 ? &values[first] : NULL, count, &batchBytes[0]);
+    for (unsigned long valueNum = 0; valueNum < count; valueNum++) {
+        unsigned char bytes[4];
+        if (!MSFileIO::floatToMBF32(values[first + valueNum], bytes)) {
+            allValid = false;
+            continue;
+        }
+        if (memcmp(bytes, &batchBytes[valueNum * 4], 4) != 0)
+            fail("floatsToMBF32 differs from floatToMBF32 for " + bitsOf(values[first + valueNum]));
+    }
+    if (batchValid != allValid) fail("floatsToMBF32 gave the wrong result for a batch");
+}
+
+
+// Check MBF32 encoding of floats: round trips, and the batch encoder against the one at a time encoder
+static void checkFloats()
+{
+    vector<float> values;
+
+    // Zero, the smallest and largest numbers of each kind, and numbers which do not fit in MBF32
+    values.push_back(0.0f);
+    values.push_back(-0.0f);
+    values.push_back(numeric_limits<float>::denorm_min());
+    values.push_back(-numeric_limits<float>::denorm_min());
+    values.push_back(floatFromBits(0x007fffff));
+    values.push_back(floatFromBits(0x807fffff));
+    values.push_back(numeric_limits<float>::min());
+    values.push_back(-numeric_limits<float>::min());
+    values.push_back(floatFromBits(0x7effffff));
+    values.push_back(floatFromBits(0xfeffffff));
+    values.push_back(floatFromBits(0x7f000000));
+    values.push_back(numeric_limits<float>::max());
+    values.push_back(-numeric_limits<float>::max());
+    values.push_back(numeric_limits<float>::infinity());
+    values.push_back(-numeric_limits<float>::infinity());
+    values.push_back(numeric_limits<float>::quiet_NaN());
+    values.push_back(1.0f);
+    values.push_back(-1.0f);
+    values.push_back(0.5f);
+    values.push_back(123.456f);
+    values.push_back(-98765.4321f);
+    values.push_back(4294967295.0f);
+
+    // Then numbers spread over every exponent and sign (a fixed sequence, so failures repeat)
+    unsigned long seed = 12345;
+    for (unsigned long valueNum = 0; valueNum < 200000; valueNum++) {
+        seed = (seed * 1103515245 + 12345) & 0xffffffff;
+        unsigned long bits = seed;
+        seed = (seed * 1103515245 + 12345) & 0xffffffff;
+        bits = (bits & 0xffff0000) | (seed >> 16);
+        values.push_back(floatFromBits(bits));
+    }
+
+    // Each number on its own must round trip, apart from those which cannot
+    for (unsigned long valueNum = 0; valueNum < values.size(); valueNum++) {
+        float value = values[valueNum];
+        unsigned char bytes[4];
+        float decoded;
+        bool fits = ( (value == value) && (fabsf(value) < floatFromBits(0x7f000000)) );
+
+        if (MSFileIO::floatToMBF32(value, bytes) != fits) {
+            fail("floatToMBF32 gave the wrong result for " + bitsOf(value));
+            continue;
+        }
+        if (!fits) continue;
+        if (!MSFileIO::MBF32ToFloat(bytes, decoded)) {
+            fail("MBF32ToFloat failed for " + bitsOf(value));
+            continue;
+        }
+
+        // Zero and denormals (too small for MBF32) come back as +0; everything else exactly
+        bool tooSmall = (fabsf(value) < numeric_limits<float>::min());
+        float expected = tooSmall ? 0.0f : value;
+        if (bitsOf(decoded) != bitsOf(expected)) fail("MBF32 round trip of " + bitsOf(value) + " gave " + bitsOf(decoded));
+    }
+
+    // The batch encoder, over every start alignment and length up to a few blocks of 4, then in bulk
+    for (unsigned long first = 0; first < 8; first++)
+        for (unsigned long count = 0; count <= 13; count++) checkFloatBatch(values, first, count);
+    checkFloatBatch(values, 0, values.size());
+    checkFloatBatch(values, 3, values.size() - 3);
+}
+
+
+// Convert dates[first, first + count) in one batch, and check every date against dateToFloat (bit for
+// bit, including the 0 given for dates which do not fit) and the result against whether they all fit
+static void checkDateBatch(const vector<Date> &dates, const unsigned long first, const unsigned long count)
+{
+    vector<float> batchFloats(count + 1);
+    bool allValid = true;
+
+    bool batchValid = MSFileIO::datesToFloats(count > 0 ? &dates[first] : NULL, count, &batchFloats[0]);
+    for (unsigned long dateNum = 0; dateNum < count; dateNum++) {
+        float value;
+        if (!MSFileIO::dateToFloat(dates[first + dateNum], value)) allValid = false;
+        if (bitsOf(value) != bitsOf(batchFloats[dateNum]))
+            fail("datesToFloats differs from dateToFloat for " + dates[first + dateNum].asString(Date::EDateFormatYYYYMMMDD));
+    }
+    if (batchValid != allValid) fail("datesToFloats gave the wrong result for a batch");
+}
+
+
+// Check dates: every day from 1900 to 2079 through dateToFloat, MBF32, and the date reader, and
+// the batch encoder against the one at a time encoder
+static void checkDates()
+{
+    vector<Date> dates;
+
+    for (unsigned int year = 1900; year <= 2079; year++)
+        for (unsigned int month = 1; month <= 12; month++)
+            for (unsigned int day = 1; day <= daysInMonth(year, month); day++) dates.push_back(Date(year, month, day));
+
+    for (unsigned long dateNum = 0; dateNum < dates.size(); dateNum++) {
+        const Date &date = dates[dateNum];
+        unsigned long yyyymmdd = date.Year() * 10000 + date.Month() * 100 + date.day();
+        bool fits = (date.Year() >= 1980);
+        float value;
+
+        // Dates from 1980 are held as YYMMDD, and from 2000 as CYYMMDD (eg: 991231 then 1000101)
+        if (MSFileIO::dateToFloat(date, value) != fits) {
+            fail("dateToFloat gave the wrong result for " + date.asString(Date::EDateFormatYYYYMMMDD));
+            continue;
+        }
+        if (!fits) continue;
+        if (value != static_cast<float>(yyyymmdd - 19000000)) {
+            fail("dateToFloat gave " + bitsOf(value) + " for " + date.asString(Date::EDateFormatYYYYMMMDD));
+            continue;
+        }
+
+        // Read it back as a data file reader would
+        string record(4, '\0');
+        Date decoded;
+        MSFileIO::writeFloatToBuffer(record, 0, value, MSFileIO::EVariableTypeMBF32);
+        istringstream file(record);
+        if ( (!MSFileIO::readDateFromFile(file, 0, decoded, MSFileIO::EVariableTypeMBF32)) || (decoded.asYYYYMMDD() != yyyymmdd) )
+            fail("date round trip of " + date.asString(Date::EDateFormatYYYYMMMDD) + " gave " + decoded.asString(Date::EDateFormatYYYYMMMDD));
+    }
+
+    // The batch encoder, over both sides of each boundary (1979 / 1980 and 1999 / 2000) at every
+    // alignment and length up to a few blocks of 4, then in bulk
+    for (unsigned long dateNum = 0; dateNum < dates.size(); dateNum++) {
+        unsigned long yyyymmdd = dates[dateNum].asYYYYMMDD();
+        if ( (yyyymmdd != 19800101) && (yyyymmdd != 20000101) ) continue;
+        for (unsigned long first = dateNum - 8; first < dateNum + 1; first++)
+            for (unsigned long count = 0; count <= 13; count++) checkDateBatch(dates, first, count);
+    }
+    checkDateBatch(dates, 0, dates.size());
+    checkDateBatch(dates, 1, dates.size() - 1);
+}
+
+
+int main(int argc, char *argv[])
+{
+    checkFloats();
+    checkDates();
+
+    if (numFailures > 0) {
+        cout << numFailures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
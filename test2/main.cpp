@@ -0,0 +1,374 @@
+/*
+ * Class: Main
+ * Author: Marc Stahl
+ * Description: Checks that trading days survive being written to disk: a database saved
+ *   (in place and atomically) and opened again, an atomic save cut short after its commit
+ *   record was written, days held only in the journal, and a database compacted so an
+ *   equity moves from XMASTER to MASTER.  Prints each failure, and returns 1 if there were any.
+ * History:
+ *   MKS    2026-Oct-18   Original coding
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "metastockdb.h"
+#include "dbsnapshot.h"
+
+using namespace std;
+
+// Number of failures found
+static unsigned long numFailures = 0;
+
+// Directory every database is created in
+static string testDirectory;
+
+
+// Report a failure
+static void fail(const string &message)
+{
+    if (numFailures < 50) cout << "FAILED: " << message << endl;
+    numFailures++;
+}
+
+
+// Path of a file in a database directory
+static string filePath(const string &dbPath, const string &fileName)
+{
+    return dbPath + "/" + fileName;
+}
+
+
+// Read a whole file.  Returns an empty string if it cannot be read
+static string readFile(const string &path)
+{
+    ifstream file(path.c_str(), ios::binary);
+    ostringstream contents;
+
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+
+// Replace a whole file with contents
+static void writeFile(const string &path, const string &contents)
+{
+    ofstream file(path.c_str(), ios::binary | ios::trunc);
+
+    file.write(contents.data(), contents.size());
+}
+
+
+// Does the file exist
+static bool fileExists(const string &path)
+{
+    return (access(path.c_str(), F_OK) == 0);
+}
+
+
+// Names of the files in a directory
+static vector<string> listFiles(const string &dbPath)
+{
+    vector<string> fileNames;
+    DIR* directory = opendir(dbPath.c_str());
+    struct dirent* entry;
+
+    if (directory == NULL) return fileNames;
+    while ((entry = readdir(directory)) != NULL) {
+        string fileName = entry->d_name;
+        if ( (fileName != ".") && (fileName != "..") ) fileNames.push_back(fileName);
+    }
+    closedir(directory);
+    return fileNames;
+}
+
+
+// Make an empty directory for a database, and return its path
+static string makeDatabase(const string &name)
+{
+    string dbPath = testDirectory + "/" + name;
+
+    if (mkdir(dbPath.c_str(), 0755) != 0) fail("could not create " + dbPath);
+    return dbPath;
+}
+
+
+// Remove a database directory and every file in it
+static void removeDatabase(const string &dbPath)
+{
+    vector<string> fileNames = listFiles(dbPath);
+
+    for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) unlink(filePath(dbPath, fileNames[fileNum]).c_str());
+    rmdir(dbPath.c_str());
+}
+
+
+// A trading day with prices (all exact in MBF32) made from its number
+static TradingDay makeDay(const Date date, const unsigned long dayNum)
+{
+    float price = 10.0f + dayNum * 0.25f;
+
+    return TradingDay(date, 0, price, price + 0.5f, price + 1.0f, price - 1.0f, 1000 + dayNum, 0);
+}
+
+
+// Make count trading days, one a day from day first + 1 of the month given
+static vector<TradingDay> makeDays(const unsigned int year, const unsigned int month, const unsigned long first, const unsigned long count)
+{
+    vector<TradingDay> days;
+
+    for (unsigned long dayNum = first; dayNum < first + count; dayNum++)
+        days.push_back(makeDay(Date(year, month, 1 + dayNum), dayNum));
+    return days;
+}
+
+
+// Check the trading days of an equity in the database's current snapshot are expected
+static void checkDays(MetaStockDB &db, const string &symbol, const vector<TradingDay> &expected, const string &test)
+{
+    shared_ptr<const DBSnapshot> snapshot = db.snapshot();
+    const DBSnapshot::EquitySnapshot* equity = snapshot->find(symbol);
+
+    if (equity == NULL) {
+        fail(test + ": " + symbol + " not found");
+        return;
+    }
+    const vector<TradingDay> &days = *equity->tradingDays;
+    if (days.size() != expected.size()) {
+        fail(test + ": " + symbol + " has " + to_string(days.size()) + " days, expected " + to_string(expected.size()));
+        return;
+    }
+    for (unsigned long dayNum = 0; dayNum < days.size(); dayNum++) {
+        if ( (days[dayNum].date().asYYYYMMDD() != expected[dayNum].date().asYYYYMMDD()) ||
+             (days[dayNum].open() != expected[dayNum].open()) || (days[dayNum].close() != expected[dayNum].close()) ||
+             (days[dayNum].high() != expected[dayNum].high()) || (days[dayNum].low() != expected[dayNum].low()) ||
+             (days[dayNum].volume() != expected[dayNum].volume()) ) {
+            fail(test + ": " + symbol + " day " + to_string(dayNum) + " differs");
+            return;
+        }
+    }
+}
+
+
+// Save a new database, add to it and save again, and check what is read back, in the save mode given
+static void checkSaveAndReopen(const MetaStockDB::ESaveModes saveMode, const string &test)
+{
+    string dbPath = makeDatabase(test);
+    vector<TradingDay> daysA = makeDays(2020, 1, 0, 20);
+    vector<TradingDay> daysB = makeDays(2020, 1, 0, 5);
+    unsigned long numAdded;
+
+    {
+        MetaStockDB db(dbPath, false, 0);
+        db.saveMode(saveMode);
+        if ( (!db.addEquity("AAA", "First")) || (!db.addEquity("BBB", "Second")) ) fail(test + ": addEquity failed");
+        db.addTradingDays("AAA", daysA, numAdded);
+        db.addTradingDays("BBB", daysB, numAdded);
+        if (!db.save()) fail(test + ": first save failed: " + db.lastErrorMessage());
+
+        // Days after the last saved are appended, and one before it rewrites the rest of the file
+        vector<TradingDay> moreDays = makeDays(2020, 2, 0, 3);
+        db.addTradingDays("AAA", moreDays, numAdded);
+        daysA.insert(daysA.end(), moreDays.begin(), moreDays.end());
+        db.addTradingDayData("BBB", Date(2019, 12, 31), 0, 9.0f, 9.5f, 10.0f, 8.0f, 500, 0);
+        daysB.insert(daysB.begin(), TradingDay(Date(2019, 12, 31), 0, 9.0f, 9.5f, 10.0f, 8.0f, 500, 0));
+        if (!db.save()) fail(test + ": second save failed: " + db.lastErrorMessage());
+    }
+
+    MetaStockDB db(dbPath, false, 0);
+    if (db.lastError() != MetaStockDB::EErrorNone) fail(test + ": reopen failed: " + db.lastErrorMessage());
+    checkDays(db, "AAA", daysA, test);
+    checkDays(db, "BBB", daysB, test);
+}
+
+
+// Leave an atomic save as a crash after its commit record would (the replacement files beside
+// the originals, and the record listing them), and check opening the database finishes it.  Then
+// the same with the record cut short, which must leave the old files
+static void checkRecovery()
+{
+    string dbPath = makeDatabase("recovery");
+    vector<TradingDay> oldDays = makeDays(2021, 3, 0, 10);
+    vector<TradingDay> newDays = makeDays(2021, 3, 0, 15);
+    vector<string> fileNames;
+    vector<string> oldContents;
+    vector<string> newContents;
+    unsigned long numAdded;
+
+    {
+        MetaStockDB db(dbPath, false, 0);
+        db.saveMode(MetaStockDB::ESaveModeAtomic);
+        db.addEquity("REC", "Recovery");
+        db.addTradingDays("REC", oldDays, numAdded);
+        db.save();
+        fileNames = listFiles(dbPath);
+        for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) oldContents.push_back(readFile(filePath(dbPath, fileNames[fileNum])));
+
+        db.addTradingDays("REC", vector<TradingDay>(newDays.begin() + oldDays.size(), newDays.end()), numAdded);
+        if (!db.save()) fail("recovery: save failed: " + db.lastErrorMessage());
+        for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) newContents.push_back(readFile(filePath(dbPath, fileNames[fileNum])));
+    }
+
+    for (int complete = 1; complete >= 0; complete--) {
+        string test = complete ? "recovery" : "recovery (record cut short)";
+        string record;
+        for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++) {
+            writeFile(filePath(dbPath, fileNames[fileNum]), oldContents[fileNum]);
+            writeFile(filePath(dbPath, fileNames[fileNum] + ".tmp"), newContents[fileNum]);
+            record += fileNames[fileNum] + "\n";
+        }
+        if (complete) record += "COMMIT\n";
+        writeFile(filePath(dbPath, "TRANSACTION"), record);
+
+        MetaStockDB db(dbPath, false, 0);
+        if (db.lastError() != MetaStockDB::EErrorNone) fail(test + ": open failed: " + db.lastErrorMessage());
+        checkDays(db, "REC", complete ? newDays : oldDays, test);
+        if (fileExists(filePath(dbPath, "TRANSACTION"))) fail(test + ": commit record left behind");
+        for (unsigned long fileNum = 0; fileNum < fileNames.size(); fileNum++)
+            if (fileExists(filePath(dbPath, fileNames[fileNum] + ".tmp"))) fail(test + ": " + fileNames[fileNum] + ".tmp left behind");
+    }
+}
+
+
+// Add days with the journal enabled, and check a database opened again without saving reads
+// them back from the journal (also for an equity not loaded when they were added)
+static void checkJournal()
+{
+    string dbPath = makeDatabase("journal");
+    vector<TradingDay> savedDays = makeDays(2022, 5, 0, 8);
+    vector<TradingDay> journalDays = makeDays(2022, 5, 0, 12);
+    unsigned long numAdded;
+
+    {
+        MetaStockDB db(dbPath, false, 0);
+        db.addEquity("JNL", "Journal");
+        db.addEquity("LAZY", "Journal, lazily loaded");
+        db.addTradingDays("JNL", savedDays, numAdded);
+        db.addTradingDays("LAZY", savedDays, numAdded);
+        db.save();
+    }
+    {
+        MetaStockDB db(dbPath, true, 0);
+        if (!db.enableJournal()) fail("journal: enableJournal failed: " + db.lastErrorMessage());
+        db.loadEquities(vector<string>(1, "JNL"));
+        db.addTradingDays("JNL", vector<TradingDay>(journalDays.begin() + savedDays.size(), journalDays.end()), numAdded);
+        db.addTradingDays("LAZY", vector<TradingDay>(journalDays.begin() + savedDays.size(), journalDays.end()), numAdded);
+        // Not saved
+    }
+
+    MetaStockDB db(dbPath, false, 0);
+    if (!db.enableJournal()) fail("journal: enableJournal on reopen failed: " + db.lastErrorMessage());
+    checkDays(db, "JNL", journalDays, "journal");
+    checkDays(db, "LAZY", journalDays, "journal");
+
+    // Once saved the days are in the data files, and the journal adds nothing
+    if (!db.save()) fail("journal: save failed: " + db.lastErrorMessage());
+    MetaStockDB reopened(dbPath, false, 0);
+    checkDays(reopened, "JNL", journalDays, "journal (saved)");
+}
+
+
+// Read a little endian unsigned short from contents
+static unsigned int readUShort(const string &contents, const unsigned long offset)
+{
+    return static_cast<unsigned char>(contents[offset]) | (static_cast<unsigned char>(contents[offset + 1]) << 8);
+}
+
+
+// Write a little endian unsigned short into contents
+static void writeUShort(string &contents, const unsigned long offset, const unsigned int value)
+{
+    contents[offset] = static_cast<char>(value & 0xff);
+    contents[offset + 1] = static_cast<char>(value >> 8);
+}
+
+
+// Keep only the first numRecords records of a MASTER or EMASTER file (as if the others had been
+// deleted by another program), numbered 1 to numRecords
+static void truncateMasterFile(const string &path, const unsigned long recordSize, const unsigned int numRecords)
+{
+    string contents = readFile(path);
+
+    contents.resize(recordSize * (numRecords + 1));
+    writeUShort(contents, 0, numRecords);
+    writeUShort(contents, 2, numRecords);
+    writeFile(path, contents);
+}
+
+
+// Fill MASTER so the next equity is listed in XMASTER, leave room for it in MASTER, and check
+// compact() moves it there with the file type of an equity listed in MASTER
+static void checkCompact()
+{
+    string dbPath = makeDatabase("compact");
+    vector<TradingDay> days = makeDays(2023, 7, 0, 6);
+    unsigned long numAdded;
+
+    {
+        MetaStockDB db(dbPath, false, 0);
+        for (unsigned int equityNum = 1; equityNum <= 255; equityNum++) db.addEquity("S" + to_string(equityNum), "Filler");
+        if (!db.addEquity("XM", "In XMASTER")) fail("compact: addEquity failed: " + db.lastErrorMessage());
+        db.addTradingDays("S1", days, numAdded);
+        db.addTradingDays("XM", days, numAdded);
+        if (!db.save()) fail("compact: save failed: " + db.lastErrorMessage());
+    }
+    if (!fileExists(filePath(dbPath, "C256.MWD"))) fail("compact: XM was not listed in XMASTER");
+    truncateMasterFile(filePath(dbPath, "MASTER"), 53, 2);
+    truncateMasterFile(filePath(dbPath, "EMASTER"), 192, 2);
+
+    {
+        MetaStockDB db(dbPath, false, 0);
+        if (!db.compact()) fail("compact: compact failed: " + db.lastErrorMessage());
+    }
+
+    // XM is now the third equity in MASTER, in F3.DAT
+    string master = readFile(filePath(dbPath, "MASTER"));
+    if ( (master.size() != 53 * 4) || (readUShort(master, 0) != 3) ) {
+        fail("compact: MASTER does not hold 3 records");
+    } else {
+        if (master.compare(53 * 3 + 36, 2, "XM") != 0) fail("compact: record 3 of MASTER is not XM");
+        if (static_cast<unsigned char>(master[53 * 3]) != 3) fail("compact: XM is not in F3.DAT");
+        if (readUShort(master, 53 * 3 + 1) != 0x65) fail("compact: XM has MASTER file type " + to_string(readUShort(master, 53 * 3 + 1)));
+    }
+    if (fileExists(filePath(dbPath, "C256.MWD"))) fail("compact: C256.MWD left behind");
+
+    MetaStockDB db(dbPath, false, 0);
+    if (db.lastError() != MetaStockDB::EErrorNone) fail("compact: reopen failed: " + db.lastErrorMessage());
+    checkDays(db, "S1", days, "compact");
+    checkDays(db, "XM", days, "compact");
+}
+
+
+int main(int argc, char *argv[])
+{
+    char directoryTemplate[] = "/tmp/msdbtest2.XXXXXX";
+
+    if (mkdtemp(directoryTemplate) == NULL) {
+        cout << "Could not create a directory for the test databases" << endl;
+        return 1;
+    }
+    testDirectory = directoryTemplate;
+
+    checkSaveAndReopen(MetaStockDB::ESaveModeInPlace, "inplace");
+    checkSaveAndReopen(MetaStockDB::ESaveModeAtomic, "atomic");
+    checkRecovery();
+    checkJournal();
+    checkCompact();
+
+    vector<string> databases = listFiles(testDirectory);
+    for (unsigned long dbNum = 0; dbNum < databases.size(); dbNum++) removeDatabase(filePath(testDirectory, databases[dbNum]));
+    rmdir(testDirectory.c_str());
+
+    if (numFailures > 0) {
+        cout << numFailures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}